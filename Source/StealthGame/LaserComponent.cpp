@@ -2,11 +2,40 @@
 
 
 #include "LaserComponent.h"
+#include "StealthGame.h"
+#include "LaserSubsystem.h"
+#include "LaserMirrorComponent.h"
+#include "LaserIntersection.h"
 #include "NiagaraComponent.h"
+#include "NiagaraFunctionLibrary.h"
+#include "Components/BoxComponent.h"
+#include "Components/CapsuleComponent.h"
+#include "GameFramework/Pawn.h"
 #include "Kismet/GameplayStatics.h"
 
 #define ECC_LineOfSight ECC_GameTraceChannel2
 
+DECLARE_CYCLE_STAT(TEXT("Laser Tick"), STAT_Sensing_LaserTick, STATGROUP_Sensing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Laser Traces"), STAT_Sensing_LaserTraces, STATGROUP_Sensing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Laser Static Traces"), STAT_Sensing_LaserStaticTraces, STATGROUP_Sensing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Laser Capsule Tests"), STAT_Sensing_LaserCapsuleTests, STATGROUP_Sensing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Laser Sweep Tests"), STAT_Sensing_LaserSweepTests, STATGROUP_Sensing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Laser Intercept Broadcasts"), STAT_Sensing_LaserBroadcasts, STATGROUP_Sensing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Laser FX Updates"), STAT_Sensing_LaserFXUpdates, STATGROUP_Sensing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Laser FX Active"), STAT_Sensing_LaserFXActive, STATGROUP_Sensing);
+
+/** Hard limit of MaxBounces, whatever the laser asks for. */
+static const int32 MaxLaserBounces = 4;
+
+/** How far off a mirror the beam starts again after bouncing, so it doesn't hit the mirror it leaves. */
+static const float MirrorBounceOffset = 0.1f;
+
+/** True if Component blocks the laser trace channel. */
+static bool BlocksLaser(const UPrimitiveComponent* Component)
+{
+	return Component->IsQueryCollisionEnabled() && Component->GetCollisionResponseToChannel(ECC_LineOfSight) == ECR_Block;
+}
+
 // Sets default values for this component's properties
 ULaserComponent::ULaserComponent()
 {
@@ -18,8 +47,40 @@ ULaserComponent::ULaserComponent()
 	
 	NiagaraLaserImpact = CreateDefaultSubobject<UNiagaraComponent>(TEXT("NiagaraLaserImpact"));
 	NiagaraLaserImpact->AttachToComponent(this, FAttachmentTransformRules::KeepRelativeTransform);
+
+	bUseStaticFastPath = true;
+	BeamBoundsRadius = 2.f;
+
+	// Collision stays off until the laser is initialized in a game world, see InitializeComponent().
+	BeamBounds = CreateDefaultSubobject<UBoxComponent>(TEXT("BeamBounds"));
+	BeamBounds->AttachToComponent(this, FAttachmentTransformRules::KeepRelativeTransform);
+	BeamBounds->InitBoxExtent(FVector(LaserDistance * 0.5f, BeamBoundsRadius, BeamBoundsRadius));
+	BeamBounds->SetRelativeLocation(FVector(LaserDistance * 0.5f, 0.f, 0.f));
+	BeamBounds->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	BeamBounds->SetGenerateOverlapEvents(false);
+	BeamBounds->SetCanEverAffectNavigation(false);
+
+	bBeamBoundsActive = false;
+	bStaticHitValid = false;
+	bStaticHit = false;
+	StaticHitLaserDistance = 0.f;
+	StaticPathMirrorRevision = 0;
+	MaxBounces = 0;
+	LaserSubsystem = nullptr;
+	PooledImpact = nullptr;
+	bLaserFXActive = false;
+	bBeamFXEndValid = false;
+	BeamFXEnd = FVector::ZeroVector;
+	ImpactFXLocation = FVector::ZeroVector;
+	bSweepMode = false;
+	SweepUpdateInterval = 0.f;
+	bSweepValid = false;
+	SweepStart = FVector::ZeroVector;
+	SweepEnd = FVector::ZeroVector;
+	NextSweepUpdateTime = 0.f;
 	
 	bWantsOnUpdateTransform = true;
+	bWantsInitializeComponent = true;
 	bAutoActivate = true;
 	bIsLaserTouchingPlayer = false;
 	
@@ -32,52 +93,529 @@ void ULaserComponent::BeginPlay()
 }
 
 
+void ULaserComponent::InitializeComponent()
+{
+	Super::InitializeComponent();
+
+	TraceParams = FCollisionQueryParams(SCENE_QUERY_STAT(LaserTrace), false, GetOwner()); // ignore collision with self
+	StaticTraceParams = TraceParams;
+	StaticTraceParams.MobilityType = EQueryMobilityType::Static;
+
+	UWorld* World = GetWorld();
+	// A sweeping beam moves every update, there is no static hit worth caching.
+	if (bUseStaticFastPath && !bSweepMode && World != nullptr && World->IsGameWorld())
+	{
+		EnableBeamBounds(BeamBounds);
+		bBeamBoundsActive = true;
+		UpdateBeamBounds();
+	}
+
+	// Lasers batched by the laser subsystem don't need a tick of their own.
+	LaserSubsystem = World != nullptr ? World->GetSubsystem<ULaserSubsystem>() : nullptr;
+	if (LaserSubsystem != nullptr && LaserSubsystem->RegisterLaser(this))
+	{
+		SetComponentTickEnabled(false);
+	}
+	else if (bSweepMode)
+	{
+		SetComponentTickInterval(SweepUpdateInterval);
+	}
+
+	// LODed effects stay off until a view gets close, and the impact comes from the pool instead.
+	if (LaserSubsystem != nullptr && LaserSubsystem->IsLaserFXLODEnabled())
+	{
+		NiagaraLaser->SetAutoActivate(false);
+		NiagaraLaser->Deactivate();
+		NiagaraLaserImpact->SetAutoActivate(false);
+		NiagaraLaserImpact->Deactivate();
+		NiagaraLaserImpact->SetVisibility(false);
+	}
+}
+
+void ULaserComponent::UninitializeComponent()
+{
+	if (LaserSubsystem != nullptr)
+	{
+		LaserSubsystem->UnregisterLaser(this);
+		LaserSubsystem = nullptr;
+	}
+
+	ReleasePooledImpact();
+	ReleasePooledSegments();
+	bLaserFXActive = false;
+	bBeamFXEndValid = false;
+	bSweepValid = false;
+
+	if (bBeamBoundsActive)
+	{
+		for (UBoxComponent* Bounds : SegmentBounds)
+		{
+			if (Bounds != nullptr)
+			{
+				Bounds->DestroyComponent();
+			}
+		}
+		SegmentBounds.Reset();
+
+		BeamBounds->OnComponentBeginOverlap.RemoveDynamic(this, &ULaserComponent::OnBeamBeginOverlap);
+		BeamBounds->OnComponentEndOverlap.RemoveDynamic(this, &ULaserComponent::OnBeamEndOverlap);
+		BeamBounds->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		BeamCapsules.Reset();
+		TraceCapsules.Reset();
+		BeamMovables.Reset();
+		bBeamBoundsActive = false;
+	}
+
+	Super::UninitializeComponent();
+}
+
 // Called every frame
 void ULaserComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
 {
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
 
-	FHitResult result;
-	FCollisionQueryParams params = FCollisionQueryParams::DefaultQueryParam;
-	params.AddIgnoredActor(GetOwner()); // ignore collision with self
-	//trace a line along the laser direction
-	if (GetWorld()->LineTraceSingleByChannel(result, GetComponentLocation(),GetComponentLocation() + GetComponentRotation().Vector() * LaserDistance, ECC_LineOfSight, params)) 
+	SCOPE_CYCLE_COUNTER(STAT_Sensing_LaserTick);
+	TRACE_CPUPROFILER_EVENT_SCOPE(ULaserComponent::TickComponent);
+	STEALTH_FRAME_COST_SCOPE(Lasers);
+
+	TArray<APawn*> Players;
+	ULaserSubsystem::GatherPlayerPawns(GetWorld(), Players);
+	TArray<FVector> ViewLocations;
+	ULaserSubsystem::GatherViewLocations(GetWorld(), ViewLocations);
+
+	FLaserTraceResult Result;
+	PrepareTrace();
+	TraceLaser(Result);
+	ApplyTraceResult(Result, Players, ViewLocations);
+}
+
+FVector ULaserComponent::GetLaserEnd() const
+{
+	return GetComponentLocation() + GetComponentRotation().Vector() * LaserDistance;
+}
+
+void ULaserComponent::PrepareTrace()
+{
+	TraceCapsules.Reset();
+	for (const TWeakObjectPtr<UCapsuleComponent>& Capsule : BeamCapsules)
+	{
+		if (Capsule.IsValid())
+		{
+			TraceCapsules.Add(Capsule.Get());
+		}
+	}
+
+	// A pawn destroyed without an end overlap leaves its capsule behind.
+	if (TraceCapsules.Num() != BeamCapsules.Num())
+	{
+		BeamCapsules.RemoveAll([](const TWeakObjectPtr<UCapsuleComponent>& Capsule) { return !Capsule.IsValid(); });
+	}
+}
+
+void ULaserComponent::TraceLaser(FLaserTraceResult& OutResult) const
+{
+	// Anything but pawns moving through the beam can block it anywhere, so only a full trace will do.
+	if (!bBeamBoundsActive || BeamMovables.Num() > 0)
+	{
+		OutResult.bHit = TracePath(false, OutResult.Path, OutResult.Hit);
+		return;
+	}
+
+	const int32 MirrorRevision = LaserSubsystem != nullptr ? LaserSubsystem->GetMirrorRevision() : 0;
+	// Mirrors changing elsewhere in the world leave the cached path alone.
+	OutResult.bTracedStatic = !bStaticHitValid || StaticHitLaserDistance != LaserDistance
+		|| (StaticPathMirrorRevision != MirrorRevision && !LaserSubsystem->IsLaserPathUnchanged(StaticPath, StaticPathMirrorRevision));
+	OutResult.MirrorRevision = MirrorRevision;
+	if (OutResult.bTracedStatic)
+	{
+		OutResult.bStaticHit = TracePath(true, OutResult.StaticPath, OutResult.Hit);
+	}
+
+	const FLaserPath& Path = OutResult.bTracedStatic ? OutResult.StaticPath : StaticPath;
+	const bool bPathHit = OutResult.bTracedStatic ? OutResult.bStaticHit : bStaticHit;
+
+	// The pawns in the beam's bounds are the only movable objects that can cut it short of the static geometry and
+	// mirrors. The first segment one of them blocks ends the beam.
+	for (int32 Segment = 0; Segment + 1 < Path.Num(); ++Segment)
 	{
-		//If we hit something, then cut the laser off at that place and draw the impact shape
-		NiagaraLaser->SetVectorParameter(TEXT("Laser End"), result.Location);
-		NiagaraLaserImpact->SetWorldLocation(result.Location);
-		NiagaraLaserImpact->SetVisibility(true);
+		const FVector& Start = Path[Segment];
+		const FVector Delta = Path[Segment + 1] - Start;
+		const float Length = Delta.Size();
+		if (Length <= KINDA_SMALL_NUMBER)
+		{
+			continue;
+		}
+
+		const FVector Direction = Delta / Length;
+		UCapsuleComponent* HitCapsule = nullptr;
+		float HitDistance = Length;
+		for (UCapsuleComponent* Capsule : TraceCapsules)
+		{
+			INC_DWORD_STAT(STAT_Sensing_LaserCapsuleTests);
+
+			const float Radius = Capsule->GetScaledCapsuleRadius();
+			const FVector Axis = Capsule->GetUpVector() * FMath::Max(Capsule->GetScaledCapsuleHalfHeight() - Radius, 0.f);
+			const FVector Center = Capsule->GetComponentLocation();
 
-		//if we start touching the player, notify (but only if we werent already touching the player)
+			float Distance = 0.f;
+			if (LaserIntersection::IntersectRayCapsule(Start, Direction, Center - Axis, Center + Axis, Radius, Distance) && Distance < HitDistance)
+			{
+				HitCapsule = Capsule;
+				HitDistance = Distance;
+			}
+		}
+
+		if (HitCapsule != nullptr)
+		{
+			const FVector HitLocation = Start + Direction * HitDistance;
+			OutResult.Path.Append(Path.GetData(), Segment + 1);
+			OutResult.Path.Add(HitLocation);
+			OutResult.bHit = true;
+			OutResult.Hit = FHitResult(HitCapsule->GetOwner(), HitCapsule, HitLocation, -Direction);
+			OutResult.Hit.Distance = HitDistance;
+			return;
+		}
+	}
+
+	OutResult.Path = Path;
+	OutResult.bHit = bPathHit;
+	if (bPathHit && !OutResult.bTracedStatic)
+	{
+		OutResult.Hit.Location = OutResult.Hit.ImpactPoint = Path.Last();
+	}
+}
 
-		APawn* Player = UGameplayStatics::GetPlayerPawn(GetWorld(), 0);
+bool ULaserComponent::TracePath(bool bStaticOnly, FLaserPath& OutPath, FHitResult& OutHit) const
+{
+	FVector Start = GetComponentLocation();
+	FVector Direction = GetComponentRotation().Vector();
+	float RemainingDistance = LaserDistance;
+	const int32 NumBounces = FMath::Clamp(MaxBounces, 0, MaxLaserBounces);
 
-		if (result.Actor == Player && !bIsLaserTouchingPlayer)
+	OutPath.Reset();
+	OutPath.Add(Start);
+	for (int32 Bounce = 0; ; ++Bounce)
+	{
+		const FVector End = Start + Direction * RemainingDistance;
+		if (!TraceSegment(Start, End, bStaticOnly, OutHit))
 		{
-			bIsLaserTouchingPlayer = true;
-			OnLaserStartInterceptPlayer.Broadcast(Player);
+			OutPath.Add(End);
+			return false;
 		}
-		else if (result.Actor != Player && bIsLaserTouchingPlayer)
+		OutPath.Add(OutHit.Location);
+
+		// Anything but a mirror stops the beam, and so does running out of bounces or length.
+		RemainingDistance -= OutHit.Distance + MirrorBounceOffset;
+		if (Bounce >= NumBounces || RemainingDistance <= 0.f || Cast<ULaserMirrorComponent>(OutHit.GetComponent()) == nullptr)
 		{
-			bIsLaserTouchingPlayer = false;
-			OnLaserStopInterceptPlayer.Broadcast(Player);
+			return true;
 		}
+
+		Direction = FMath::GetReflectionVector(Direction, OutHit.ImpactNormal);
+		Start = OutHit.Location + Direction * MirrorBounceOffset;
 	}
-	else 
+}
+
+bool ULaserComponent::TraceSegment(const FVector& Start, const FVector& End, bool bStaticOnly, FHitResult& OutHit) const
+{
+	if (!bStaticOnly)
 	{
-		//otherwise, set the laser end to be its max distance and dont show an impact shape
-		NiagaraLaser->SetVectorParameter(TEXT("Laser End"), GetComponentLocation() + GetComponentRotation().Vector() * LaserDistance);
-		NiagaraLaserImpact->SetVisibility(false);
-		
-		// if we were touching the player but now we touch nothing, then notify that we no longer intercept the player
-		if (bIsLaserTouchingPlayer)
+		INC_DWORD_STAT(STAT_Sensing_LaserTraces);
+
+		//trace a line along the laser direction
+		return GetWorld()->LineTraceSingleByChannel(OutHit, Start, End, ECC_LineOfSight, TraceParams);
+	}
+
+	INC_DWORD_STAT(STAT_Sensing_LaserStaticTraces);
+	bool bHit = GetWorld()->LineTraceSingleByChannel(OutHit, Start, End, ECC_LineOfSight, StaticTraceParams);
+
+	// Movable mirrors are left out of the static trace, but they are as much part of the cached path. A mirror moving
+	// invalidates it through the mirror revision.
+	if (LaserSubsystem != nullptr)
+	{
+		FVector SegmentEnd = bHit ? OutHit.Location : End;
+		for (ULaserMirrorComponent* Mirror : LaserSubsystem->GetMirrors())
+		{
+			FHitResult MirrorHit;
+			if (Mirror->Mobility == EComponentMobility::Movable && Mirror->GetOwner() != GetOwner() && BlocksLaser(Mirror)
+				&& Mirror->LineTraceComponent(MirrorHit, Start, SegmentEnd, StaticTraceParams))
+			{
+				OutHit = MirrorHit;
+				bHit = true;
+				SegmentEnd = MirrorHit.Location;
+			}
+		}
+	}
+	return bHit;
+}
+
+void ULaserComponent::ApplyTraceResult(const FLaserTraceResult& Result, const TArray<APawn*>& Players, const TArray<FVector>& ViewLocations)
+{
+	if (Result.bTracedStatic)
+	{
+		bStaticHitValid = true;
+		bStaticHit = Result.bStaticHit;
+		StaticPath = Result.StaticPath;
+		StaticHitLaserDistance = LaserDistance;
+		StaticPathMirrorRevision = Result.MirrorRevision;
+		UpdateBeamBounds();
+	}
+	else if (bStaticHitValid)
+	{
+		// The cached path was checked against the mirror changes up to this revision, no need to check them again.
+		StaticPathMirrorRevision = FMath::Max(StaticPathMirrorRevision, Result.MirrorRevision);
+	}
+
+	const bool bHit = Result.bHit;
+	const FHitResult& Hit = Result.Hit;
+
+	// Sweeps are only tested along the first segment of the beam, up to the first bounce.
+	const FVector BeamEnd = Result.Path.Num() > 1 ? Result.Path[1] : GetLaserEnd();
+
+	//If we hit something, then cut the laser off at that place and draw the impact shape
+	//otherwise, set the laser end to be its max distance and dont show an impact shape
+	UpdateLaserFX(bHit, Result.Path, ViewLocations);
+
+	APawn* HitPlayer = nullptr;
+	if (bHit)
+	{
+		const AActor* HitActor = Hit.GetActor();
+		APawn* const* Player = Players.FindByPredicate([HitActor](const APawn* Candidate) { return Candidate == HitActor; });
+		HitPlayer = Player != nullptr ? *Player : nullptr;
+	}
+
+	// The beam may have crossed other players on its way from the previous one, whatever it ends on.
+	TArray<APawn*, TInlineAllocator<4>> SweptPlayers;
+	if (bSweepMode)
+	{
+		if (bSweepValid)
+		{
+			FindSweptPlayers(GetComponentLocation(), BeamEnd, Players, InterceptedPlayer.Get(), HitPlayer, SweptPlayers);
+		}
+
+		bSweepValid = true;
+		SweepStart = GetComponentLocation();
+		SweepEnd = BeamEnd;
+		NextSweepUpdateTime = GetWorld()->GetTimeSeconds() + SweepUpdateInterval;
+	}
+
+	// if we were touching a player but now we touch something else, then notify that we no longer intercept them
+	if (bIsLaserTouchingPlayer && HitPlayer != InterceptedPlayer.Get())
+	{
+		APawn* PreviousPlayer = InterceptedPlayer.Get();
+		bIsLaserTouchingPlayer = false;
+		InterceptedPlayer.Reset();
+		INC_DWORD_STAT(STAT_Sensing_LaserBroadcasts);
+		OnLaserStopInterceptPlayer.Broadcast(PreviousPlayer);
+	}
+
+	//if we start touching a player, notify (but only if we werent already touching them)
+	if (HitPlayer != nullptr && !bIsLaserTouchingPlayer)
+	{
+		bIsLaserTouchingPlayer = true;
+		InterceptedPlayer = HitPlayer;
+		INC_DWORD_STAT(STAT_Sensing_LaserBroadcasts);
+		OnLaserStartInterceptPlayer.Broadcast(HitPlayer);
+	}
+
+	// The beam crossed these players between the two updates and has already left them again.
+	for (APawn* SweptPlayer : SweptPlayers)
+	{
+		INC_DWORD_STAT_BY(STAT_Sensing_LaserBroadcasts, 2);
+		OnLaserStartInterceptPlayer.Broadcast(SweptPlayer);
+		OnLaserStopInterceptPlayer.Broadcast(SweptPlayer);
+	}
+}
+
+void ULaserComponent::FindSweptPlayers(const FVector& Start, const FVector& End, const TArray<APawn*>& Players, const APawn* PreviousPlayer, const APawn* CurrentPlayer, TArray<APawn*, TInlineAllocator<4>>& OutSweptPlayers) const
+{
+	// The swept area is the quad between the previous and the current beam, as two triangles. Either may be degenerate,
+	// e.g. the first when the beam didn't turn, the second when the laser turned in place.
+	const FVector Triangles[2][3] = { { SweepStart, SweepEnd, End }, { SweepStart, End, Start } };
+	bool bTriangleValid[2];
+	for (int32 Index = 0; Index < 2; ++Index)
+	{
+		const FVector(&Triangle)[3] = Triangles[Index];
+		bTriangleValid[Index] = ((Triangle[1] - Triangle[0]) ^ (Triangle[2] - Triangle[0])).SizeSquared() > KINDA_SMALL_NUMBER;
+	}
+
+	if (!bTriangleValid[0] && !bTriangleValid[1])
+	{
+		return;
+	}
+
+	for (APawn* Player : Players)
+	{
+		const UCapsuleComponent* Capsule = Player != PreviousPlayer && Player != CurrentPlayer ? Cast<UCapsuleComponent>(Player->GetRootComponent()) : nullptr;
+		if (Capsule == nullptr)
+		{
+			continue;
+		}
+
+		INC_DWORD_STAT(STAT_Sensing_LaserSweepTests);
+
+		const float Radius = Capsule->GetScaledCapsuleRadius();
+		const FVector Axis = Capsule->GetUpVector() * FMath::Max(Capsule->GetScaledCapsuleHalfHeight() - Radius, 0.f);
+		const FVector Center = Capsule->GetComponentLocation();
+
+		for (int32 Index = 0; Index < 2; ++Index)
+		{
+			const FVector(&Triangle)[3] = Triangles[Index];
+			if (bTriangleValid[Index] && LaserIntersection::IntersectCapsuleTriangle(Center - Axis, Center + Axis, Radius, Triangle[0], Triangle[1], Triangle[2]))
+			{
+				OutSweptPlayers.Add(Player);
+				break;
+			}
+		}
+	}
+}
+
+void ULaserComponent::UpdateLaserFX(bool bHit, const FLaserPath& Path, const TArray<FVector>& ViewLocations)
+{
+	if (Path.Num() < 2)
+	{
+		return;
+	}
+
+	// NiagaraLaser draws the first segment, from the laser to the first bounce or the end of the beam.
+	const FVector& BeamEnd = Path[1];
+	const FVector& PathEnd = Path.Last();
+
+	if (LaserSubsystem == nullptr || !LaserSubsystem->IsLaserFXLODEnabled())
+	{
+		INC_DWORD_STAT(STAT_Sensing_LaserFXUpdates);
+		NiagaraLaser->SetVectorParameter(TEXT("Laser End"), BeamEnd);
+		NiagaraLaserImpact->SetWorldLocation(PathEnd);
+		NiagaraLaserImpact->SetVisibility(bHit);
+		UpdatePooledSegments(Path, 0.f);
+		return;
+	}
+
+	// Only beams some local view is close to are worth simulating and drawing.
+	const float ViewDistanceSquared = FMath::Square(LaserSubsystem->GetLaserFXViewDistance());
+	const bool bInView = ViewLocations.ContainsByPredicate([&Path, ViewDistanceSquared](const FVector& View)
+	{
+		for (int32 Index = 0; Index + 1 < Path.Num(); ++Index)
+		{
+			if (FVector::DistSquared(View, FMath::ClosestPointOnSegment(View, Path[Index], Path[Index + 1])) <= ViewDistanceSquared)
+			{
+				return true;
+			}
+		}
+		return false;
+	});
+
+	if (!bInView)
+	{
+		if (bLaserFXActive)
+		{
+			NiagaraLaser->Deactivate();
+			ReleasePooledImpact();
+			ReleasePooledSegments();
+			bLaserFXActive = false;
+		}
+		return;
+	}
+
+	INC_DWORD_STAT(STAT_Sensing_LaserFXActive);
+	if (!bLaserFXActive)
+	{
+		NiagaraLaser->Activate(true);
+		bLaserFXActive = true;
+		bBeamFXEndValid = false;
+	}
+
+	const float ToleranceSquared = FMath::Square(LaserSubsystem->GetLaserFXEndTolerance());
+	if (!bBeamFXEndValid || FVector::DistSquared(BeamEnd, BeamFXEnd) > ToleranceSquared)
+	{
+		INC_DWORD_STAT(STAT_Sensing_LaserFXUpdates);
+		NiagaraLaser->SetVectorParameter(TEXT("Laser End"), BeamEnd);
+		BeamFXEnd = BeamEnd;
+		bBeamFXEndValid = true;
+	}
+
+	UpdatePooledSegments(Path, ToleranceSquared);
+
+	if (!bHit)
+	{
+		ReleasePooledImpact();
+		return;
+	}
+
+	UNiagaraSystem* ImpactSystem = NiagaraLaserImpact->GetAsset();
+	if (PooledImpact == nullptr && ImpactSystem != nullptr)
+	{
+		PooledImpact = UNiagaraFunctionLibrary::SpawnSystemAtLocation(this, ImpactSystem, PathEnd, GetComponentRotation(), FVector(1.f), false, true, ENCPoolMethod::ManualRelease, false);
+		if (PooledImpact != nullptr)
+		{
+			PooledImpact->SetColorParameter(TEXT("Color"), LaserColor);
+			ImpactFXLocation = PathEnd;
+		}
+	}
+	else if (PooledImpact != nullptr && FVector::DistSquared(PathEnd, ImpactFXLocation) > ToleranceSquared)
+	{
+		PooledImpact->SetWorldLocation(PathEnd);
+		ImpactFXLocation = PathEnd;
+	}
+}
+
+void ULaserComponent::UpdatePooledSegments(const FLaserPath& Path, float ToleranceSquared)
+{
+	// Every segment after a bounce is drawn by its own beam effect of the laser's system, placed at the segment's start.
+	UNiagaraSystem* BeamSystem = NiagaraLaser->GetAsset();
+	const int32 NumSegments = BeamSystem != nullptr ? FMath::Max(Path.Num() - 2, 0) : 0;
+	ReleasePooledSegments(NumSegments);
+
+	for (int32 Index = 0; Index < NumSegments; ++Index)
+	{
+		const FVector& Start = Path[Index + 1];
+		const FVector& End = Path[Index + 2];
+		if (Index >= PooledSegments.Num())
+		{
+			UNiagaraComponent* Segment = UNiagaraFunctionLibrary::SpawnSystemAtLocation(this, BeamSystem, Start, FRotator::ZeroRotator, FVector(1.f), false, true, ENCPoolMethod::ManualRelease, false);
+			if (Segment == nullptr)
+			{
+				return;
+			}
+
+			INC_DWORD_STAT(STAT_Sensing_LaserFXUpdates);
+			Segment->SetColorParameter(TEXT("Color"), LaserColor);
+			Segment->SetVectorParameter(TEXT("Laser End"), End);
+			PooledSegments.Add(Segment);
+			PooledSegmentStarts.Add(Start);
+			PooledSegmentEnds.Add(End);
+		}
+		else if (FVector::DistSquared(Start, PooledSegmentStarts[Index]) > ToleranceSquared || FVector::DistSquared(End, PooledSegmentEnds[Index]) > ToleranceSquared)
 		{
-			APawn* Player = UGameplayStatics::GetPlayerPawn(GetWorld(), 0);
-			OnLaserStopInterceptPlayer.Broadcast(Player);
-			bIsLaserTouchingPlayer = false;
+			INC_DWORD_STAT(STAT_Sensing_LaserFXUpdates);
+			PooledSegments[Index]->SetWorldLocation(Start);
+			PooledSegments[Index]->SetVectorParameter(TEXT("Laser End"), End);
+			PooledSegmentStarts[Index] = Start;
+			PooledSegmentEnds[Index] = End;
 		}
 	}
+}
 
+void ULaserComponent::ReleasePooledSegments(int32 NumToKeep)
+{
+	while (PooledSegments.Num() > NumToKeep)
+	{
+		if (UNiagaraComponent* Segment = PooledSegments.Pop(false))
+		{
+			Segment->ReleaseToPool();
+		}
+		PooledSegmentStarts.Pop(false);
+		PooledSegmentEnds.Pop(false);
+	}
+}
+
+void ULaserComponent::ReleasePooledImpact()
+{
+	if (PooledImpact != nullptr)
+	{
+		PooledImpact->ReleaseToPool();
+		PooledImpact = nullptr;
+	}
 }
 
 #if WITH_EDITOR
@@ -104,15 +642,122 @@ void ULaserComponent::PostEditChangeProperty(FPropertyChangedEvent& e) {
 	Super::PostEditChangeProperty(e);
 }
 
+#endif
+
 void ULaserComponent::OnUpdateTransform(EUpdateTransformFlags Flags, ETeleportType Teleport)
 {
-	if (!NiagaraLaser) return;
+	Super::OnUpdateTransform(Flags, Teleport);
+
+	// The static geometry along the beam has to be traced again from the new transform.
+	bStaticHitValid = false;
+
+	// In game the beam end is updated with the laser's next trace.
+	if (!NiagaraLaser || LaserSubsystem != nullptr) return;
 
 	const FVector rot = GetComponentLocation() + GetComponentRotation().Vector() * LaserDistance;
 	NiagaraLaser->SetVectorParameter("Laser End", rot);
 }
 
-#endif
+void ULaserComponent::EnableBeamBounds(UBoxComponent* Bounds)
+{
+	// Overlaps come from the objects that move into the box, the box itself never sweeps.
+	Bounds->SetCollisionProfileName(UCollisionProfile::CustomCollisionProfileName);
+	Bounds->SetCollisionObjectType(ECC_WorldDynamic);
+	Bounds->SetCollisionResponseToAllChannels(ECR_Overlap);
+	Bounds->SetGenerateOverlapEvents(true);
+	Bounds->OnComponentBeginOverlap.AddUniqueDynamic(this, &ULaserComponent::OnBeamBeginOverlap);
+	Bounds->OnComponentEndOverlap.AddUniqueDynamic(this, &ULaserComponent::OnBeamEndOverlap);
+	Bounds->SetCollisionEnabled(ECollisionEnabled::QueryOnly);
+}
+
+void ULaserComponent::UpdateBeamBounds()
+{
+	if (!bBeamBoundsActive)
+	{
+		return;
+	}
+
+	// Until the static path is traced, the bounds cover the whole beam as if it didn't bounce.
+	const bool bHasPath = bStaticHitValid && StaticPath.Num() > 1;
+	const float Length = FMath::Max(bHasPath ? FVector::Dist(StaticPath[0], StaticPath[1]) : LaserDistance, 1.f);
+	BeamBounds->SetRelativeLocation(FVector(Length * 0.5f, 0.f, 0.f));
+	BeamBounds->SetBoxExtent(FVector(Length * 0.5f, BeamBoundsRadius, BeamBoundsRadius));
+
+	// Every segment after a bounce gets a box of its own, from the ones the laser already made if it can.
+	const int32 NumSegments = bHasPath ? StaticPath.Num() - 2 : 0;
+	for (int32 Index = 0; Index < NumSegments; ++Index)
+	{
+		if (Index >= SegmentBounds.Num())
+		{
+			UBoxComponent* NewBounds = NewObject<UBoxComponent>(GetOwner(), NAME_None, RF_Transient);
+			NewBounds->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+			NewBounds->SetCanEverAffectNavigation(false);
+			NewBounds->RegisterComponent();
+			SegmentBounds.Add(NewBounds);
+		}
+
+		const FVector& Start = StaticPath[Index + 1];
+		const FVector& End = StaticPath[Index + 2];
+		const float SegmentLength = FMath::Max(FVector::Dist(Start, End), 1.f);
+
+		UBoxComponent* Bounds = SegmentBounds[Index];
+		Bounds->SetWorldLocationAndRotation((Start + End) * 0.5f, (End - Start).Rotation());
+		Bounds->SetBoxExtent(FVector(SegmentLength * 0.5f, BeamBoundsRadius, BeamBoundsRadius));
+		if (!Bounds->IsCollisionEnabled())
+		{
+			EnableBeamBounds(Bounds);
+		}
+	}
+
+	for (int32 Index = NumSegments; Index < SegmentBounds.Num(); ++Index)
+	{
+		SegmentBounds[Index]->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	}
+}
+
+bool ULaserComponent::IsInBeamBounds(const UPrimitiveComponent* Component) const
+{
+	return BeamBounds->IsOverlappingComponent(Component)
+		|| SegmentBounds.ContainsByPredicate([Component](const UBoxComponent* Bounds) { return Bounds->IsOverlappingComponent(Component); });
+}
+
+void ULaserComponent::OnBeamBeginOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
+{
+	// Static objects are part of the cached trace, and other lasers' bounds don't block anything. Mirrors moving
+	// invalidate the cached path on their own.
+	if (OtherComp == nullptr || OtherActor == GetOwner() || OtherComp->Mobility != EComponentMobility::Movable || !BlocksLaser(OtherComp)
+		|| OtherComp->IsA<ULaserMirrorComponent>())
+	{
+		return;
+	}
+
+	// A pawn whose capsule blocks the beam is tested with its capsule, the rest of its components are covered by it.
+	const APawn* Pawn = Cast<APawn>(OtherActor);
+	UCapsuleComponent* Capsule = Pawn != nullptr ? Cast<UCapsuleComponent>(Pawn->GetRootComponent()) : nullptr;
+	if (Capsule != nullptr && BlocksLaser(Capsule))
+	{
+		if (OtherComp == Capsule)
+		{
+			BeamCapsules.AddUnique(Capsule);
+		}
+		return;
+	}
+
+	BeamMovables.AddUnique(OtherComp);
+}
+
+void ULaserComponent::OnBeamEndOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex)
+{
+	// Leaving the bounds of one segment doesn't take it out of the beam if it is still in another one's.
+	if (OtherComp != nullptr && IsInBeamBounds(OtherComp))
+	{
+		return;
+	}
+
+	BeamCapsules.Remove(Cast<UCapsuleComponent>(OtherComp));
+	BeamMovables.Remove(OtherComp);
+}
+
 void ULaserComponent::OnRegister()
 {
 	Super::OnRegister();
@@ -4,8 +4,35 @@
 
 #include "CoreMinimal.h"
 #include "Components/SceneComponent.h"
+#include "CollisionQueryParams.h"
+#include "Engine/EngineTypes.h"
 #include "LaserComponent.generated.h"
 
+class UBoxComponent;
+class UCapsuleComponent;
+class UPrimitiveComponent;
+class ULaserMirrorComponent;
+
+/** Points of a beam, from the laser through every mirror it bounces off to where it ends. */
+typedef TArray<FVector, TInlineAllocator<6>> FLaserPath;
+
+/** Outcome of ULaserComponent::TraceLaser(), applied on the game thread by ULaserComponent::ApplyTraceResult(). */
+struct FLaserTraceResult
+{
+	/** What the beam ends on, if bHit. */
+	FHitResult Hit;
+	bool bHit = false;
+
+	FLaserPath Path;
+
+	/** True if the path through the static geometry and mirrors was traced this time, rather than taken from the laser's cache. */
+	bool bTracedStatic = false;
+	bool bStaticHit = false;
+	FLaserPath StaticPath;
+
+	/** Mirror revision of the laser subsystem StaticPath was traced at, or the cached static path was checked against. */
+	int32 MirrorRevision = 0;
+};
 
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
 class STEALTHGAME_API ULaserComponent : public USceneComponent
@@ -24,9 +51,14 @@ protected:
 	
 #if WITH_EDITOR
 	virtual void PostEditChangeProperty(FPropertyChangedEvent& e) override;
-	virtual void OnUpdateTransform(EUpdateTransformFlags Flags, ETeleportType Teleport) override;
 #endif
+	virtual void OnUpdateTransform(EUpdateTransformFlags Flags, ETeleportType Teleport) override;
 	virtual void OnRegister() override;
+	virtual void InitializeComponent() override;
+	virtual void UninitializeComponent() override;
+
+	/** World end of the beam at full length. */
+	FVector GetLaserEnd() const;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 		FLinearColor LaserColor;
@@ -42,6 +74,10 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 		float LaserDistance;
 
+	/** How many times the beam may bounce off a ULaserMirrorComponent. LaserDistance is the length of the whole path. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (ClampMin = "0", ClampMax = "4"))
+		int32 MaxBounces;
+
 	UPROPERTY(BlueprintReadOnly)
 		class UNiagaraComponent* NiagaraLaser;
 
@@ -52,10 +88,164 @@ protected:
 	//Used to only notify player detection on the first frame that the player touches laser.
 	bool bIsLaserTouchingPlayer;
 
+	/** Player the laser is touching, while bIsLaserTouchingPlayer. */
+	TWeakObjectPtr<APawn> InterceptedPlayer;
+
+	/** Query params of TraceLaser(), built once the owner is known. */
+	FCollisionQueryParams TraceParams;
+
+	/**
+	 * If true, the distance to the static geometry blocking the beam is traced once and cached until the laser moves.
+	 * Pawns entering the beam are then found by BeamBounds and tested against the beam analytically with their capsule,
+	 * and the beam is only traced in full while some other movable object is inside it.
+	 * Movable objects that don't generate overlap events go unnoticed, disable it on lasers they can cut.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		bool bUseStaticFastPath;
+
+	/** Half thickness of BeamBounds. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (EditCondition = "bUseStaticFastPath", ClampMin = "0.1"))
+		float BeamBoundsRadius;
+
+	/** Thin box around the beam, up to the static geometry blocking it, reporting the movable objects that enter and leave it. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+		UBoxComponent* BeamBounds;
+
+	/** Boxes like BeamBounds around the segments of the cached path after a bounce. Kept with their collision off once unused. */
+	UPROPERTY(Transient)
+		TArray<UBoxComponent*> SegmentBounds;
+
+	/** Starts reporting overlaps of Bounds. */
+	void EnableBeamBounds(UBoxComponent* Bounds);
+
+	/** Fits BeamBounds and SegmentBounds to the cached static path. */
+	void UpdateBeamBounds();
+
+	/** True if Component overlaps any of the beam's bounds. */
+	bool IsInBeamBounds(const UPrimitiveComponent* Component) const;
+
+	UFUNCTION()
+		void OnBeamBeginOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
+
+	UFUNCTION()
+		void OnBeamEndOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex);
+
+	/** Query params of the static geometry trace, TraceParams limited to static objects. */
+	FCollisionQueryParams StaticTraceParams;
+
+	// Static fast path state. Only changed on the game thread, TraceLaser() reads it from the workers.
+
+	/** Capsules of the pawns inside BeamBounds that block the beam. Removed on end overlap, or once they are destroyed without one. */
+	TArray<TWeakObjectPtr<UCapsuleComponent>, TInlineAllocator<4>> BeamCapsules;
+
+	/** The live BeamCapsules, resolved by PrepareTrace() so the workers never touch a weak pointer. */
+	TArray<UCapsuleComponent*, TInlineAllocator<4>> TraceCapsules;
+
+	/** Other movable components inside BeamBounds that block the beam. The beam is traced in full while there are any. */
+	TArray<TWeakObjectPtr<UPrimitiveComponent>, TInlineAllocator<4>> BeamMovables;
+
+	/** True once BeamBounds is reporting overlaps. */
+	bool bBeamBoundsActive;
+
+	bool bStaticHitValid;
+	bool bStaticHit;
+	FLaserPath StaticPath;
+
+	/** LaserDistance the static path was traced with. */
+	float StaticHitLaserDistance;
+
+	/** Mirror revision of the laser subsystem the static path was traced at, or last found unaffected by mirror changes. */
+	int32 StaticPathMirrorRevision;
+
+	/**
+	 * Traces the beam through the mirrors, against the static geometry and the mirrors only if bStaticOnly.
+	 * @return true if the beam ends on something, OutHit.
+	 */
+	bool TracePath(bool bStaticOnly, FLaserPath& OutPath, FHitResult& OutHit) const;
+
+	/** Traces one segment of the path. */
+	bool TraceSegment(const FVector& Start, const FVector& End, bool bStaticOnly, FHitResult& OutHit) const;
+
+	/**
+	 * If true, players the beam sweeps across between two updates are intercepted too, found analytically from the area
+	 * swept by the beam rather than only along the beam where it is at each update. Use on lasers that rotate or oscillate.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		bool bSweepMode;
+
+	/** Seconds between updates of a sweeping laser, 0 to update it every frame. The beam effect follows at the same rate. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (EditCondition = "bSweepMode", ClampMin = "0.0"))
+		float SweepUpdateInterval;
+
+	/**
+	 * Appends the players whose capsule the area swept from the previous beam to the beam from Start to End crosses. The
+	 * players intercepted by the previous and by the current beam are left out, their notifications are sent as it is.
+	 */
+	void FindSweptPlayers(const FVector& Start, const FVector& End, const TArray<APawn*>& Players, const APawn* PreviousPlayer, const APawn* CurrentPlayer, TArray<APawn*, TInlineAllocator<4>>& OutSweptPlayers) const;
+
+	// Beam at the previous update, while bSweepValid.
+	bool bSweepValid;
+	FVector SweepStart;
+	FVector SweepEnd;
+
+	/** World time of the next update of a sweeping laser. */
+	float NextSweepUpdateTime;
+
+	/** Shows the beam along Path, and the impact effect at its end if bHit. */
+	void UpdateLaserFX(bool bHit, const FLaserPath& Path, const TArray<FVector>& ViewLocations);
+
+	/** Returns the pooled impact effect, if the laser holds one. */
+	void ReleasePooledImpact();
+
+	/** Draws the segments of Path after a bounce with pooled beam effects, pushing the ones that moved by more than the tolerance. */
+	void UpdatePooledSegments(const FLaserPath& Path, float ToleranceSquared);
+
+	/** Returns the pooled beam effects of the segments after a bounce, but the first NumToKeep. */
+	void ReleasePooledSegments(int32 NumToKeep = 0);
+
+	/** Laser subsystem of the world, set once the laser is initialized in a game world. */
+	UPROPERTY(Transient)
+		class ULaserSubsystem* LaserSubsystem;
+
+	/** Impact effect taken from the world's Niagara pool while the beam hits something in view, if effects are LODed. */
+	UPROPERTY(Transient)
+		class UNiagaraComponent* PooledImpact;
+
+	/** True while the beam effect is active, if effects are LODed. */
+	bool bLaserFXActive;
+
+	/** True once BeamFXEnd holds the beam end last pushed to the effects. */
+	bool bBeamFXEndValid;
+	FVector BeamFXEnd;
+
+	/** Location last given to PooledImpact. */
+	FVector ImpactFXLocation;
+
+	/** Beam effects of the segments after a bounce, taken from the world's Niagara pool, with their last pushed ends. */
+	UPROPERTY(Transient)
+		TArray<class UNiagaraComponent*> PooledSegments;
+	TArray<FVector> PooledSegmentStarts;
+	TArray<FVector> PooledSegmentEnds;
+
 public:	
-	// Called every frame
+	// Called every frame, unless the laser is updated by the ULaserSubsystem
 	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
+	/** False while a sweeping laser waits for its next update. */
+	bool IsUpdateDue(float WorldTime) const { return !bSweepMode || WorldTime >= NextSweepUpdateTime; }
+
+	/** Gets the laser ready for TraceLaser(). Called on the game thread before the traces. */
+	void PrepareTrace();
+
+	/** Finds what blocks the beam. Only reads the laser, the laser subsystem calls it from worker threads after PrepareTrace(). */
+	void TraceLaser(FLaserTraceResult& OutResult) const;
+
+	/**
+	 * Cuts the beam off at the result of TraceLaser() and notifies when one of Players starts or stops intercepting it.
+	 * ViewLocations are the local views the effects are LODed against, see ULaserSubsystem::GatherViewLocations().
+	 */
+	void ApplyTraceResult(const FLaserTraceResult& Result, const TArray<APawn*>& Players, const TArray<FVector>& ViewLocations);
+
 	UPROPERTY(BlueprintAssignable)
 		FLaserInterceptPlayerDelegate OnLaserStartInterceptPlayer;
 
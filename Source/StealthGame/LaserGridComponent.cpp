@@ -0,0 +1,391 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LaserGridComponent.h"
+#include "StealthGame.h"
+#include "LaserSubsystem.h"
+#include "NiagaraComponent.h"
+#include "NiagaraDataInterfaceArrayFunctionLibrary.h"
+#include "GameFramework/Pawn.h"
+
+#define ECC_LineOfSight ECC_GameTraceChannel2
+
+DECLARE_CYCLE_STAT(TEXT("Laser Grid Tick"), STAT_Sensing_LaserGridTick, STATGROUP_Sensing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Laser Grid Beam Traces"), STAT_Sensing_LaserGridTraces, STATGROUP_Sensing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Laser Grid FX Updates"), STAT_Sensing_LaserGridFXUpdates, STATGROUP_Sensing);
+
+static const FName NAME_BeamStarts(TEXT("Beam Starts"));
+static const FName NAME_BeamEnds(TEXT("Beam Ends"));
+static const FName NAME_BeamHits(TEXT("Beam Hits"));
+
+ULaserGridComponent::ULaserGridComponent()
+{
+	Pattern = ELaserGridPattern::Parallel;
+	NumBeams = 5;
+	NumRows = 3;
+	BeamSpacing = 30.f;
+	FanAngle = 60.f;
+	LaserDistance = 500.f;
+	LaserColor = FColor::Magenta;
+
+	NiagaraBeams = CreateDefaultSubobject<UNiagaraComponent>(TEXT("NiagaraBeams"));
+	NiagaraBeams->AttachToComponent(this, FAttachmentTransformRules::KeepRelativeTransform);
+
+	PatternRadius = 0.f;
+	bBeamEndsValid = false;
+	LaserSubsystem = nullptr;
+	bBeamsFXActive = false;
+	bBeamsFXDirty = true;
+
+	PrimaryComponentTick.bCanEverTick = true;
+	bWantsOnUpdateTransform = true;
+	bWantsInitializeComponent = true;
+	bAutoActivate = true;
+}
+
+void ULaserGridComponent::OnRegister()
+{
+	Super::OnRegister();
+
+	NiagaraBeams->SetColorParameter(TEXT("Color"), LaserColor);
+
+	// Outside of game worlds the beams are drawn at full length.
+	BuildPattern();
+	UpdateBeamEnds();
+	BeamHitEnds = BeamEnds;
+	UpdateBeamsFX(TArray<FVector>());
+}
+
+void ULaserGridComponent::OnUpdateTransform(EUpdateTransformFlags Flags, ETeleportType Teleport)
+{
+	Super::OnUpdateTransform(Flags, Teleport);
+
+	// In game the beams are moved with the grid's next update.
+	if (LaserSubsystem == nullptr && BeamStarts.Num() > 0)
+	{
+		UpdateBeamEnds();
+		BeamHitEnds = BeamEnds;
+		UpdateBeamsFX(TArray<FVector>());
+	}
+}
+
+void ULaserGridComponent::InitializeComponent()
+{
+	Super::InitializeComponent();
+
+	TraceParams = FCollisionQueryParams(SCENE_QUERY_STAT(LaserGridTrace), false, GetOwner()); // ignore collision with self
+
+	// Grids batched by the laser subsystem don't need a tick of their own.
+	UWorld* World = GetWorld();
+	LaserSubsystem = World != nullptr ? World->GetSubsystem<ULaserSubsystem>() : nullptr;
+	if (LaserSubsystem != nullptr && LaserSubsystem->RegisterLaserGrid(this))
+	{
+		SetComponentTickEnabled(false);
+	}
+
+	// LODed effects stay off until a view gets close.
+	if (LaserSubsystem != nullptr && LaserSubsystem->IsLaserFXLODEnabled())
+	{
+		NiagaraBeams->SetAutoActivate(false);
+		NiagaraBeams->Deactivate();
+		bBeamsFXActive = false;
+	}
+}
+
+void ULaserGridComponent::UninitializeComponent()
+{
+	if (LaserSubsystem != nullptr)
+	{
+		LaserSubsystem->UnregisterLaserGrid(this);
+		LaserSubsystem = nullptr;
+	}
+
+	for (TWeakObjectPtr<APawn>& Player : BeamInterceptedPlayers)
+	{
+		Player.Reset();
+	}
+	InterceptedPlayers.Reset();
+
+	Super::UninitializeComponent();
+}
+
+#if WITH_EDITOR
+void ULaserGridComponent::PostEditChangeProperty(FPropertyChangedEvent& e)
+{
+	if (e.GetPropertyName() == GET_MEMBER_NAME_CHECKED(ULaserGridComponent, NiagaraBeamsSystem))
+	{
+		NiagaraBeams->SetAsset(NiagaraBeamsSystem);
+	}
+
+	if (e.GetPropertyName() == GET_MEMBER_NAME_CHECKED(ULaserGridComponent, LaserColor))
+	{
+		NiagaraBeams->SetColorParameter(TEXT("Color"), LaserColor);
+	}
+
+	Super::PostEditChangeProperty(e);
+}
+#endif
+
+void ULaserGridComponent::BuildPattern()
+{
+	LocalBeamStarts.Reset();
+	LocalBeamDirections.Reset();
+
+	const float HalfColumns = (NumBeams - 1) * 0.5f;
+	switch (Pattern)
+	{
+	case ELaserGridPattern::Parallel:
+		for (int32 Index = 0; Index < NumBeams; ++Index)
+		{
+			LocalBeamStarts.Add(FVector(0.f, 0.f, (Index - HalfColumns) * BeamSpacing));
+			LocalBeamDirections.Add(FVector::ForwardVector);
+		}
+		break;
+
+	case ELaserGridPattern::Fan:
+	{
+		// A full circle would put the last beam on top of the first one.
+		const bool bFullCircle = FanAngle >= 360.f - KINDA_SMALL_NUMBER;
+		const float Step = NumBeams > 1 ? FanAngle / (bFullCircle ? NumBeams : NumBeams - 1) : 0.f;
+		const float FirstYaw = bFullCircle ? 0.f : -(NumBeams - 1) * Step * 0.5f;
+		for (int32 Index = 0; Index < NumBeams; ++Index)
+		{
+			LocalBeamStarts.Add(FVector::ZeroVector);
+			LocalBeamDirections.Add(FRotator(0.f, FirstYaw + Index * Step, 0.f).Vector());
+		}
+		break;
+	}
+
+	case ELaserGridPattern::Lattice:
+	{
+		const float HalfRows = (NumRows - 1) * 0.5f;
+		for (int32 Row = 0; Row < NumRows; ++Row)
+		{
+			for (int32 Column = 0; Column < NumBeams; ++Column)
+			{
+				LocalBeamStarts.Add(FVector(0.f, (Column - HalfColumns) * BeamSpacing, (Row - HalfRows) * BeamSpacing));
+				LocalBeamDirections.Add(FVector::ForwardVector);
+			}
+		}
+		break;
+	}
+	}
+
+	PatternRadius = 0.f;
+	for (const FVector& Start : LocalBeamStarts)
+	{
+		PatternRadius = FMath::Max(PatternRadius, Start.Size());
+	}
+
+	const int32 Num = LocalBeamStarts.Num();
+	BeamStarts.SetNumUninitialized(Num);
+	BeamEnds.SetNumUninitialized(Num);
+	BeamHitEnds.SetNumZeroed(Num);
+	BeamHits.Init(0.f, Num);
+	BeamInterceptedPlayers.Reset();
+	BeamInterceptedPlayers.SetNum(Num);
+	InterceptedPlayers.Reset();
+	bBeamEndsValid = false;
+	bBeamsFXDirty = true;
+}
+
+void ULaserGridComponent::UpdateBeamEnds()
+{
+	const FTransform& Transform = GetComponentTransform();
+	if (bBeamEndsValid && Transform.Equals(BeamEndsTransform, KINDA_SMALL_NUMBER))
+	{
+		return;
+	}
+
+	// One pass over the pattern with the transform's vectorized math. The beams keep their length whatever the scale,
+	// like a ULaserComponent's.
+	const int32 Num = LocalBeamStarts.Num();
+	for (int32 Index = 0; Index < Num; ++Index)
+	{
+		BeamStarts[Index] = Transform.TransformPosition(LocalBeamStarts[Index]);
+		BeamEnds[Index] = BeamStarts[Index] + Transform.TransformVectorNoScale(LocalBeamDirections[Index]) * LaserDistance;
+	}
+
+	BeamEndsTransform = Transform;
+	bBeamEndsValid = true;
+	bBeamsFXDirty = true;
+}
+
+// Called every frame
+void ULaserGridComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	SCOPE_CYCLE_COUNTER(STAT_Sensing_LaserGridTick);
+	TRACE_CPUPROFILER_EVENT_SCOPE(ULaserGridComponent::TickComponent);
+	STEALTH_FRAME_COST_SCOPE(Lasers);
+
+	TArray<APawn*> Players;
+	ULaserSubsystem::GatherPlayerPawns(GetWorld(), Players);
+	TArray<FVector> ViewLocations;
+	ULaserSubsystem::GatherViewLocations(GetWorld(), ViewLocations);
+
+	PrepareBeams();
+
+	TArray<FLaserTraceResult> Results;
+	Results.SetNum(GetNumBeams());
+	for (int32 Index = 0; Index < Results.Num(); ++Index)
+	{
+		TraceBeam(Index, Results[Index]);
+	}
+	ApplyBeamResults(Results, Players, ViewLocations);
+}
+
+void ULaserGridComponent::TraceBeam(int32 BeamIndex, FLaserTraceResult& OutResult) const
+{
+	INC_DWORD_STAT(STAT_Sensing_LaserGridTraces);
+
+	OutResult.bHit = GetWorld()->LineTraceSingleByChannel(OutResult.Hit, BeamStarts[BeamIndex], BeamEnds[BeamIndex], ECC_LineOfSight, TraceParams);
+}
+
+void ULaserGridComponent::ApplyBeamResults(TArrayView<const FLaserTraceResult> Results, const TArray<APawn*>& Players, const TArray<FVector>& ViewLocations)
+{
+	if (Results.Num() != GetNumBeams())
+	{
+		return;
+	}
+
+	struct FBeamEvent
+	{
+		int32 BeamIndex;
+		APawn* Pawn;
+		bool bStart;
+	};
+	TArray<FBeamEvent, TInlineAllocator<8>> BeamEvents;
+
+	const float EndToleranceSquared = LaserSubsystem != nullptr ? FMath::Square(LaserSubsystem->GetLaserFXEndTolerance()) : 0.f;
+	for (int32 Index = 0; Index < Results.Num(); ++Index)
+	{
+		const FLaserTraceResult& Result = Results[Index];
+
+		//cut the beam off where it hits something, or leave it at its max distance
+		const FVector HitEnd = Result.bHit ? Result.Hit.Location : BeamEnds[Index];
+		const float Hit = Result.bHit ? 1.f : 0.f;
+		if (Hit != BeamHits[Index] || FVector::DistSquared(HitEnd, BeamHitEnds[Index]) > EndToleranceSquared)
+		{
+			BeamHitEnds[Index] = HitEnd;
+			BeamHits[Index] = Hit;
+			bBeamsFXDirty = true;
+		}
+
+		APawn* HitPlayer = nullptr;
+		if (Result.bHit)
+		{
+			const AActor* HitActor = Result.Hit.GetActor();
+			APawn* const* Player = Players.FindByPredicate([HitActor](const APawn* Candidate) { return Candidate == HitActor; });
+			HitPlayer = Player != nullptr ? *Player : nullptr;
+		}
+
+		// Same as a ULaserComponent: stop intercepting the previous player, then start intercepting the new one.
+		TWeakObjectPtr<APawn>& InterceptedPlayer = BeamInterceptedPlayers[Index];
+		if (!InterceptedPlayer.IsExplicitlyNull() && HitPlayer != InterceptedPlayer.Get())
+		{
+			BeamEvents.Add({ Index, InterceptedPlayer.Get(), false });
+			InterceptedPlayer.Reset();
+		}
+
+		if (HitPlayer != nullptr && InterceptedPlayer.IsExplicitlyNull())
+		{
+			InterceptedPlayer = HitPlayer;
+			BeamEvents.Add({ Index, HitPlayer, true });
+		}
+	}
+
+	UpdateBeamsFX(ViewLocations);
+
+	// The grid as a whole is intercepted by the players touching any of its beams.
+	TArray<APawn*, TInlineAllocator<4>> TouchingPlayers;
+	for (const TWeakObjectPtr<APawn>& Player : BeamInterceptedPlayers)
+	{
+		if (Player.IsValid())
+		{
+			TouchingPlayers.AddUnique(Player.Get());
+		}
+	}
+
+	TArray<APawn*, TInlineAllocator<4>> StoppedPlayers;
+	for (int32 Index = InterceptedPlayers.Num() - 1; Index >= 0; --Index)
+	{
+		if (!TouchingPlayers.Contains(InterceptedPlayers[Index].Get()))
+		{
+			StoppedPlayers.Add(InterceptedPlayers[Index].Get());
+			InterceptedPlayers.RemoveAt(Index);
+		}
+	}
+
+	TArray<APawn*, TInlineAllocator<4>> StartedPlayers;
+	for (APawn* Player : TouchingPlayers)
+	{
+		if (!InterceptedPlayers.Contains(Player))
+		{
+			InterceptedPlayers.Add(Player);
+			StartedPlayers.Add(Player);
+		}
+	}
+
+	// Broadcast once the grid is up to date, listeners may change or destroy it.
+	for (const FBeamEvent& Event : BeamEvents)
+	{
+		(Event.bStart ? OnBeamStartInterceptPlayer : OnBeamStopInterceptPlayer).Broadcast(Event.BeamIndex, Event.Pawn);
+	}
+	for (APawn* Player : StoppedPlayers)
+	{
+		OnLaserStopInterceptPlayer.Broadcast(Player);
+	}
+	for (APawn* Player : StartedPlayers)
+	{
+		OnLaserStartInterceptPlayer.Broadcast(Player);
+	}
+}
+
+void ULaserGridComponent::UpdateBeamsFX(const TArray<FVector>& ViewLocations)
+{
+	if (NiagaraBeams == nullptr)
+	{
+		return;
+	}
+
+	// Only grids some local view is close to are worth simulating and drawing.
+	if (LaserSubsystem != nullptr && LaserSubsystem->IsLaserFXLODEnabled())
+	{
+		const FVector Origin = GetComponentLocation();
+		const float ReachSquared = FMath::Square(LaserSubsystem->GetLaserFXViewDistance() + LaserDistance + PatternRadius);
+		const bool bInView = ViewLocations.ContainsByPredicate([&Origin, ReachSquared](const FVector& View)
+		{
+			return FVector::DistSquared(View, Origin) <= ReachSquared;
+		});
+
+		if (!bInView)
+		{
+			if (bBeamsFXActive)
+			{
+				NiagaraBeams->Deactivate();
+				bBeamsFXActive = false;
+			}
+			return;
+		}
+
+		if (!bBeamsFXActive)
+		{
+			NiagaraBeams->Activate(true);
+			bBeamsFXActive = true;
+			bBeamsFXDirty = true;
+		}
+	}
+
+	if (!bBeamsFXDirty)
+	{
+		return;
+	}
+
+	INC_DWORD_STAT(STAT_Sensing_LaserGridFXUpdates);
+	UNiagaraDataInterfaceArrayFunctionLibrary::SetNiagaraArrayVector(NiagaraBeams, NAME_BeamStarts, BeamStarts);
+	UNiagaraDataInterfaceArrayFunctionLibrary::SetNiagaraArrayVector(NiagaraBeams, NAME_BeamEnds, BeamHitEnds);
+	UNiagaraDataInterfaceArrayFunctionLibrary::SetNiagaraArrayFloat(NiagaraBeams, NAME_BeamHits, BeamHits);
+	bBeamsFXDirty = false;
+}
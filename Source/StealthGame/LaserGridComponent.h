@@ -0,0 +1,154 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/SceneComponent.h"
+#include "CollisionQueryParams.h"
+#include "LaserComponent.h"
+#include "LaserGridComponent.generated.h"
+
+class UNiagaraComponent;
+class UNiagaraSystem;
+class ULaserSubsystem;
+
+/** How the beams of a ULaserGridComponent are laid out, in the component's space. All beams point along +X. */
+UENUM(BlueprintType)
+enum class ELaserGridPattern : uint8
+{
+	/** NumBeams beams stacked BeamSpacing apart along Z, centered on the component. */
+	Parallel,
+	/** NumBeams beams from the component's origin, spread evenly over FanAngle degrees of yaw. */
+	Fan,
+	/** NumBeams columns along Y by NumRows rows along Z, BeamSpacing apart, centered on the component. */
+	Lattice,
+};
+
+/**
+ * A set of laser beams emitted by one component, in place of one ULaserComponent per beam for fences and grids.
+ * Every beam traces and intercepts players like a ULaserComponent does, but their ends are computed together, their
+ * traces run with the laser subsystem's batch, and they are all drawn by a single Niagara system. That system reads the
+ * beams from the "Beam Starts" and "Beam Ends" vector arrays and "Beam Hits" float array (1 where a beam is blocked).
+ */
+UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
+class STEALTHGAME_API ULaserGridComponent : public USceneComponent
+{
+	GENERATED_BODY()
+
+	DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FLaserGridBeamInterceptPlayerDelegate, int32, BeamIndex, APawn*, Pawn);
+	DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FLaserGridInterceptPlayerDelegate, APawn*, Pawn);
+
+public:
+	ULaserGridComponent();
+
+protected:
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& e) override;
+#endif
+	virtual void OnRegister() override;
+	virtual void OnUpdateTransform(EUpdateTransformFlags Flags, ETeleportType Teleport) override;
+	virtual void InitializeComponent() override;
+	virtual void UninitializeComponent() override;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		ELaserGridPattern Pattern;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (ClampMin = "1"))
+		int32 NumBeams;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (EditCondition = "Pattern == ELaserGridPattern::Lattice", ClampMin = "1"))
+		int32 NumRows;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (EditCondition = "Pattern != ELaserGridPattern::Fan"))
+		float BeamSpacing;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (EditCondition = "Pattern == ELaserGridPattern::Fan", ClampMin = "0.0", ClampMax = "360.0"))
+		float FanAngle;
+
+	//how far do the beams reach
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		float LaserDistance;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		FLinearColor LaserColor;
+
+	/** Draws every beam, see the class comment for the parameters it reads. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		UNiagaraSystem* NiagaraBeamsSystem;
+
+	UPROPERTY(BlueprintReadOnly)
+		UNiagaraComponent* NiagaraBeams;
+
+	/** Lays the beams out again in the component's space, after the pattern changed. */
+	void BuildPattern();
+
+	/** Moves the beams to the component's current transform, if it changed since they were last moved. */
+	void UpdateBeamEnds();
+
+	/** Pushes the beams to NiagaraBeams, if they changed since they were last pushed or the effect just activated. */
+	void UpdateBeamsFX(const TArray<FVector>& ViewLocations);
+
+	// Beams in the component's space, from BuildPattern().
+	TArray<FVector> LocalBeamStarts;
+	TArray<FVector> LocalBeamDirections;
+
+	/** Largest distance of a beam start from the component's origin. */
+	float PatternRadius;
+
+	// Beams in world space, from UpdateBeamEnds().
+	TArray<FVector> BeamStarts;
+	TArray<FVector> BeamEnds;
+
+	/** Component transform BeamStarts and BeamEnds were computed with, while bBeamEndsValid. */
+	FTransform BeamEndsTransform;
+	bool bBeamEndsValid;
+
+	// Outcome of the last update of every beam. The ends only follow the beams' hits once they move by the laser
+	// subsystem's FX end tolerance.
+	TArray<FVector> BeamHitEnds;
+	TArray<float> BeamHits;
+	TArray<TWeakObjectPtr<APawn>> BeamInterceptedPlayers;
+
+	/** Players touching at least one beam, for OnLaserStartInterceptPlayer and OnLaserStopInterceptPlayer. */
+	TArray<TWeakObjectPtr<APawn>, TInlineAllocator<4>> InterceptedPlayers;
+
+	/** Query params of TraceBeam(), built once the owner is known. */
+	FCollisionQueryParams TraceParams;
+
+	UPROPERTY(Transient)
+		ULaserSubsystem* LaserSubsystem;
+
+	bool bBeamsFXActive;
+	bool bBeamsFXDirty;
+
+public:
+	// Called every frame, unless the grid is updated by the ULaserSubsystem
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	/** Moves the beams to the component's transform ahead of the traces. Called on the game thread. */
+	void PrepareBeams() { UpdateBeamEnds(); }
+
+	int32 GetNumBeams() const { return BeamStarts.Num(); }
+
+	/** Finds what blocks beam BeamIndex. Only reads the grid, the laser subsystem calls it from worker threads. */
+	void TraceBeam(int32 BeamIndex, FLaserTraceResult& OutResult) const;
+
+	/** Cuts every beam off at its result of TraceBeam() and notifies the players starting or stopping to intercept them. */
+	void ApplyBeamResults(TArrayView<const FLaserTraceResult> Results, const TArray<APawn*>& Players, const TArray<FVector>& ViewLocations);
+
+	/** Broadcast when a player starts intercepting one of the beams. */
+	UPROPERTY(BlueprintAssignable)
+		FLaserGridBeamInterceptPlayerDelegate OnBeamStartInterceptPlayer;
+
+	/** Broadcast when a player stops intercepting one of the beams. */
+	UPROPERTY(BlueprintAssignable)
+		FLaserGridBeamInterceptPlayerDelegate OnBeamStopInterceptPlayer;
+
+	/** Broadcast when a player starts intercepting the grid, on the first beam they touch, like ULaserComponent's. */
+	UPROPERTY(BlueprintAssignable)
+		FLaserGridInterceptPlayerDelegate OnLaserStartInterceptPlayer;
+
+	/** Broadcast when a player stops intercepting the grid, once they touch none of its beams. */
+	UPROPERTY(BlueprintAssignable)
+		FLaserGridInterceptPlayerDelegate OnLaserStopInterceptPlayer;
+};
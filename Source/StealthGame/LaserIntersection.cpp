@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LaserIntersection.h"
+
+bool LaserIntersection::IntersectRayCapsule(const FVector& Start, const FVector& Dir, const FVector& A, const FVector& B, float Radius, float& OutDistance)
+{
+	// Already inside, the same as the start penetrating hit a line trace reports.
+	if (FMath::PointDistToSegmentSquared(Start, A, B) <= Radius * Radius)
+	{
+		OutDistance = 0.f;
+		return true;
+	}
+
+	const FVector AB = B - A;
+	const FVector AO = Start - A;
+	const float ABdAB = AB | AB;
+	const float ABdD = AB | Dir;
+	const float ABdAO = AB | AO;
+	const float DdAO = Dir | AO;
+	const float AOdAO = AO | AO;
+
+	// Infinite cylinder around the axis first, then the hemisphere at whichever end the ray reached the cylinder beyond.
+	float CapAxisPosition = ABdAO;
+	const float QuadA = ABdAB - ABdD * ABdD;
+	if (QuadA > KINDA_SMALL_NUMBER)
+	{
+		const float QuadB = ABdAB * DdAO - ABdAO * ABdD;
+		const float QuadC = ABdAB * AOdAO - ABdAO * ABdAO - Radius * Radius * ABdAB;
+		const float Discriminant = QuadB * QuadB - QuadA * QuadC;
+		if (Discriminant < 0.f)
+		{
+			return false;
+		}
+
+		const float Distance = (-QuadB - FMath::Sqrt(Discriminant)) / QuadA;
+		CapAxisPosition = ABdAO + Distance * ABdD;
+		if (CapAxisPosition > 0.f && CapAxisPosition < ABdAB)
+		{
+			OutDistance = Distance;
+			return Distance >= 0.f;
+		}
+	}
+	else
+	{
+		// Along the axis, only the near cap can be hit.
+		CapAxisPosition = ABdD > 0.f ? 0.f : ABdAB;
+	}
+
+	const FVector CapToStart = CapAxisPosition <= 0.f ? AO : Start - B;
+	const float CapB = Dir | CapToStart;
+	const float CapC = (CapToStart | CapToStart) - Radius * Radius;
+	const float CapDiscriminant = CapB * CapB - CapC;
+	if (CapDiscriminant <= 0.f)
+	{
+		return false;
+	}
+
+	OutDistance = -CapB - FMath::Sqrt(CapDiscriminant);
+	return OutDistance >= 0.f;
+}
+
+bool LaserIntersection::IntersectCapsuleTriangle(const FVector& P0, const FVector& P1, float Radius, const FVector& A, const FVector& B, const FVector& C)
+{
+	FVector Intersection;
+	FVector Normal;
+	if (FMath::SegmentTriangleIntersection(P0, P1, A, B, C, Intersection, Normal))
+	{
+		return true;
+	}
+
+	// Otherwise the segment is closest to the triangle at one of its ends, or to one of the triangle's edges.
+	const float RadiusSquared = Radius * Radius;
+	if (FVector::DistSquared(P0, FMath::ClosestPointOnTriangleToPoint(P0, A, B, C)) <= RadiusSquared
+		|| FVector::DistSquared(P1, FMath::ClosestPointOnTriangleToPoint(P1, A, B, C)) <= RadiusSquared)
+	{
+		return true;
+	}
+
+	const FVector Edges[3][2] = { { A, B }, { B, C }, { C, A } };
+	for (const FVector(&Edge)[2] : Edges)
+	{
+		FVector OnSegment;
+		FVector OnEdge;
+		FMath::SegmentDistToSegmentSafe(P0, P1, Edge[0], Edge[1], OnSegment, OnEdge);
+		if (FVector::DistSquared(OnSegment, OnEdge) <= RadiusSquared)
+		{
+			return true;
+		}
+	}
+	return false;
+}
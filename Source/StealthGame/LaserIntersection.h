@@ -0,0 +1,19 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Analytic tests the lasers use in place of physics queries against pawn capsules. */
+namespace LaserIntersection
+{
+	/**
+	 * Distance along the ray from Start in unit direction Dir at which it enters the capsule around the segment A-B.
+	 * A ray that starts inside the capsule hits it at distance 0, like a line trace that starts penetrating.
+	 * @return false if the ray misses the capsule.
+	 */
+	STEALTHGAME_API bool IntersectRayCapsule(const FVector& Start, const FVector& Dir, const FVector& A, const FVector& B, float Radius, float& OutDistance);
+
+	/** True if the capsule around the segment P0-P1 touches the triangle A-B-C. */
+	STEALTHGAME_API bool IntersectCapsuleTriangle(const FVector& P0, const FVector& P1, float Radius, const FVector& A, const FVector& B, const FVector& C);
+}
@@ -0,0 +1,51 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LaserMirrorComponent.h"
+#include "LaserSubsystem.h"
+#include "Engine/World.h"
+
+ULaserMirrorComponent::ULaserMirrorComponent()
+{
+	LaserSubsystem = nullptr;
+	ReportedBounds = FBox(ForceInit);
+
+	bWantsOnUpdateTransform = true;
+}
+
+void ULaserMirrorComponent::OnRegister()
+{
+	Super::OnRegister();
+
+	UWorld* World = GetWorld();
+	LaserSubsystem = World != nullptr ? World->GetSubsystem<ULaserSubsystem>() : nullptr;
+	if (LaserSubsystem != nullptr)
+	{
+		ReportedBounds = Bounds.GetBox();
+		LaserSubsystem->RegisterMirror(this);
+	}
+}
+
+void ULaserMirrorComponent::OnUnregister()
+{
+	if (LaserSubsystem != nullptr)
+	{
+		LaserSubsystem->UnregisterMirror(this);
+		LaserSubsystem = nullptr;
+	}
+
+	Super::OnUnregister();
+}
+
+void ULaserMirrorComponent::OnUpdateTransform(EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	Super::OnUpdateTransform(UpdateTransformFlags, Teleport);
+
+	// Beams that bounced off the mirror where it was, or that cross where it is now, have to find their way again.
+	if (LaserSubsystem != nullptr)
+	{
+		const FBox NewBounds = CalcBounds(GetComponentTransform()).GetBox();
+		LaserSubsystem->NotifyMirrorChanged(ReportedBounds + NewBounds);
+		ReportedBounds = NewBounds;
+	}
+}
@@ -0,0 +1,36 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/StaticMeshComponent.h"
+#include "LaserMirrorComponent.generated.h"
+
+class ULaserSubsystem;
+
+/**
+ * A mesh that reflects the beams of the ULaserComponents hitting it, up to each laser's MaxBounces. Lasers cache the
+ * path of their beam through the mirrors, so mirrors report the space they change to the laser subsystem whenever they
+ * move, appear or go away. Only the lasers whose path crosses that space trace it again.
+ * The mesh has to block the laser trace channel to be hit at all.
+ */
+UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
+class STEALTHGAME_API ULaserMirrorComponent : public UStaticMeshComponent
+{
+	GENERATED_BODY()
+
+public:
+	ULaserMirrorComponent();
+
+protected:
+	virtual void OnRegister() override;
+	virtual void OnUnregister() override;
+	virtual void OnUpdateTransform(EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport) override;
+
+	/** Laser subsystem the mirror is registered with, in game worlds. */
+	UPROPERTY(Transient)
+		ULaserSubsystem* LaserSubsystem;
+
+	/** World bounds as last reported to the laser subsystem. */
+	FBox ReportedBounds;
+};
@@ -0,0 +1,289 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LaserSubsystem.h"
+#include "StealthGame.h"
+#include "LaserComponent.h"
+#include "LaserGridComponent.h"
+#include "LaserMirrorComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/Pawn.h"
+#include "Async/ParallelFor.h"
+
+DECLARE_CYCLE_STAT(TEXT("Laser Batch"), STAT_Sensing_LaserBatch, STATGROUP_Sensing);
+DECLARE_CYCLE_STAT(TEXT("Laser Batch Traces"), STAT_Sensing_LaserBatchTraces, STATGROUP_Sensing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Lasers Updated"), STAT_Sensing_LasersUpdated, STATGROUP_Sensing);
+
+ULaserSubsystem::ULaserSubsystem()
+{
+	bBatchLaserTraces = true;
+	MinParallelLaserTraces = 64;
+	bLaserFXLOD = true;
+	LaserFXViewDistance = 6000.f;
+	LaserFXEndTolerance = 1.f;
+	MaxMirrorChanges = 64;
+	MirrorRevision = 0;
+	ForgottenMirrorRevision = 0;
+}
+
+bool ULaserSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	// Lasers only trace in game and PIE worlds, the editor just draws them at full length.
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World != nullptr && World->IsGameWorld();
+}
+
+void ULaserSubsystem::Deinitialize()
+{
+	Lasers.Reset();
+	LaserGrids.Reset();
+	Mirrors.Reset();
+	MirrorChanges.Reset();
+	BatchLasers.Reset();
+	BatchGrids.Reset();
+	BatchGridBeams.Reset();
+	BatchGridNumBeams.Reset();
+	PlayerPawns.Reset();
+	ViewLocations.Reset();
+	TraceResults.Reset();
+
+	Super::Deinitialize();
+}
+
+ETickableTickType ULaserSubsystem::GetTickableTickType() const
+{
+	// The CDO is constructed like any other instance, make sure it never ends up ticking.
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool ULaserSubsystem::IsTickable() const
+{
+	return Lasers.Num() > 0 || LaserGrids.Num() > 0;
+}
+
+TStatId ULaserSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(ULaserSubsystem, STATGROUP_Tickables);
+}
+
+UWorld* ULaserSubsystem::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
+
+void ULaserSubsystem::GatherPlayerPawns(const UWorld* World, TArray<APawn*>& OutPawns)
+{
+	for (FConstPlayerControllerIterator Iterator = World->GetPlayerControllerIterator(); Iterator; ++Iterator)
+	{
+		APlayerController* PC = Iterator->Get();
+		APawn* Pawn = IsValid(PC) ? PC->GetPawn() : nullptr;
+		if (IsValid(Pawn))
+		{
+			OutPawns.Add(Pawn);
+		}
+	}
+}
+
+void ULaserSubsystem::GatherViewLocations(const UWorld* World, TArray<FVector>& OutLocations)
+{
+	for (FConstPlayerControllerIterator Iterator = World->GetPlayerControllerIterator(); Iterator; ++Iterator)
+	{
+		APlayerController* PC = Iterator->Get();
+		if (IsValid(PC) && PC->IsLocalController())
+		{
+			FVector Location;
+			FRotator Rotation;
+			PC->GetPlayerViewPoint(Location, Rotation);
+			OutLocations.Add(Location);
+		}
+	}
+}
+
+void ULaserSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_Sensing_LaserBatch);
+	TRACE_CPUPROFILER_EVENT_SCOPE(ULaserSubsystem::Tick);
+	STEALTH_FRAME_COST_SCOPE(Lasers);
+
+	const UWorld* World = GetWorld();
+	if (!IsValid(World))
+	{
+		return;
+	}
+
+	// Every laser compares its hit against the same players and shows its effects to the same views, gather them once.
+	PlayerPawns.Reset();
+	GatherPlayerPawns(World, PlayerPawns);
+	ViewLocations.Reset();
+	GatherViewLocations(World, ViewLocations);
+
+	// Resolved here rather than on the workers, inactive lasers and sweeping lasers waiting for their next update are left
+	// out. Lasers registered or unregistered while the results are applied only join or leave the batch on the next frame.
+	const float WorldTime = World->GetTimeSeconds();
+	BatchLasers.Reset();
+	for (const TWeakObjectPtr<ULaserComponent>& Laser : Lasers)
+	{
+		if (Laser.IsValid() && Laser->IsActive() && Laser->IsUpdateDue(WorldTime))
+		{
+			Laser->PrepareTrace();
+			BatchLasers.Add(Laser.Get());
+		}
+	}
+
+	// Grids move their beams to their transform here, the workers only trace them.
+	BatchGrids.Reset();
+	BatchGridBeams.Reset();
+	BatchGridNumBeams.Reset();
+	for (const TWeakObjectPtr<ULaserGridComponent>& Grid : LaserGrids)
+	{
+		if (Grid.IsValid() && Grid->IsActive())
+		{
+			Grid->PrepareBeams();
+			const int32 GridIndex = BatchGrids.Add(Grid.Get());
+			BatchGridNumBeams.Add(Grid->GetNumBeams());
+			for (int32 BeamIndex = 0; BeamIndex < Grid->GetNumBeams(); ++BeamIndex)
+			{
+				BatchGridBeams.Add(FIntPoint(GridIndex, BeamIndex));
+			}
+		}
+	}
+
+	const int32 NumLasers = BatchLasers.Num();
+	const int32 NumTraces = NumLasers + BatchGridBeams.Num();
+	TraceResults.SetNum(NumTraces, false);
+	INC_DWORD_STAT_BY(STAT_Sensing_LasersUpdated, NumTraces);
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_Sensing_LaserBatchTraces);
+
+		// Scene queries are safe from any thread as long as nothing moves, and nothing does until the traces are done.
+		// Each worker only reads its laser or grid and writes its own result.
+		ParallelFor(NumTraces, [this, NumLasers](int32 Index)
+		{
+			TraceResults[Index] = FLaserTraceResult();
+			if (Index < NumLasers)
+			{
+				BatchLasers[Index]->TraceLaser(TraceResults[Index]);
+			}
+			else
+			{
+				const FIntPoint& GridBeam = BatchGridBeams[Index - NumLasers];
+				BatchGrids[GridBeam.X]->TraceBeam(GridBeam.Y, TraceResults[Index]);
+			}
+		}, NumTraces < MinParallelLaserTraces);
+	}
+
+	for (int32 Index = 0; Index < NumLasers; ++Index)
+	{
+		// An earlier laser's notification may have destroyed this one.
+		ULaserComponent* Laser = BatchLasers[Index];
+		if (IsValid(Laser))
+		{
+			Laser->ApplyTraceResult(TraceResults[Index], PlayerPawns, ViewLocations);
+		}
+	}
+
+	// The beams of each grid are contiguous, in the order of the grids.
+	int32 FirstBeamTrace = NumLasers;
+	for (int32 GridIndex = 0; GridIndex < BatchGrids.Num(); ++GridIndex)
+	{
+		// An earlier notification may have destroyed this grid too.
+		ULaserGridComponent* Grid = BatchGrids[GridIndex];
+		const int32 NumBeams = BatchGridNumBeams[GridIndex];
+		if (IsValid(Grid))
+		{
+			Grid->ApplyBeamResults(TArrayView<const FLaserTraceResult>(TraceResults.GetData() + FirstBeamTrace, NumBeams), PlayerPawns, ViewLocations);
+		}
+		FirstBeamTrace += NumBeams;
+	}
+	BatchLasers.Reset();
+	BatchGrids.Reset();
+}
+
+bool ULaserSubsystem::RegisterLaser(ULaserComponent* Laser)
+{
+	if (!bBatchLaserTraces || Laser == nullptr)
+	{
+		return false;
+	}
+
+	Lasers.AddUnique(Laser);
+	return true;
+}
+
+void ULaserSubsystem::UnregisterLaser(ULaserComponent* Laser)
+{
+	Lasers.Remove(Laser);
+}
+
+bool ULaserSubsystem::RegisterLaserGrid(ULaserGridComponent* Grid)
+{
+	if (!bBatchLaserTraces || Grid == nullptr)
+	{
+		return false;
+	}
+
+	LaserGrids.AddUnique(Grid);
+	return true;
+}
+
+void ULaserSubsystem::UnregisterLaserGrid(ULaserGridComponent* Grid)
+{
+	LaserGrids.Remove(Grid);
+}
+
+void ULaserSubsystem::RegisterMirror(ULaserMirrorComponent* Mirror)
+{
+	if (Mirror != nullptr)
+	{
+		Mirrors.AddUnique(Mirror);
+		NotifyMirrorChanged(Mirror->Bounds.GetBox());
+	}
+}
+
+void ULaserSubsystem::UnregisterMirror(ULaserMirrorComponent* Mirror)
+{
+	if (Mirrors.Remove(Mirror) > 0)
+	{
+		NotifyMirrorChanged(Mirror->Bounds.GetBox());
+	}
+}
+
+void ULaserSubsystem::NotifyMirrorChanged(const FBox& Bounds)
+{
+	++MirrorRevision;
+
+	FMirrorChange& Change = MirrorChanges.AddDefaulted_GetRef();
+	Change.Bounds = Bounds;
+	Change.Revision = MirrorRevision;
+
+	const int32 NumToForget = MirrorChanges.Num() - FMath::Max(MaxMirrorChanges, 1);
+	if (NumToForget > 0)
+	{
+		ForgottenMirrorRevision = MirrorChanges[NumToForget - 1].Revision;
+		MirrorChanges.RemoveAt(0, NumToForget, false);
+	}
+}
+
+bool ULaserSubsystem::IsLaserPathUnchanged(const FLaserPath& Path, int32 SinceRevision) const
+{
+	if (SinceRevision < ForgottenMirrorRevision)
+	{
+		return false;
+	}
+
+	for (int32 Index = MirrorChanges.Num() - 1; Index >= 0 && MirrorChanges[Index].Revision > SinceRevision; --Index)
+	{
+		// A beam ending on a mirror ends on its surface, on the edge of its bounds at best.
+		const FBox Bounds = MirrorChanges[Index].Bounds.ExpandBy(1.f);
+		for (int32 Segment = 0; Segment + 1 < Path.Num(); ++Segment)
+		{
+			if (FMath::LineBoxIntersection(Bounds, Path[Segment], Path[Segment + 1], Path[Segment + 1] - Path[Segment]))
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
@@ -0,0 +1,145 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "LaserComponent.h"
+#include "LaserSubsystem.generated.h"
+
+class APawn;
+class ULaserGridComponent;
+class ULaserMirrorComponent;
+
+/**
+ * Owns every ULaserComponent and ULaserGridComponent in a world and updates them all from a single tick, instead of one
+ * component tick each. The player pawns are gathered once per frame, the traces of every laser and every grid beam run
+ * together across worker threads, and the results are then applied (beam and impact effects, intercept notifications)
+ * on the game thread in registration order, lasers first.
+ */
+UCLASS(config = Game)
+class STEALTHGAME_API ULaserSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	ULaserSubsystem();
+
+	//~ Begin USubsystem Interface.
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Deinitialize() override;
+	//~ End USubsystem Interface.
+
+	//~ Begin FTickableGameObject Interface.
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	//~ End FTickableGameObject Interface.
+
+	/** Adds a laser to the batch. @return false if lasers are not batched, in which case the laser keeps ticking itself. */
+	bool RegisterLaser(ULaserComponent* Laser);
+
+	/** Removes a laser from the batch. Safe to call from within a laser's update. */
+	void UnregisterLaser(ULaserComponent* Laser);
+
+	UFUNCTION(BlueprintCallable, Category = "Laser")
+		int32 GetNumRegisteredLasers() const { return Lasers.Num(); }
+
+	/** Adds a laser grid to the batch. @return false if lasers are not batched, in which case the grid keeps ticking itself. */
+	bool RegisterLaserGrid(ULaserGridComponent* Grid);
+
+	/** Removes a laser grid from the batch. Safe to call from within a laser's update. */
+	void UnregisterLaserGrid(ULaserGridComponent* Grid);
+
+	/** Adds a mirror lasers can bounce off. Registered while the mirror is, so the list never holds stale mirrors. */
+	void RegisterMirror(ULaserMirrorComponent* Mirror);
+
+	void UnregisterMirror(ULaserMirrorComponent* Mirror);
+
+	/** Invalidates the bounce paths cached by lasers that cross Bounds, the space a mirror left or took up. */
+	void NotifyMirrorChanged(const FBox& Bounds);
+
+	/** Changes whenever a mirror moves, appears or goes away. */
+	int32 GetMirrorRevision() const { return MirrorRevision; }
+
+	/** Returns true if no mirror has changed across Path since SinceRevision. Only called while mirrors can't change. */
+	bool IsLaserPathUnchanged(const FLaserPath& Path, int32 SinceRevision) const;
+
+	/** Every registered mirror. Only changes on the game thread, the laser traces read it from worker threads. */
+	const TArray<ULaserMirrorComponent*>& GetMirrors() const { return Mirrors; }
+
+	/** Appends the pawn of every player controller of World, the pawns lasers report intercepting. */
+	static void GatherPlayerPawns(const UWorld* World, TArray<APawn*>& OutPawns);
+
+	/** Appends the view point of every local player controller of World, the views laser effects are shown to. */
+	static void GatherViewLocations(const UWorld* World, TArray<FVector>& OutLocations);
+
+	bool IsLaserFXLODEnabled() const { return bLaserFXLOD; }
+	float GetLaserFXViewDistance() const { return LaserFXViewDistance; }
+	float GetLaserFXEndTolerance() const { return LaserFXEndTolerance; }
+
+protected:
+	/** If true, lasers are updated by this subsystem. Otherwise every laser ticks and traces on its own. */
+	UPROPERTY(config)
+		bool bBatchLaserTraces;
+
+	/** Frames with fewer lasers than this trace them on the game thread, where they are not worth waking the workers for. */
+	UPROPERTY(config)
+		int32 MinParallelLaserTraces;
+
+	/**
+	 * If true, a laser's effects are only active while a local view is within LaserFXViewDistance of its beam, their
+	 * parameters are only pushed when the beam end moves, and impact effects come from the world's Niagara pool.
+	 */
+	UPROPERTY(config)
+		bool bLaserFXLOD;
+
+	UPROPERTY(config)
+		float LaserFXViewDistance;
+
+	/** Distance the beam end has to move before the effects are updated. */
+	UPROPERTY(config)
+		float LaserFXEndTolerance;
+
+	/** Number of mirror changes remembered. Lasers whose path is older than the oldest remembered change trace it again. */
+	UPROPERTY(config)
+		int32 MaxMirrorChanges;
+
+private:
+	/** Every registered laser, updated in order. */
+	TArray<TWeakObjectPtr<ULaserComponent>> Lasers;
+
+	/** Every registered laser grid, updated in order after the lasers. */
+	TArray<TWeakObjectPtr<ULaserGridComponent>> LaserGrids;
+
+	TArray<ULaserMirrorComponent*> Mirrors;
+
+	struct FMirrorChange
+	{
+		FBox Bounds;
+		int32 Revision;
+	};
+
+	/** Recent mirror changes, oldest first. At most MaxMirrorChanges entries. */
+	TArray<FMirrorChange> MirrorChanges;
+
+	/** Revision of the last recorded mirror change. */
+	int32 MirrorRevision;
+
+	/** Revision of the newest change that was dropped from MirrorChanges. Paths traced before it can't be validated. */
+	int32 ForgottenMirrorRevision;
+
+	// Per-frame scratch data. The workers only read the batch and write their own entry of the trace results: one per
+	// laser, then one per beam of every grid, with the grid and beam of each in BatchGridBeams and the number of beams
+	// of each grid in BatchGridNumBeams.
+	TArray<APawn*> PlayerPawns;
+	TArray<FVector> ViewLocations;
+	TArray<ULaserComponent*> BatchLasers;
+	TArray<ULaserGridComponent*> BatchGrids;
+	TArray<FIntPoint> BatchGridBeams;
+	TArray<int32> BatchGridNumBeams;
+	TArray<FLaserTraceResult> TraceResults;
+};
@@ -0,0 +1,124 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "LaserIntersection.h"
+#include "SensingTestWorld.h"
+#include "Components/CapsuleComponent.h"
+
+/**
+ * Checks the analytic ray/capsule test of the lasers' fast path against a line trace of a real capsule component,
+ * which is what the full laser trace reports.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLaserRayCapsuleTest, "StealthGame.Lasers.RayCapsule",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FLaserRayCapsuleTest::RunTest(const FString& Parameters)
+{
+	FSensingTestWorld TestWorld;
+
+	const float Radius = 40.f;
+	const float HalfHeight = 90.f;
+	const FVector Center(0.f, 0.f, 100.f);
+	UCapsuleComponent* Capsule = TestWorld.SpawnComponentActor<UCapsuleComponent>(FTransform(Center), [Radius, HalfHeight](UCapsuleComponent* NewCapsule)
+	{
+		NewCapsule->InitCapsuleSize(Radius, HalfHeight);
+		NewCapsule->SetCollisionEnabled(ECollisionEnabled::QueryOnly);
+		NewCapsule->SetCollisionResponseToAllChannels(ECR_Block);
+	});
+	const FVector Axis(0.f, 0.f, HalfHeight - Radius);
+
+	struct FRayCase
+	{
+		const TCHAR* Name;
+		FVector Start;
+		FVector End;
+		/** Known distance to the hit, or < 0 to only compare with the line trace. */
+		float ExpectedDistance;
+	};
+
+	const FRayCase Cases[] =
+	{
+		{ TEXT("Hit"), FVector(-200.f, 0.f, 100.f), FVector(200.f, 0.f, 100.f), 160.f },
+		{ TEXT("Miss"), FVector(-200.f, 100.f, 100.f), FVector(200.f, 100.f, 100.f), -1.f },
+		{ TEXT("Pointing away"), FVector(-200.f, 0.f, 100.f), FVector(-400.f, 0.f, 100.f), -1.f },
+		{ TEXT("Ends short"), FVector(-200.f, 0.f, 100.f), FVector(-100.f, 0.f, 100.f), -1.f },
+		{ TEXT("Parallel to axis"), FVector(0.f, 0.f, 400.f), FVector(0.f, 0.f, -200.f), 210.f },
+		{ TEXT("Parallel to axis, off center"), FVector(20.f, 0.f, 400.f), FVector(20.f, 0.f, -200.f), 250.f - FMath::Sqrt(1200.f) },
+		{ TEXT("Parallel to axis, outside"), FVector(50.f, 0.f, 400.f), FVector(50.f, 0.f, -200.f), -1.f },
+		{ TEXT("Start inside"), FVector(0.f, 0.f, 100.f), FVector(200.f, 0.f, 100.f), 0.f },
+		{ TEXT("Start inside cap"), FVector(0.f, 0.f, 170.f), FVector(0.f, 200.f, 170.f), 0.f },
+		{ TEXT("Top cap"), FVector(-200.f, 0.f, 300.f), FVector(100.f, 0.f, 120.f), -1.f },
+		{ TEXT("Bottom cap"), FVector(0.f, -200.f, -50.f), FVector(0.f, 100.f, 80.f), -1.f },
+		{ TEXT("Grazing cap"), FVector(-200.f, 0.f, 185.f), FVector(200.f, 0.f, 185.f), -1.f },
+	};
+
+	for (const FRayCase& Case : Cases)
+	{
+		const FVector Delta = Case.End - Case.Start;
+		const float Length = Delta.Size();
+
+		float Distance = 0.f;
+		const bool bHit = LaserIntersection::IntersectRayCapsule(Case.Start, Delta / Length, Center - Axis, Center + Axis, Radius, Distance) && Distance <= Length;
+
+		FHitResult TraceHit;
+		const bool bTraceHit = Capsule->LineTraceComponent(TraceHit, Case.Start, Case.End, FCollisionQueryParams(TEXT("LaserRayCapsuleTest")));
+
+		TestEqual(FString::Printf(TEXT("%s: hit matches the line trace"), Case.Name), bHit, bTraceHit);
+		if (bHit && bTraceHit)
+		{
+			TestEqual(FString::Printf(TEXT("%s: distance matches the line trace"), Case.Name), Distance, TraceHit.Distance, 0.5f);
+		}
+		if (Case.ExpectedDistance >= 0.f)
+		{
+			TestTrue(FString::Printf(TEXT("%s: hit"), Case.Name), bHit);
+			TestEqual(FString::Printf(TEXT("%s: distance"), Case.Name), Distance, Case.ExpectedDistance, 0.01f);
+		}
+	}
+	return true;
+}
+
+/** Checks the capsule/triangle test behind the lasers' sweep mode on cases whose answer is known. */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLaserCapsuleTriangleTest, "StealthGame.Lasers.CapsuleTriangle",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FLaserCapsuleTriangleTest::RunTest(const FString& Parameters)
+{
+	// Capsule along Z around the origin, 40 wide, its axis ending 50 above and below.
+	const FVector P0(0.f, 0.f, -50.f);
+	const FVector P1(0.f, 0.f, 50.f);
+	const float Radius = 40.f;
+
+	struct FTriangleCase
+	{
+		const TCHAR* Name;
+		FVector A;
+		FVector B;
+		FVector C;
+		bool bExpected;
+	};
+
+	const FTriangleCase Cases[] =
+	{
+		{ TEXT("Axis crosses the triangle"), FVector(-100.f, -100.f, 0.f), FVector(100.f, -100.f, 0.f), FVector(0.f, 100.f, 0.f), true },
+		{ TEXT("Far to the side"), FVector(100.f, -100.f, 0.f), FVector(300.f, -100.f, 0.f), FVector(200.f, 100.f, 0.f), false },
+		{ TEXT("Above the cap, within the radius"), FVector(-100.f, -100.f, 80.f), FVector(100.f, -100.f, 80.f), FVector(0.f, 100.f, 80.f), true },
+		{ TEXT("Above the cap, beyond the radius"), FVector(-100.f, -100.f, 95.f), FVector(100.f, -100.f, 95.f), FVector(0.f, 100.f, 95.f), false },
+		{ TEXT("Parallel to the axis, within the radius"), FVector(30.f, -100.f, 0.f), FVector(30.f, 100.f, 0.f), FVector(30.f, 0.f, 200.f), true },
+		{ TEXT("Parallel to the axis, beyond the radius"), FVector(45.f, -100.f, 0.f), FVector(45.f, 100.f, 0.f), FVector(45.f, 0.f, 200.f), false },
+		{ TEXT("Only an edge within the radius"), FVector(30.f, -200.f, 0.f), FVector(30.f, 200.f, 0.f), FVector(300.f, 0.f, 0.f), true },
+		{ TEXT("Only an edge, beyond the radius"), FVector(45.f, -200.f, 0.f), FVector(45.f, 200.f, 0.f), FVector(300.f, 0.f, 0.f), false },
+	};
+
+	for (const FTriangleCase& Case : Cases)
+	{
+		TestEqual(FString(Case.Name), LaserIntersection::IntersectCapsuleTriangle(P0, P1, Radius, Case.A, Case.B, Case.C), Case.bExpected);
+	}
+	return true;
+}
+
+#endif
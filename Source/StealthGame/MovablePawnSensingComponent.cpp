@@ -1,9 +1,11 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "MovablePawnSensingComponent.h"
+#include "StealthGame.h"
+#include "SensingSubsystem.h"
+#include "StealthGameCharacter.h"
 #include "Perception/PawnSensingComponent.h"
 #include "EngineGlobals.h"
-#include "TimerManager.h"
 #include "CollisionQueryParams.h"
 #include "GameFramework/Pawn.h"
 #include "GameFramework/Controller.h"
@@ -13,10 +15,23 @@
 #include "AIController.h"
 #include "Components/PawnNoiseEmitterComponent.h"
 #include "Components/CapsuleComponent.h"
+#include "Components/SkeletalMeshComponent.h"
 #include "Kismet/KismetSystemLibrary.h"
 #include "Components/ArrowComponent.h"
-
-DECLARE_CYCLE_STAT(TEXT("Sensing"), STAT_AI_Sensing, STATGROUP_AI);
+#include "Net/UnrealNetwork.h"
+
+DECLARE_CYCLE_STAT(TEXT("Sensor Update"), STAT_Sensing_Update, STATGROUP_Sensing);
+DECLARE_CYCLE_STAT(TEXT("Gather Candidates"), STAT_Sensing_GatherCandidates, STATGROUP_Sensing);
+DECLARE_CYCLE_STAT(TEXT("Line Of Sight"), STAT_Sensing_LineOfSight, STATGROUP_Sensing);
+DECLARE_CYCLE_STAT(TEXT("Hearing"), STAT_Sensing_Hearing, STATGROUP_Sensing);
+DECLARE_CYCLE_STAT(TEXT("Broadcast"), STAT_Sensing_Broadcast, STATGROUP_Sensing);
+DECLARE_CYCLE_STAT(TEXT("Replicated Perception"), STAT_Sensing_ReplicatedPerception, STATGROUP_Sensing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Sensors Updated"), STAT_Sensing_SensorsUpdated, STATGROUP_Sensing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Sight Traces"), STAT_Sensing_SightTraces, STATGROUP_Sensing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Hearing Traces"), STAT_Sensing_HearingTraces, STATGROUP_Sensing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Visibility Cache Hits"), STAT_Sensing_VisibilityCacheHits, STATGROUP_Sensing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Visibility Cache Misses"), STAT_Sensing_VisibilityCacheMisses, STATGROUP_Sensing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Traces Culled By PVS"), STAT_Sensing_PVSCulledTraces, STATGROUP_Sensing);
 
 #define FARSIGHTTHRESHOLD 8000.f
 #define FARSIGHTTHRESHOLDSQUARED (FARSIGHTTHRESHOLD*FARSIGHTTHRESHOLD)
@@ -24,6 +39,19 @@ DECLARE_CYCLE_STAT(TEXT("Sensing"), STAT_AI_Sensing, STATGROUP_AI);
 #define NEARSIGHTTHRESHOLD 2000.f
 #define NEARSIGHTTHRESHOLDSQUARED (NEARSIGHTTHRESHOLD * NEARSIGHTTHRESHOLD)
 
+// Visual logger entries go under the sensor's owner, so each guard or camera can be scrubbed through on its own.
+#if ENABLE_SENSING_DEBUG
+#define SENSING_VLOG(Format, ...) UE_VLOG(GetOwner(), LogSensing, Log, Format, ##__VA_ARGS__)
+#define SENSING_VLOG_SEGMENT(Start, End, Color, Format, ...) UE_VLOG_SEGMENT(GetOwner(), LogSensing, Log, Start, End, Color, Format, ##__VA_ARGS__)
+#define SENSING_VLOG_LOCATION(Location, Color, Format, ...) UE_VLOG_LOCATION(GetOwner(), LogSensing, Log, Location, 15.f, Color, Format, ##__VA_ARGS__)
+#define SENSING_VLOG_CONE(Origin, Direction, Length, Angle, Color, Format, ...) UE_VLOG_CONE(GetOwner(), LogSensing, Log, Origin, Direction, Length, Angle, Color, Format, ##__VA_ARGS__)
+#else
+#define SENSING_VLOG(Format, ...)
+#define SENSING_VLOG_SEGMENT(Start, End, Color, Format, ...)
+#define SENSING_VLOG_LOCATION(Location, Color, Format, ...)
+#define SENSING_VLOG_CONE(Origin, Direction, Length, Angle, Color, Format, ...)
+#endif
+
 UMovablePawnSensingComponent::UMovablePawnSensingComponent(const FObjectInitializer& ObjectInitializer)
 	: Super(ObjectInitializer)
 {
@@ -39,6 +67,34 @@ UMovablePawnSensingComponent::UMovablePawnSensingComponent(const FObjectInitiali
 	bOnlySensePlayers = true;
 	bHearNoises = true;
 	bSeePawns = true;
+	bUseAsyncTraces = false;
+	bBroadcastContinuously = false;
+	TargetStateExpiryUpdates = 8;
+	SensingUpdateCount = 0;
+	bUseNoiseEvents = false;
+	bUseVisibilityCache = true;
+	bUsePotentiallyVisibleSet = true;
+	bUseRoomGraph = true;
+	bUseIllumination = true;
+	DarkSightRadiusScale = 0.3f;
+	SightSampleFullRateFraction = 0.4f;
+	SightSampleReferenceAngularSpeed = 45.f;
+	SneakingSightHeightScale = 0.6f;
+
+	// Center first, it is the likeliest to be visible. Then the head, which the original fallback trace aimed at, and the feet.
+	SightSamplePoints.SetNum(3);
+	SightSamplePoints[0].HeightFraction = 0.f;
+	SightSamplePoints[1].HeightFraction = 1.f;
+	SightSamplePoints[2].HeightFraction = -0.8f;
+	bUseSignificanceLOD = true;
+	ReducedSensingIntervalScale = 4.f;
+	SensingLOD = ESensingLOD::Full;
+	VisibilityCacheTolerance = 10.f;
+	VisibilityCacheMaxAge = 2.f;
+	VisibilityCacheHits = 0;
+	VisibilityCacheMisses = 0;
+	HeardAwareness = 0.5f;
+	AwarenessDecayRate = 0.2f;
 
 	PrimaryComponentTick.bCanEverTick = false;
 	bWantsInitializeComponent = true;
@@ -54,6 +110,28 @@ UMovablePawnSensingComponent::UMovablePawnSensingComponent(const FObjectInitiali
 	FacingDirection->AddRelativeLocation(FVector(100, 0, 0));
 
 	bIsDebug = false;
+
+	NextSensingUpdateTime = 0.0;
+	SensingScheduledTime = 0.0;
+	bSensingUpdatePending = false;
+
+	LastAsyncTraceId = 0;
+	LastNoiseEventId = 0;
+	BatchSightTargets = nullptr;
+
+	// Clients only learn what the server's sensing found through replication, the component does nothing else there.
+	SetIsReplicatedByDefault(true);
+	ReplicatedTargets.Owner = this;
+	bAlarmed = false;
+	LastPerceptionUpdateTime = 0.0;
+}
+
+void UMovablePawnSensingComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(UMovablePawnSensingComponent, ReplicatedTargets);
+	DOREPLIFETIME(UMovablePawnSensingComponent, bAlarmed);
 }
 
 void UMovablePawnSensingComponent::SetPeripheralVisionAngle(const float NewPeripheralVisionAngle)
@@ -67,6 +145,16 @@ void UMovablePawnSensingComponent::InitializeComponent()
 	Super::InitializeComponent();
 	SetPeripheralVisionAngle(PeripheralVisionAngle);
 
+	TraceScopeName = GetOwner() != nullptr ? GetOwner()->GetName() : GetName();
+
+	if (USensingSubsystem* SensingSubsystem = GetSensingSubsystem())
+	{
+		SensingSubsystem->RegisterSensor(this);
+
+		// Like the emitter path, noises made before we existed are not for us.
+		LastNoiseEventId = SensingSubsystem->GetLastNoiseEventId();
+	}
+
 	if (bEnableSensingUpdates)
 	{
 		bEnableSensingUpdates = false; // force an update
@@ -74,6 +162,22 @@ void UMovablePawnSensingComponent::InitializeComponent()
 	}
 }
 
+void UMovablePawnSensingComponent::UninitializeComponent()
+{
+	if (USensingSubsystem* SensingSubsystem = GetSensingSubsystem())
+	{
+		SensingSubsystem->UnregisterSensor(this);
+	}
+
+	Super::UninitializeComponent();
+}
+
+USensingSubsystem* UMovablePawnSensingComponent::GetSensingSubsystem() const
+{
+	const UWorld* World = GetWorld();
+	return World ? World->GetSubsystem<USensingSubsystem>() : nullptr;
+}
+
 void UMovablePawnSensingComponent::SetSensingUpdatesEnabled(const bool bEnabled)
 {
 	if (bEnableSensingUpdates != bEnabled)
@@ -83,7 +187,10 @@ void UMovablePawnSensingComponent::SetSensingUpdatesEnabled(const bool bEnabled)
 		if (bEnabled && SensingInterval > 0.f)
 		{
 			// Stagger initial updates so all sensors do not update at the same time (to avoid hitches).
-			const float InitialDelay = (SensingInterval * FMath::SRand()) + KINDA_SMALL_NUMBER;
+			// The offset comes from the sensing seed so the stagger is the same on every run.
+			const USensingSubsystem* SensingSubsystem = GetSensingSubsystem();
+			const float StaggerFraction = SensingSubsystem ? (SensingSubsystem->GetSamplingHash(this, nullptr) & 0xFFFF) / 65536.f : FMath::SRand();
+			const float InitialDelay = (SensingInterval * StaggerFraction) + KINDA_SMALL_NUMBER;
 			SetTimer(InitialDelay);
 		}
 		else
@@ -99,7 +206,10 @@ void UMovablePawnSensingComponent::SetTimer(const float TimeInterval)
 	AActor* const Owner = GetOwner();
 	if (IsValid(Owner) && GEngine->GetNetMode(GetWorld()) < NM_Client)
 	{
-		Owner->GetWorldTimerManager().SetTimer(TimerHandle_OnTimer, this, &UMovablePawnSensingComponent::OnTimer, TimeInterval, false);
+		if (USensingSubsystem* SensingSubsystem = GetSensingSubsystem())
+		{
+			SensingSubsystem->ScheduleSensor(this, TimeInterval);
+		}
 	}
 }
 
@@ -110,23 +220,25 @@ void UMovablePawnSensingComponent::SetSensingInterval(const float NewSensingInte
 		SensingInterval = NewSensingInterval;
 
 		AActor* const Owner = GetOwner();
-		if (IsValid(Owner))
+		USensingSubsystem* SensingSubsystem = GetSensingSubsystem();
+		if (IsValid(Owner) && SensingSubsystem != nullptr)
 		{
 			if (SensingInterval <= 0.f)
 			{
 				SetTimer(0.f);
 			}
-			else if (bEnableSensingUpdates)
+			else if (bEnableSensingUpdates && SensingLOD != ESensingLOD::Suspended)
 			{
-				float CurrentElapsed = Owner->GetWorldTimerManager().GetTimerElapsed(TimerHandle_OnTimer);
+				float CurrentElapsed = SensingSubsystem->GetSensorElapsedTime(this);
 				CurrentElapsed = FMath::Max(0.f, CurrentElapsed);
 
-				if (CurrentElapsed < SensingInterval)
+				const float EffectiveInterval = GetEffectiveSensingInterval();
+				if (CurrentElapsed < EffectiveInterval)
 				{
 					// Extend lifetime by remaining time.
-					SetTimer(SensingInterval - CurrentElapsed);
+					SetTimer(EffectiveInterval - CurrentElapsed);
 				}
-				else if (CurrentElapsed > SensingInterval)
+				else if (CurrentElapsed > EffectiveInterval)
 				{
 					// Basically fire next update, because time has already expired.
 					// Don't want to fire immediately in case an update tries to change the interval, looping endlessly.
@@ -139,26 +251,64 @@ void UMovablePawnSensingComponent::SetSensingInterval(const float NewSensingInte
 
 void UMovablePawnSensingComponent::OnTimer()
 {
-
-	SCOPE_CYCLE_COUNTER(STAT_AI_Sensing);
+	SCOPE_CYCLE_COUNTER(STAT_Sensing_Update);
+	TRACE_CPUPROFILER_EVENT_SCOPE_TEXT(*TraceScopeName);
+	INC_DWORD_STAT(STAT_Sensing_SensorsUpdated);
 
 	AActor* const Owner = GetOwner();
 	if (!IsValid(Owner) || !IsValid(Owner->GetWorld()))
 	{
 		return;
 	}
-	if (CanSenseAnything())
+	if (CanSenseAnything() && SensingLOD != ESensingLOD::Suspended)
 	{
 		UpdateAISensing();
 	}
 
-	if (bEnableSensingUpdates)
+	if (bEnableSensingUpdates && SensingLOD != ESensingLOD::Suspended)
 	{
-		SetTimer(SensingInterval);
+		SetTimer(GetEffectiveSensingInterval());
 	}
 
 };
 
+float UMovablePawnSensingComponent::GetEffectiveSensingInterval() const
+{
+	return SensingLOD == ESensingLOD::Full ? SensingInterval : SensingInterval * ReducedSensingIntervalScale;
+}
+
+void UMovablePawnSensingComponent::SetSensingLOD(ESensingLOD NewLOD)
+{
+	// Losing sight of a pawn has to come from an actual sight check, so keep checking while we see one.
+	if (bHadLoSToPawn && NewLOD > ESensingLOD::Reduced)
+	{
+		NewLOD = ESensingLOD::Reduced;
+	}
+
+	if (SensingLOD == NewLOD)
+	{
+		return;
+	}
+
+	const ESensingLOD OldLOD = SensingLOD;
+	SensingLOD = NewLOD;
+
+	if (!bEnableSensingUpdates || SensingInterval <= 0.f)
+	{
+		return;
+	}
+
+	if (NewLOD == ESensingLOD::Suspended)
+	{
+		SetTimer(0.f);
+	}
+	else if (OldLOD == ESensingLOD::Suspended)
+	{
+		// Someone just came close, don't wait a whole interval to start looking.
+		SetTimer(KINDA_SMALL_NUMBER);
+	}
+}
+
 AActor* UMovablePawnSensingComponent::GetSensorActor() const
 {
 	AActor* SensorActor = GetOwner();
@@ -182,32 +332,22 @@ bool UMovablePawnSensingComponent::IsSensorActor(const AActor* Actor) const
 	return (Actor == GetSensorActor());
 }
 
-bool UMovablePawnSensingComponent::HasLineOfSightTo(const AActor* Other) const
+FCollisionQueryParams UMovablePawnSensingComponent::GetLineOfSightQueryParams(const AActor* Other) const
 {
-	if (!Other)
-	{
-		return false;
-	}
-
 	FCollisionQueryParams CollisionParms(SCENE_QUERY_STAT(LineOfSight), true, Other);
 	CollisionParms.AddIgnoredActor(this->GetOwner());
-	FVector TargetLocation = Other->GetTargetLocation(GetOwner());
-
-	FVector ViewPoint = GetComponentLocation();
-
-	bool bHit = GetWorld()->LineTraceTestByChannel(ViewPoint, TargetLocation, ECC_Visibility, CollisionParms);
-	if (!bHit)
-	{
-		return true;
-	}
+	return CollisionParms;
+}
 
+bool UMovablePawnSensingComponent::ShouldTraceSightSamplePoints(const AActor* Other) const
+{
 	// if other isn't using a cylinder for collision and isn't a Pawn (which already requires an accurate cylinder for AI)
 	// then don't go any further as it likely will not be tracing to the correct location
 	if (!Cast<const APawn>(Other) && Cast<UCapsuleComponent>(Other->GetRootComponent()) == NULL)
 	{
 		return false;
 	}
-	float distSq = (Other->GetActorLocation() - ViewPoint).SizeSquared();
+	float distSq = (Other->GetActorLocation() - GetComponentLocation()).SizeSquared();
 	if (distSq > FARSIGHTTHRESHOLDSQUARED)
 	{
 		return false;
@@ -216,13 +356,105 @@ bool UMovablePawnSensingComponent::HasLineOfSightTo(const AActor* Other) const
 	{
 		return false;
 	}
+	return true;
+}
+
+void UMovablePawnSensingComponent::GetSightSampleLocations(const AActor* Other, FSightSampleLocations& OutLocations) const
+{
+	OutLocations.Reset();
+	if (SightSamplePoints.Num() == 0 || !ShouldTraceSightSamplePoints(Other))
+	{
+		OutLocations.Add(Other->GetTargetLocation(GetOwner()));
+		return;
+	}
+
+	float OtherRadius, OtherHalfHeight;
+	Other->GetSimpleCollisionCylinder(OtherRadius, OtherHalfHeight);
+
+	// Crouching already shrinks the capsule. Sneaking does not, but the character ducks within it, down from its feet.
+	const AStealthGameCharacter* StealthCharacter = Cast<const AStealthGameCharacter>(Other);
+	const float HeightScale = StealthCharacter != nullptr && StealthCharacter->IsSneaking() ? SneakingSightHeightScale : 1.f;
+	const FVector Bottom = Other->GetActorLocation() - FVector(0.f, 0.f, OtherHalfHeight);
+
+	const ACharacter* Character = Cast<const ACharacter>(Other);
+	const USkeletalMeshComponent* Mesh = Character != nullptr ? Character->GetMesh() : nullptr;
+	for (const FSightSamplePoint& Point : SightSamplePoints)
+	{
+		if (Point.SocketName != NAME_None && Mesh != nullptr && Mesh->DoesSocketExist(Point.SocketName))
+		{
+			OutLocations.Add(Mesh->GetSocketLocation(Point.SocketName));
+		}
+		else
+		{
+			OutLocations.Add(Bottom + FVector(0.f, 0.f, (Point.HeightFraction + 1.f) * OtherHalfHeight * HeightScale));
+		}
+	}
+}
+
+bool UMovablePawnSensingComponent::IsSightRayBlocked(const FVector& ViewPoint, const FVector& Location, const FCollisionQueryParams& Params) const
+{
+	INC_DWORD_STAT(STAT_Sensing_SightTraces);
+#if ENABLE_SENSING_DEBUG
+	if (FVisualLogger::IsRecording())
+	{
+		// Only while recording, a full trace instead of a test so the log shows what blocked the ray.
+		FHitResult Hit;
+		if (GetWorld()->LineTraceSingleByChannel(Hit, ViewPoint, Location, ECC_Visibility, Params))
+		{
+			SENSING_VLOG_SEGMENT(ViewPoint, Hit.ImpactPoint, FColor::Red, TEXT("Sight blocked by %s"), *GetNameSafe(Hit.GetActor()));
+			SENSING_VLOG_LOCATION(Hit.ImpactPoint, FColor::Red, TEXT(""));
+			return true;
+		}
+		SENSING_VLOG_SEGMENT(ViewPoint, Location, FColor::Green, TEXT("Sight clear"));
+		return false;
+	}
+#endif
+	return GetWorld()->LineTraceTestByChannel(ViewPoint, Location, ECC_Visibility, Params);
+}
+
+float UMovablePawnSensingComponent::TraceSightSamples(const AActor* Other, const FSightSampleLocations& Locations, bool bStopAtFirstClear) const
+{
+	// All traces share one set of query params, built once. There is no multi-ray scene query, so they are issued back to back.
+	const FCollisionQueryParams CollisionParms = GetLineOfSightQueryParams(Other);
+	const FVector ViewPoint = GetComponentLocation();
+
+	int32 NumClear = 0;
+	for (const FVector& Location : Locations)
+	{
+		if (!IsSightRayBlocked(ViewPoint, Location, CollisionParms))
+		{
+			++NumClear;
+			if (bStopAtFirstClear)
+			{
+				break;
+			}
+		}
+	}
+	return Locations.Num() > 0 ? (float)NumClear / Locations.Num() : 0.f;
+}
+
+bool UMovablePawnSensingComponent::HasLineOfSightTo(const AActor* Other) const
+{
+	if (!Other)
+	{
+		return false;
+	}
+
+	FSightSampleLocations Locations;
+	GetSightSampleLocations(Other, Locations);
+	return TraceSightSamples(Other, Locations, true) > 0.f;
+}
 
-	float OtherRadius, OtherHeight;
-	Other->GetSimpleCollisionCylinder(OtherRadius, OtherHeight);
+float UMovablePawnSensingComponent::GetLineOfSightFraction(const AActor* Other) const
+{
+	if (!Other)
+	{
+		return 0.f;
+	}
 
-	//try viewpoint to head
-	bHit = GetWorld()->LineTraceTestByChannel(ViewPoint, Other->GetActorLocation() + FVector(0.f, 0.f, OtherHeight), ECC_Visibility, CollisionParms);
-	return !bHit;
+	FSightSampleLocations Locations;
+	GetSightSampleLocations(Other, Locations);
+	return TraceSightSamples(Other, Locations, false);
 }
 
 bool UMovablePawnSensingComponent::CanSenseAnything() const
@@ -238,6 +470,15 @@ void UMovablePawnSensingComponent::UpdateAISensing()
 	check(IsValid(Owner));
 	check(IsValid(Owner->GetWorld()));
 
+	SENSING_VLOG_CONE(GetSensorLocation(), GetSensorRotation().GetSafeNormal(), SightRadius, FMath::DegreesToRadians(PeripheralVisionAngle), FColor::White, TEXT("Sensing update, LOD %s"), *UEnum::GetValueAsString(SensingLOD));
+
+	++SensingUpdateCount;
+	for (FSensedTargetState& State : TargetStates)
+	{
+		State.bFailedLineOfSight = false;
+		State.bSightChecked = false;
+	}
+
 	if (bOnlySensePlayers)
 	{
 		for (FConstPlayerControllerIterator Iterator = Owner->GetWorld()->GetPlayerControllerIterator(); Iterator; ++Iterator)
@@ -253,6 +494,22 @@ void UMovablePawnSensingComponent::UpdateAISensing()
 			}
 		}
 	}
+	else if (USensingSubsystem* SensingSubsystem = GetSensingSubsystem())
+	{
+		// Only visit the pawns in the grid cells our senses can reach, rather than every pawn in the world.
+		{
+			SCOPE_CYCLE_COUNTER(STAT_Sensing_GatherCandidates);
+			SensingCandidates.Reset();
+			SensingSubsystem->GatherPawnsInRadius(GetSensorLocation(), GetSensingRadius(), SensingCandidates);
+		}
+		for (APawn* Pawn : SensingCandidates)
+		{
+			if (IsValid(Pawn) && !IsSensorActor(Pawn))
+			{
+				SensePawn(*Pawn);
+			}
+		}
+	}
 	else
 	{
 		for (APawn* Pawn : TActorRange<APawn>(Owner->GetWorld()))
@@ -263,187 +520,933 @@ void UMovablePawnSensingComponent::UpdateAISensing()
 			}
 		}
 	}
+	if (bUseNoiseEvents)
+	{
+		SenseNoiseEvents();
+	}
+
+	// Pawns that left our sight range or view, turned invisible or are no longer candidates are not traced, lose them all the same.
+	TArray<APawn*, TInlineAllocator<4>> LostPawns;
+	for (const FSensedTargetState& State : TargetStates)
+	{
+		if (State.bSeen && !State.bSightChecked && State.Pawn.IsValid())
+		{
+			LostPawns.Add(State.Pawn.Get());
+		}
+	}
+	for (APawn* Pawn : LostPawns)
+	{
+		UpdateLineOfSight(*Pawn, false);
+	}
+
+	// Forget about pawns that have been destroyed since the last update, or that we have stopped caring about.
+	PruneTargetStates();
+	UpdateReplicatedPerception();
+}
+
+float UMovablePawnSensingComponent::GetSensingRadius() const
+{
+	float Radius = 0.f;
+	if (bSeePawns)
+	{
+		Radius = FMath::Max(Radius, SightRadius);
+	}
+	if (bHearNoises)
+	{
+		Radius = FMath::Max(Radius, FMath::Max(HearingThreshold, LOSHearingThreshold));
+	}
+	return Radius;
 }
 
 void UMovablePawnSensingComponent::SensePawn(APawn& Pawn)
 {
 	// Visibility checks
-	bool bHasSeenPawn = false;
 	bool bHasFailedLineOfSightCheck = false;
 	if (bSeePawns && ShouldCheckVisibilityOf(&Pawn))
 	{
-		if (CouldSeePawn(&Pawn, true))
+		if (CouldSeePawnThisUpdate(Pawn))
 		{
-			if (HasLineOfSightTo(&Pawn))
-			{
-				bHadLoSToPawn = true;
-				BroadcastOnSeePawn(Pawn);
-				bHasSeenPawn = true;
-				if (bIsDebug)
-				{
-					if (GEngine)
-						GEngine->AddOnScreenDebugMessage(-1, 15.0f, FColor::Green, TEXT("Pawn has been seen!"));
+			SCOPE_CYCLE_COUNTER(STAT_Sensing_LineOfSight);
+			FindOrAddTargetState(Pawn).bSightChecked = true;
 
-				}
+			const FVector ViewPoint = GetComponentLocation();
+			FSightSampleLocations SampleLocations;
+			GetSightSampleLocations(&Pawn, SampleLocations);
+
+			// No need to trace at all when the baked visibility says static geometry is in the way.
+			bool bHasLineOfSight = false;
+			if (!IsPotentiallyVisible(ViewPoint, SampleLocations))
+			{
+				SENSING_VLOG(TEXT("%s: not potentially visible"), *Pawn.GetName());
+			}
+			else if (LookupTraceCache(FindOrAddTargetState(Pawn).SightCache, ViewPoint, SampleLocations, bHasLineOfSight))
+			{
+				SENSING_VLOG(TEXT("%s: cached line of sight %d"), *Pawn.GetName(), bHasLineOfSight);
 			}
 			else
 			{
-				if (bIsDebug)
+				const FSensingTraceCacheEntry CacheEntry = MakeTraceCacheEntry(ViewPoint, SampleLocations);
+				if (ShouldDeferTraces())
 				{
-					if (GEngine)
-					{
-						GEngine->AddOnScreenDebugMessage(-1, 15.0f, FColor::Blue, TEXT("No line of sight to pawn!"));
-
-					}
+					// The rest of this update (including hearing) resumes once the trace results come back.
+					RequestAsyncLineOfSight(Pawn, SampleLocations, CacheEntry);
+					return;
 				}
-				
-				if (bHadLoSToPawn) 
-				{
-					//If we had LoS but not anymore, it means we just lost track of the pawn
-					BroadcastOnUnSeePawn(Pawn);
-					bHadLoSToPawn = false;
-
-
-					if (bIsDebug) 
-					{
-						if (GEngine)
-							GEngine->AddOnScreenDebugMessage(-1, 15.0f, FColor::Black, TEXT("Pawn has stopped being seen!"));
-					}
 
-				}
-				bHasFailedLineOfSightCheck = true;
-				
+				bHasLineOfSight = TraceSightSamples(&Pawn, SampleLocations, true) > 0.f;
+				StoreTraceCache(FindOrAddTargetState(Pawn).SightCache, CacheEntry, bHasLineOfSight);
 			}
-		}
-		else 
-		{
-			if (bIsDebug) 
+
+			if (bHasLineOfSight)
 			{
-				if (GEngine)
-					GEngine->AddOnScreenDebugMessage(-1, 15.0f, FColor::Yellow, TEXT("CouldSeePawn() has returned FALSE"));
+				UpdateLineOfSight(Pawn, true);
+
+				// No need to 'hear' something if you've already seen it!
+				return;
 			}
 
+			UpdateLineOfSight(Pawn, false);
+			bHasFailedLineOfSightCheck = true;
 		}
-	}
-	else 
-	{
-		if (bIsDebug)
+		else
 		{
-			if (GEngine)
-				GEngine->AddOnScreenDebugMessage(-1, 15.0f, FColor::Red, TEXT("SensePawn() is not checking for visibility."));
+			SENSING_VLOG(TEXT("%s: out of sight range or view, or skipped this update"), *Pawn.GetName());
 		}
 	}
-
-	// Sound checks
-	// No need to 'hear' something if you've already seen it!
-	if (bHasSeenPawn)
+	else
 	{
-		return;
+		SENSING_VLOG(TEXT("%s: not checking visibility"), *Pawn.GetName());
 	}
 
-	// Might not be able to hear or react to the sound at all...
-	if (!bHearNoises || !OnHearNoise.IsBound())
+	SensePawnNoise(Pawn, bHasFailedLineOfSightCheck);
+}
+
+void UMovablePawnSensingComponent::UpdateLineOfSight(APawn& Pawn, bool bHasLineOfSight)
+{
+	FSensedTargetState& State = FindOrAddTargetState(Pawn);
+	State.bFailedLineOfSight = !bHasLineOfSight;
+
+	if (bHasLineOfSight)
 	{
+		const bool bWasSeen = State.bSeen;
+		State.bSeen = true;
+		bHadLoSToPawn = true;
+
+		// Only tell listeners about the transition, unless they asked to hear about it every interval.
+		if (!bWasSeen || bBroadcastContinuously)
+		{
+			BroadcastOnSeePawn(Pawn);
+			SENSING_VLOG_LOCATION(Pawn.GetActorLocation(), FColor::Green, TEXT("%s seen"), *Pawn.GetName());
+		}
 		return;
 	}
 
-	const UPawnNoiseEmitterComponent* NoiseEmitterComponent = Pawn.GetPawnNoiseEmitterComponent();
-	if (NoiseEmitterComponent && ShouldCheckAudibilityOf(&Pawn))
+	SENSING_VLOG(TEXT("%s: no line of sight"), *Pawn.GetName());
+
+	if (State.bSeen)
 	{
-		// ToDo: This should all still be refactored more significantly.  There's no reason that we should have to
-		// explicitly check "local" and "remote" (i.e. Pawn-emitted and other-source-emitted) sounds separately here.
-		// The noise emitter should handle all of those details for us so the sensing component doesn't need to know about
-		// them at all!
-		if (IsNoiseRelevant(Pawn, *NoiseEmitterComponent, true) && CanHear(Pawn.GetActorLocation(), NoiseEmitterComponent->GetLastNoiseVolume(true), bHasFailedLineOfSightCheck))
-		{
-			BroadcastOnHearLocalNoise(Pawn, Pawn.GetActorLocation(), NoiseEmitterComponent->GetLastNoiseVolume(true));
-		}
-		else if (IsNoiseRelevant(Pawn, *NoiseEmitterComponent, false) && CanHear(NoiseEmitterComponent->LastRemoteNoisePosition, NoiseEmitterComponent->GetLastNoiseVolume(false), false))
-		{
-			BroadcastOnHearRemoteNoise(Pawn, NoiseEmitterComponent->LastRemoteNoisePosition, NoiseEmitterComponent->GetLastNoiseVolume(false));
-		}
+		//If we had LoS but not anymore, it means we just lost track of the pawn
+		State.bSeen = false;
+		bHadLoSToPawn = IsSeeingAnyTarget();
+		BroadcastOnUnSeePawn(Pawn);
+		SENSING_VLOG_LOCATION(Pawn.GetActorLocation(), FColor::Black, TEXT("%s no longer seen"), *Pawn.GetName());
 	}
 }
 
-void UMovablePawnSensingComponent::BroadcastOnSeePawn(APawn& Pawn)
+FSensedTargetState* UMovablePawnSensingComponent::FindTargetState(const APawn& Pawn)
 {
-	OnSeePawn.Broadcast(&Pawn);
+	return const_cast<FSensedTargetState*>(static_cast<const UMovablePawnSensingComponent*>(this)->FindTargetState(Pawn));
 }
 
-void UMovablePawnSensingComponent::BroadcastOnUnSeePawn(APawn& Pawn)
+const FSensedTargetState* UMovablePawnSensingComponent::FindTargetState(const APawn& Pawn) const
 {
-	OnUnSeePawn.Broadcast(&Pawn);
+	const int32* Index = TargetStateIndices.Find(Pawn.GetUniqueID());
+	// Unique ids get recycled once an object is collected, so also make sure the entry is still about this pawn.
+	if (Index != nullptr && TargetStates[*Index].Pawn.Get() == &Pawn)
+	{
+		return &TargetStates[*Index];
+	}
+	return nullptr;
 }
 
-void UMovablePawnSensingComponent::BroadcastOnHearLocalNoise(APawn& Instigator, const FVector& Location, float Volume)
+FSensedTargetState& UMovablePawnSensingComponent::FindOrAddTargetState(const APawn& Pawn)
 {
-	OnHearNoise.Broadcast(&Instigator, Location, Volume);
+	int32& Index = TargetStateIndices.FindOrAdd(Pawn.GetUniqueID(), INDEX_NONE);
+	if (Index != INDEX_NONE && TargetStates[Index].Pawn.Get() == &Pawn)
+	{
+		TargetStates[Index].LastTouchedUpdate = SensingUpdateCount;
+		return TargetStates[Index];
+	}
+
+	if (Index == INDEX_NONE)
+	{
+		Index = TargetStates.AddDefaulted();
+	}
+	else
+	{
+		// The entry belonged to a collected pawn whose unique id has been handed out again.
+		TargetStates[Index] = FSensedTargetState();
+	}
+
+	FSensedTargetState& State = TargetStates[Index];
+	State.TargetId = Pawn.GetUniqueID();
+	// Only used to identify the pawn, the state never modifies it.
+	State.Pawn = const_cast<APawn*>(&Pawn);
+	State.LastTouchedUpdate = SensingUpdateCount;
+	if (const USensingSubsystem* SensingSubsystem = GetSensingSubsystem())
+	{
+		State.SightSamplePhase = SensingSubsystem->GetSamplingHash(this, &Pawn);
+	}
+	return State;
 }
 
-void UMovablePawnSensingComponent::BroadcastOnHearRemoteNoise(APawn& Instigator, const FVector& Location, float Volume)
+void UMovablePawnSensingComponent::PruneTargetStates()
 {
-	OnHearNoise.Broadcast(&Instigator, Location, Volume);
+	for (int32 Index = TargetStates.Num() - 1; Index >= 0; --Index)
+	{
+		const FSensedTargetState& State = TargetStates[Index];
+		const bool bExpired = !State.bSeen && !State.bHeard && State.Awareness <= 0.f
+			&& SensingUpdateCount - State.LastTouchedUpdate >= (uint32)FMath::Max(TargetStateExpiryUpdates, 1);
+		if (!State.Pawn.IsValid() || bExpired)
+		{
+			RemoveTargetStateAt(Index);
+		}
+	}
+	bHadLoSToPawn = IsSeeingAnyTarget();
 }
 
-bool UMovablePawnSensingComponent::CouldSeePawn(const APawn* Other, bool bMaySkipChecks)
+void UMovablePawnSensingComponent::RemoveTargetStateAt(int32 Index)
 {
-	if (!Other)
+	TargetStateIndices.Remove(TargetStates[Index].TargetId);
+	TargetStates.RemoveAtSwap(Index, 1, false);
+	if (TargetStates.IsValidIndex(Index))
 	{
-		return false;
+		TargetStateIndices.Add(TargetStates[Index].TargetId, Index);
 	}
+}
 
-	const AActor* Owner = GetOwner();
-	if (!Owner)
+bool UMovablePawnSensingComponent::IsSeeingAnyTarget() const
+{
+	return TargetStates.ContainsByPredicate([](const FSensedTargetState& State) { return State.bSeen; });
+}
+
+void UMovablePawnSensingComponent::UpdateReplicatedPerception()
+{
+	if (!GetIsReplicated())
 	{
-		return false;
+		return;
 	}
 
-	
-	FVector const OtherLoc = Other->GetActorLocation();
-	FVector const SensorLoc = GetSensorLocation();
-	FVector const SelfToOther = OtherLoc - SensorLoc;
+	SCOPE_CYCLE_COUNTER(STAT_Sensing_ReplicatedPerception);
 
-	// check max sight distance
-	float const SelfToOtherDistSquared = SelfToOther.SizeSquared();
-	if (SelfToOtherDistSquared > FMath::Square(SightRadius))
+	const double Now = GetWorld()->GetTimeSeconds();
+	const float Decay = AwarenessDecayRate * (float)(Now - LastPerceptionUpdateTime);
+	LastPerceptionUpdateTime = Now;
+
+	for (FSensedTargetState& State : TargetStates)
 	{
-		return false;
+		const float TargetAwareness = State.bSeen ? 1.f : (State.bHeard ? HeardAwareness : 0.f);
+		State.Awareness = FMath::Clamp(FMath::Max(TargetAwareness, State.Awareness - Decay), 0.f, 1.f);
 	}
 
-	// may skip if more than some fraction of maxdist away (longer time to acquire)
-	if (bMaySkipChecks && (FMath::Square(FMath::FRand()) * SelfToOtherDistSquared > FMath::Square(0.4f * SightRadius)))
+	TArray<FSensedTargetReplicationItem>& Items = ReplicatedTargets.Items;
+
+	// Targets that are gone, or that we stopped perceiving at all, lose their item.
+	TArray<APawn*, TInlineAllocator<4>> RemovedPawns;
+	Items.RemoveAllSwap([this, &RemovedPawns](const FSensedTargetReplicationItem& Item)
 	{
-		return false;
+		const FSensedTargetState* State = IsValid(Item.Pawn) ? FindTargetState(*Item.Pawn) : nullptr;
+		if (State != nullptr && (State->bSeen || State->bHeard || FMath::RoundToInt(State->Awareness * 255.f) > 0))
+		{
+			return false;
+		}
+		RemovedPawns.Add(Item.Pawn);
+		return true;
+	}, false);
+	if (RemovedPawns.Num() > 0)
+	{
+		ReplicatedTargets.MarkArrayDirty();
 	}
 
-	if(bIsDebug)
-		UE_LOG(LogPath, Warning, TEXT("DistanceToOtherSquared = %f, SightRadiusSquared: %f"), SelfToOtherDistSquared, FMath::Square(SightRadius));
+	for (const FSensedTargetState& State : TargetStates)
+	{
+		APawn* Pawn = State.Pawn.Get();
+		const uint8 Awareness = (uint8)FMath::RoundToInt(State.Awareness * 255.f);
+		const uint8 Flags = (uint8)((State.bSeen ? ESensedTargetFlags::Seen : ESensedTargetFlags::None) | (State.bHeard ? ESensedTargetFlags::Heard : ESensedTargetFlags::None));
+		if (Pawn == nullptr || (Flags == 0 && Awareness == 0))
+		{
+			continue;
+		}
 
-		// check field of view
-	FVector const SelfToOtherDir = SelfToOther.GetSafeNormal();
-	FVector const MyFacingDir = GetSensorRotation().GetSafeNormal();
+		FSensedTargetReplicationItem* Item = ReplicatedTargets.Find(Pawn);
+		if (Item == nullptr)
+		{
+			Item = &Items.AddDefaulted_GetRef();
+			Item->Pawn = Pawn;
+		}
+		else if (Item->Flags == Flags && Item->Awareness == Awareness)
+		{
+			continue;
+		}
 
-	SensorLocationVector = SensorLoc;
-	SelfToOtherDirection = OtherLoc;
-	FacingDirectionVectorDebug = MyFacingDir;
+		Item->Flags = Flags;
+		Item->Awareness = Awareness;
+		ReplicatedTargets.MarkItemDirty(*Item);
+		OnTargetPerceptionChanged.Broadcast(Pawn);
+	}
 
-	if (bIsDebug)
-		UE_LOG(LogPath, Warning, TEXT("DotProductFacing: %f, PeripheralVisionCosine: %f"), SelfToOtherDir | MyFacingDir, PeripheralVisionCosine);
+	for (APawn* Pawn : RemovedPawns)
+	{
+		OnTargetPerceptionChanged.Broadcast(Pawn);
+	}
+}
 
-	return ((SelfToOtherDir | MyFacingDir) >= PeripheralVisionCosine);
+bool UMovablePawnSensingComponent::GetPerceptionOf(const APawn* Pawn, bool& bOutSeen, bool& bOutHeard, float& OutAwareness) const
+{
+	const FSensedTargetReplicationItem* Item = ReplicatedTargets.Find(Pawn);
+	bOutSeen = Item != nullptr && Item->HasFlag(ESensedTargetFlags::Seen);
+	bOutHeard = Item != nullptr && Item->HasFlag(ESensedTargetFlags::Heard);
+	OutAwareness = Item != nullptr ? Item->GetAwareness() : 0.f;
+	return Item != nullptr;
 }
 
-bool UMovablePawnSensingComponent::IsNoiseRelevant(const APawn& Pawn, const UPawnNoiseEmitterComponent& NoiseEmitterComponent, bool bSourceWithinNoiseEmitter) const
+void UMovablePawnSensingComponent::SetAlarmed(bool bNewAlarmed)
 {
-	// If sound has no volume, it's not relevant.
-	if (NoiseEmitterComponent.GetLastNoiseVolume(bSourceWithinNoiseEmitter) <= 0.f)
+	if (bAlarmed != bNewAlarmed)
 	{
-		return false;
+		bAlarmed = bNewAlarmed;
+		OnAlarmedChanged.Broadcast(bNewAlarmed);
 	}
+}
 
-	float LastNoiseTime = NoiseEmitterComponent.GetLastNoiseTime(bSourceWithinNoiseEmitter);
-	// If the sound is too old, it's not relevant.
-	if (Pawn.GetWorld()->TimeSince(LastNoiseTime) > HearingMaxSoundAge)
+void UMovablePawnSensingComponent::OnRep_Alarmed()
+{
+	OnAlarmedChanged.Broadcast(bAlarmed);
+}
+
+bool UMovablePawnSensingComponent::IsSeeingPawn(const APawn* Pawn) const
+{
+	if (Pawn == nullptr)
+	{
+		return false;
+	}
+
+	const FSensedTargetState* State = FindTargetState(*Pawn);
+	return State != nullptr && State->bSeen;
+}
+
+void UMovablePawnSensingComponent::SensePawnNoise(APawn& Pawn, bool bHasFailedLineOfSightCheck)
+{
+	// Might not be able to hear or react to the sound at all... Or we hear the noise events in SenseNoiseEvents().
+	if (!bHearNoises || !OnHearNoise.IsBound() || bUseNoiseEvents)
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_Sensing_Hearing);
+
+	const UPawnNoiseEmitterComponent* NoiseEmitterComponent = Pawn.GetPawnNoiseEmitterComponent();
+	if (NoiseEmitterComponent && ShouldCheckAudibilityOf(&Pawn))
+	{
+		// ToDo: This should all still be refactored more significantly.  There's no reason that we should have to
+		// explicitly check "local" and "remote" (i.e. Pawn-emitted and other-source-emitted) sounds separately here.
+		// The noise emitter should handle all of those details for us so the sensing component doesn't need to know about
+		// them at all!
+		ESensingNoiseResult Result = SenseNoise(Pawn, *NoiseEmitterComponent, true, bHasFailedLineOfSightCheck);
+		if (Result == ESensingNoiseResult::NotHeard)
+		{
+			Result = SenseNoise(Pawn, *NoiseEmitterComponent, false, false);
+		}
+
+		if (Result == ESensingNoiseResult::NotHeard)
+		{
+			if (FSensedTargetState* State = FindTargetState(Pawn))
+			{
+				State->bHeard = false;
+			}
+		}
+	}
+}
+
+ESensingNoiseResult UMovablePawnSensingComponent::SenseNoise(APawn& Pawn, const UPawnNoiseEmitterComponent& NoiseEmitterComponent, bool bSourceWithinNoiseEmitter, bool bFailedLOS)
+{
+	if (!IsNoiseRelevant(Pawn, NoiseEmitterComponent, bSourceWithinNoiseEmitter))
+	{
+		return ESensingNoiseResult::NotHeard;
+	}
+
+	const FVector NoiseLoc = bSourceWithinNoiseEmitter ? Pawn.GetActorLocation() : NoiseEmitterComponent.LastRemoteNoisePosition;
+	const float Loudness = NoiseEmitterComponent.GetLastNoiseVolume(bSourceWithinNoiseEmitter);
+	const float NoiseTime = NoiseEmitterComponent.GetLastNoiseTime(bSourceWithinNoiseEmitter);
+	return SenseNoiseAt(Pawn, NoiseLoc, Loudness, NoiseTime, bSourceWithinNoiseEmitter, bFailedLOS, false);
+}
+
+ESensingNoiseResult UMovablePawnSensingComponent::SenseNoiseAt(APawn& Pawn, const FVector& NoiseLoc, float Loudness, float NoiseTime, bool bSourceWithinNoiseEmitter, bool bFailedLOS, bool bFromNoiseEvent)
+{
+	bool bHeard = false;
+	switch (GetHearingRange(NoiseLoc, Loudness, bFailedLOS))
+	{
+	case ESensingHearingRange::Audible:
+		bHeard = true;
+		break;
+	case ESensingHearingRange::NeedsOcclusionCheck:
+	{
+		FSensedTargetState& State = FindOrAddTargetState(Pawn);
+		FSensingTraceCacheEntry& NoiseCache = bSourceWithinNoiseEmitter ? State.LocalNoiseCache : State.RemoteNoiseCache;
+		const FVector HearingLocation = GetSensorLocation();
+
+		bool bOccluded = true;
+		if (IsPotentiallyVisible(HearingLocation, MakeArrayView(&NoiseLoc, 1)) && !LookupTraceCache(NoiseCache, HearingLocation, MakeArrayView(&NoiseLoc, 1), bOccluded))
+		{
+			const FSensingTraceCacheEntry CacheEntry = MakeTraceCacheEntry(HearingLocation, MakeArrayView(&NoiseLoc, 1));
+			if (ShouldDeferTraces())
+			{
+				RequestAsyncNoiseOcclusion(Pawn, NoiseLoc, Loudness, NoiseTime, bSourceWithinNoiseEmitter, bFromNoiseEvent, CacheEntry);
+				return ESensingNoiseResult::Pending;
+			}
+
+			bOccluded = IsNoiseOccluded(NoiseLoc);
+			StoreTraceCache(NoiseCache, CacheEntry, bOccluded);
+		}
+		bHeard = !bOccluded;
+		break;
+	}
+	default:
+		break;
+	}
+
+	if (!bHeard)
+	{
+		return ESensingNoiseResult::NotHeard;
+	}
+
+	NotifyNoiseHeard(Pawn, bSourceWithinNoiseEmitter, NoiseLoc, Loudness, NoiseTime);
+	return ESensingNoiseResult::Heard;
+}
+
+void UMovablePawnSensingComponent::SenseNoiseEvents()
+{
+	USensingSubsystem* SensingSubsystem = GetSensingSubsystem();
+	if (SensingSubsystem == nullptr || !bHearNoises || !OnHearNoise.IsBound())
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_Sensing_Hearing);
+
+	for (FSensedTargetState& State : TargetStates)
+	{
+		State.bHeard = false;
+	}
+
+	const FVector HearingLocation = GetSensorLocation();
+	NoiseEventCandidates.Reset();
+	LastNoiseEventId = SensingSubsystem->GatherNoiseEvents(HearingLocation, FMath::Max(HearingThreshold, LOSHearingThreshold), LastNoiseEventId, NoiseEventCandidates);
+
+	for (const FSensingNoiseEvent* Event : NoiseEventCandidates)
+	{
+		APawn* Pawn = Event->Instigator.Get();
+		if (!IsValid(Pawn) || IsSensorActor(Pawn) || !ShouldCheckAudibilityOf(Pawn))
+		{
+			continue;
+		}
+
+		if (Event->MaxRange > 0.f && FVector::DistSquared(HearingLocation, Event->Location) > FMath::Square(Event->MaxRange))
+		{
+			continue;
+		}
+
+		const FSensedTargetState* State = FindTargetState(*Pawn);
+		if (State != nullptr && State->bSeen)
+		{
+			// No need to 'hear' something if you've already seen it!
+			continue;
+		}
+
+		const bool bFailedLOS = Event->bSourceWithinNoiseEmitter && State != nullptr && State->bFailedLineOfSight;
+		SenseNoiseAt(*Pawn, Event->Location, Event->Loudness, Event->Time, Event->bSourceWithinNoiseEmitter, bFailedLOS, true);
+	}
+}
+
+void UMovablePawnSensingComponent::NotifyNoiseHeard(APawn& Pawn, bool bSourceWithinNoiseEmitter, const FVector& NoiseLoc, float Loudness, float NoiseTime)
+{
+	FSensedTargetState& State = FindOrAddTargetState(Pawn);
+	State.bHeard = true;
+
+	// A noise stays relevant for HearingMaxSoundAge, only report it the first time we hear it.
+	float& LastHeardNoiseTime = bSourceWithinNoiseEmitter ? State.LastLocalNoiseTime : State.LastRemoteNoiseTime;
+	const bool bIsNewNoise = NoiseTime > LastHeardNoiseTime;
+	LastHeardNoiseTime = FMath::Max(LastHeardNoiseTime, NoiseTime);
+
+	if (!bIsNewNoise && !bBroadcastContinuously)
+	{
+		return;
+	}
+
+	SENSING_VLOG_LOCATION(NoiseLoc, FColor::Yellow, TEXT("Heard %s, loudness %.2f"), *Pawn.GetName(), Loudness);
+
+	if (bSourceWithinNoiseEmitter)
+	{
+		BroadcastOnHearLocalNoise(Pawn, NoiseLoc, Loudness);
+	}
+	else
+	{
+		BroadcastOnHearRemoteNoise(Pawn, NoiseLoc, Loudness);
+	}
+}
+
+bool UMovablePawnSensingComponent::IsPotentiallyVisible(const FVector& Start, TArrayView<const FVector> Ends) const
+{
+	const USensingSubsystem* SensingSubsystem = bUsePotentiallyVisibleSet ? GetSensingSubsystem() : nullptr;
+	if (SensingSubsystem == nullptr)
+	{
+		return true;
+	}
+
+	for (const FVector& End : Ends)
+	{
+		if (SensingSubsystem->IsPotentiallyVisible(Start, End))
+		{
+			return true;
+		}
+	}
+
+	INC_DWORD_STAT(STAT_Sensing_PVSCulledTraces);
+	return false;
+}
+
+bool UMovablePawnSensingComponent::LookupTraceCache(const FSensingTraceCacheEntry& Entry, const FVector& Start, TArrayView<const FVector> Ends, bool& bOutResult)
+{
+	if (!bUseVisibilityCache)
+	{
+		return false;
+	}
+
+	bool bHit = false;
+	USensingSubsystem* SensingSubsystem = GetSensingSubsystem();
+	if (Entry.bValid && SensingSubsystem != nullptr)
+	{
+		const float ToleranceSquared = FMath::Square(VisibilityCacheTolerance);
+		const FBox EndBounds(Ends.GetData(), Ends.Num());
+		bHit = FVector::DistSquared(Entry.Start, Start) <= ToleranceSquared
+			&& FVector::DistSquared(Entry.EndBounds.Min, EndBounds.Min) <= ToleranceSquared
+			&& FVector::DistSquared(Entry.EndBounds.Max, EndBounds.Max) <= ToleranceSquared
+			&& (VisibilityCacheMaxAge <= 0.f || GetWorld()->GetTimeSeconds() - Entry.Time <= VisibilityCacheMaxAge);
+
+		// A single trace is checked along its segment. Traces to several points are checked against the box around all of
+		// them and the start, so an occluder moving across any of them invalidates the result, not just the outermost ones.
+		if (bHit && Entry.EndBounds.Min == Entry.EndBounds.Max)
+		{
+			bHit = SensingSubsystem->IsSegmentUnchanged(Entry.Start, Entry.EndBounds.Min, Entry.OccluderGeneration);
+		}
+		else if (bHit)
+		{
+			bHit = SensingSubsystem->IsRegionUnchanged(Entry.EndBounds + Entry.Start, Entry.OccluderGeneration);
+		}
+	}
+
+	if (bHit)
+	{
+		bOutResult = Entry.bResult;
+		++VisibilityCacheHits;
+		INC_DWORD_STAT(STAT_Sensing_VisibilityCacheHits);
+	}
+	else
+	{
+		++VisibilityCacheMisses;
+		INC_DWORD_STAT(STAT_Sensing_VisibilityCacheMisses);
+	}
+
+	if (SensingSubsystem != nullptr)
+	{
+		SensingSubsystem->RecordVisibilityCacheLookup(bHit);
+	}
+	return bHit;
+}
+
+FSensingTraceCacheEntry UMovablePawnSensingComponent::MakeTraceCacheEntry(const FVector& Start, TArrayView<const FVector> Ends) const
+{
+	FSensingTraceCacheEntry Entry;
+	if (!bUseVisibilityCache)
+	{
+		return Entry;
+	}
+
+	USensingSubsystem* SensingSubsystem = GetSensingSubsystem();
+	if (SensingSubsystem == nullptr)
+	{
+		return Entry;
+	}
+
+	Entry.Start = Start;
+	Entry.EndBounds = FBox(Ends.GetData(), Ends.Num());
+	Entry.Time = GetWorld()->GetTimeSeconds();
+	// Take the generation before tracing, so an occluder moving while an async trace is in flight still invalidates the result.
+	Entry.OccluderGeneration = SensingSubsystem->GetOccluderGeneration();
+	Entry.bValid = true;
+	return Entry;
+}
+
+void UMovablePawnSensingComponent::StoreTraceCache(FSensingTraceCacheEntry& Cache, const FSensingTraceCacheEntry& Entry, bool bResult) const
+{
+	if (Entry.bValid)
+	{
+		Cache = Entry;
+		Cache.bResult = bResult;
+	}
+}
+
+void UMovablePawnSensingComponent::RequestAsyncLineOfSight(APawn& Pawn, const FSightSampleLocations& Locations, const FSensingTraceCacheEntry& CacheEntry)
+{
+	// A previous request for this pawn is still in flight, its result will cover this interval too.
+	for (const TPair<uint32, FPendingSensingTrace>& Pending : PendingTraces)
+	{
+		if (Pending.Value.Pawn == &Pawn && Pending.Value.Stage != ESensingTraceStage::NoiseOcclusion)
+		{
+			return;
+		}
+	}
+
+	// Every sample point is traced at once, so the result is known next frame however many there are.
+	FPendingSensingTrace Request;
+	Request.Pawn = &Pawn;
+	Request.Stage = ESensingTraceStage::Sight;
+	Request.CacheEntry = CacheEntry;
+	Request.SightBatchId = ++LastAsyncTraceId;
+	PendingSightBatches.Add(Request.SightBatchId).NumPending = Locations.Num();
+
+	const FCollisionQueryParams Params = GetLineOfSightQueryParams(&Pawn);
+	const FVector ViewPoint = GetComponentLocation();
+	for (const FVector& Location : Locations)
+	{
+		SubmitAsyncTrace(Request, ViewPoint, Location, Params);
+	}
+}
+
+void UMovablePawnSensingComponent::RequestAsyncNoiseOcclusion(APawn& Pawn, const FVector& NoiseLoc, float Loudness, float NoiseTime, bool bSourceWithinNoiseEmitter, bool bFromNoiseEvent, const FSensingTraceCacheEntry& CacheEntry)
+{
+	FPendingSensingTrace Request;
+	Request.Pawn = &Pawn;
+	Request.Stage = ESensingTraceStage::NoiseOcclusion;
+	Request.NoiseLocation = NoiseLoc;
+	Request.NoiseVolume = Loudness;
+	Request.NoiseTime = NoiseTime;
+	Request.bSourceWithinNoiseEmitter = bSourceWithinNoiseEmitter;
+	Request.bFromNoiseEvent = bFromNoiseEvent;
+	Request.CacheEntry = CacheEntry;
+	SubmitAsyncTrace(Request, GetSensorLocation(), NoiseLoc, GetNoiseOcclusionQueryParams());
+}
+
+bool UMovablePawnSensingComponent::ShouldDeferTraces() const
+{
+	if (bUseAsyncTraces)
+	{
+		return true;
+	}
+
+	const USensingSubsystem* SensingSubsystem = GetSensingSubsystem();
+	return SensingSubsystem != nullptr && SensingSubsystem->IsDeferringTraces();
+}
+
+void UMovablePawnSensingComponent::SubmitAsyncTrace(const FPendingSensingTrace& Request, const FVector& Start, const FVector& End, const FCollisionQueryParams& Params)
+{
+	if (Request.Stage == ESensingTraceStage::NoiseOcclusion)
+	{
+		INC_DWORD_STAT(STAT_Sensing_HearingTraces);
+	}
+	else
+	{
+		INC_DWORD_STAT(STAT_Sensing_SightTraces);
+	}
+
+	const uint32 RequestId = ++LastAsyncTraceId;
+	PendingTraces.Add(RequestId, Request);
+
+	// During the sensing subsystem's update the traces of every sensor are run together across worker threads, and
+	// the results come back before the end of the frame.
+	USensingSubsystem* SensingSubsystem = GetSensingSubsystem();
+	if (SensingSubsystem != nullptr && SensingSubsystem->IsDeferringTraces())
+	{
+		SensingSubsystem->DeferTrace(this, RequestId, Start, End, Params);
+		return;
+	}
+
+	if (!AsyncTraceDelegate.IsBound())
+	{
+		AsyncTraceDelegate.BindUObject(this, &UMovablePawnSensingComponent::OnAsyncTraceCompleted);
+	}
+	GetWorld()->AsyncLineTraceByChannel(EAsyncTraceType::Test, Start, End, ECC_Visibility, Params, FCollisionResponseParams::DefaultResponseParam, &AsyncTraceDelegate, RequestId);
+}
+
+void UMovablePawnSensingComponent::OnAsyncTraceCompleted(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum)
+{
+	STEALTH_FRAME_COST_SCOPE(Sensing);
+
+	// Test traces only report whether something blocked the ray.
+	OnTraceCompleted(TraceDatum.UserData, TraceDatum.Start, TraceDatum.End, TraceDatum.OutHits.Num() > 0);
+}
+
+void UMovablePawnSensingComponent::OnTraceCompleted(uint32 RequestId, const FVector& Start, const FVector& End, bool bBlocked)
+{
+	FPendingSensingTrace Request;
+	if (!PendingTraces.RemoveAndCopyValue(RequestId, Request))
+	{
+		return;
+	}
+
+	APawn* Pawn = Request.Pawn.Get();
+	if (!IsValid(Pawn) || !IsValid(GetOwner()))
+	{
+		// The rest of the batch is dropped as it comes in.
+		PendingSightBatches.Remove(Request.SightBatchId);
+		if (PendingTraces.Num() == 0 && IsValid(GetOwner()))
+		{
+			UpdateReplicatedPerception();
+		}
+		return;
+	}
+
+	const bool bHit = bBlocked;
+
+	switch (Request.Stage)
+	{
+	case ESensingTraceStage::Sight:
+	{
+		FPendingSightBatch* Batch = PendingSightBatches.Find(Request.SightBatchId);
+		if (Batch == nullptr)
+		{
+			break;
+		}
+
+		SENSING_VLOG_SEGMENT(Start, End, bHit ? FColor::Red : FColor::Green, TEXT("Deferred sight %s"), bHit ? TEXT("blocked") : TEXT("clear"));
+		Batch->NumClear += bHit ? 0 : 1;
+		if (--Batch->NumPending > 0)
+		{
+			break;
+		}
+
+		const bool bHasLineOfSight = Batch->NumClear > 0;
+		PendingSightBatches.Remove(Request.SightBatchId);
+		StoreTraceCache(FindOrAddTargetState(*Pawn).SightCache, Request.CacheEntry, bHasLineOfSight);
+		UpdateLineOfSight(*Pawn, bHasLineOfSight);
+		if (!bHasLineOfSight)
+		{
+			SensePawnNoise(*Pawn, true);
+		}
+		break;
+	}
+	case ESensingTraceStage::NoiseOcclusion:
+	{
+		FSensedTargetState& State = FindOrAddTargetState(*Pawn);
+		StoreTraceCache(Request.bSourceWithinNoiseEmitter ? State.LocalNoiseCache : State.RemoteNoiseCache, Request.CacheEntry, bHit);
+		if (!bHit)
+		{
+			NotifyNoiseHeard(*Pawn, Request.bSourceWithinNoiseEmitter, Request.NoiseLocation, Request.NoiseVolume, Request.NoiseTime);
+		}
+		else if (Request.bSourceWithinNoiseEmitter && !Request.bFromNoiseEvent)
+		{
+			// The local noise was occluded, fall back to the remote one just like the synchronous path does.
+			const UPawnNoiseEmitterComponent* NoiseEmitterComponent = Pawn->GetPawnNoiseEmitterComponent();
+			if (NoiseEmitterComponent && bHearNoises && OnHearNoise.IsBound())
+			{
+				SenseNoise(*Pawn, *NoiseEmitterComponent, false, false);
+			}
+		}
+		break;
+	}
+	default:
+		break;
+	}
+
+	// Everything the results changed is folded into the replicated state once, when the last of them is back.
+	if (PendingTraces.Num() == 0)
+	{
+		UpdateReplicatedPerception();
+	}
+}
+
+void UMovablePawnSensingComponent::BroadcastOnSeePawn(APawn& Pawn)
+{
+	SCOPE_CYCLE_COUNTER(STAT_Sensing_Broadcast);
+	OnSeePawn.Broadcast(&Pawn);
+}
+
+void UMovablePawnSensingComponent::BroadcastOnUnSeePawn(APawn& Pawn)
+{
+	SCOPE_CYCLE_COUNTER(STAT_Sensing_Broadcast);
+	OnUnSeePawn.Broadcast(&Pawn);
+}
+
+void UMovablePawnSensingComponent::BroadcastOnHearLocalNoise(APawn& Instigator, const FVector& Location, float Volume)
+{
+	SCOPE_CYCLE_COUNTER(STAT_Sensing_Broadcast);
+	OnHearNoise.Broadcast(&Instigator, Location, Volume);
+}
+
+void UMovablePawnSensingComponent::BroadcastOnHearRemoteNoise(APawn& Instigator, const FVector& Location, float Volume)
+{
+	SCOPE_CYCLE_COUNTER(STAT_Sensing_Broadcast);
+	OnHearNoise.Broadcast(&Instigator, Location, Volume);
+}
+
+float UMovablePawnSensingComponent::GetEffectiveSightRadius(const APawn* Other) const
+{
+	const USensingSubsystem* SensingSubsystem = bUseIllumination && Other != nullptr ? GetSensingSubsystem() : nullptr;
+	if (SensingSubsystem == nullptr)
+	{
+		return SightRadius;
+	}
+
+	// Must match the scale the sensing subsystem's batch cull applies.
+	return SightRadius * FMath::Lerp(DarkSightRadiusScale, 1.f, SensingSubsystem->GetIllumination(Other->GetActorLocation()));
+}
+
+bool UMovablePawnSensingComponent::CouldSeePawn(const APawn* Other, bool bMaySkipChecks)
+{
+	if (!Other)
+	{
+		return false;
+	}
+
+	const AActor* Owner = GetOwner();
+	if (!Owner)
+	{
+		return false;
+	}
+
+	
+	FVector const OtherLoc = Other->GetActorLocation();
+	FVector const SensorLoc = GetSensorLocation();
+	FVector const SelfToOther = OtherLoc - SensorLoc;
+
+	// check max sight distance
+	float const SelfToOtherDistSquared = SelfToOther.SizeSquared();
+	float const EffectiveSightRadius = GetEffectiveSightRadius(Other);
+	if (SelfToOtherDistSquared > FMath::Square(EffectiveSightRadius))
+	{
+		SENSING_VLOG(TEXT("%s: beyond effective sight radius %.0f"), *Other->GetName(), EffectiveSightRadius);
+		return false;
+	}
+
+	// may skip if more than some fraction of maxdist away (longer time to acquire)
+	if (bMaySkipChecks && ShouldSkipSightCheck(*Other, SelfToOtherDistSquared))
+	{
+		return false;
+	}
+
+	// check field of view
+	FVector const SelfToOtherDir = SelfToOther.GetSafeNormal();
+	FVector const MyFacingDir = GetSensorRotation().GetSafeNormal();
+
+#if ENABLE_SENSING_DEBUG
+	if (bIsDebug)
+	{
+		SensorLocationVector = SensorLoc;
+		SelfToOtherDirection = OtherLoc;
+		FacingDirectionVectorDebug = MyFacingDir;
+	}
+#endif
+
+	const bool bInView = (SelfToOtherDir | MyFacingDir) >= PeripheralVisionCosine;
+	SENSING_VLOG(TEXT("%s: facing dot %.3f against peripheral vision cosine %.3f, %s"), *Other->GetName(), SelfToOtherDir | MyFacingDir, PeripheralVisionCosine, bInView ? TEXT("in view") : TEXT("out of view"));
+	return bInView;
+}
+
+bool UMovablePawnSensingComponent::ShouldSkipSightCheck(const APawn& Other, float DistSquared)
+{
+	FSensedTargetState& State = FindOrAddTargetState(Other);
+
+	const double Now = GetWorld()->GetTimeSeconds();
+	const FVector Direction = (Other.GetActorLocation() - GetSensorLocation()).GetSafeNormal();
+
+	float AngularSpeed = 0.f;
+	if (State.LastSightSampleTime >= 0.0 && Now > State.LastSightSampleTime)
+	{
+		const float Angle = FMath::Acos(FMath::Clamp(Direction | State.LastSightSampleDirection, -1.f, 1.f));
+		AngularSpeed = Angle / (float)(Now - State.LastSightSampleTime);
+	}
+	State.LastSightSampleDirection = Direction;
+	State.LastSightSampleTime = Now;
+
+	const uint32 Period = (uint32)GetSightSamplePeriod(FMath::Sqrt(DistSquared), AngularSpeed);
+	const uint32 Slot = State.SightSampleCount++ + State.SightSamplePhase;
+	if ((Slot % Period) != 0)
+	{
+		// A deliberate skip, so whatever we saw last time still stands.
+		State.bSightChecked = true;
+		return true;
+	}
+	return false;
+}
+
+int32 UMovablePawnSensingComponent::GetSightSamplePeriod(float Distance, float AngularSpeed) const
+{
+	const float FullRateDistance = SightSampleFullRateFraction * SightRadius;
+	if (FullRateDistance <= 0.f || Distance <= FullRateDistance)
+	{
+		return 1;
+	}
+
+	// Matches the average rate of the old random skip, which passed with probability FullRateDistance / Distance.
+	float Period = Distance / FullRateDistance;
+	if (SightSampleReferenceAngularSpeed > 0.f)
+	{
+		Period /= 1.f + AngularSpeed / FMath::DegreesToRadians(SightSampleReferenceAngularSpeed);
+	}
+	return FMath::Max(FMath::FloorToInt(Period), 1);
+}
+
+bool UMovablePawnSensingComponent::CouldSeePawnThisUpdate(const APawn& Pawn)
+{
+	SCOPE_CYCLE_COUNTER(STAT_Sensing_ConeCulling);
+
+	if (BatchSightTargets != nullptr && BatchSightTargets->Contains(&Pawn))
+	{
+		// Distance and peripheral vision were already tested by the sensing subsystem's batch, only the skip is left.
+		if (!BatchSightSurvivors.Contains(&Pawn))
+		{
+			return false;
+		}
+		return !ShouldSkipSightCheck(Pawn, (Pawn.GetActorLocation() - GetSensorLocation()).SizeSquared());
+	}
+
+	// Pairs culled by the batch are counted by the sensing subsystem.
+	const bool bCouldSee = CouldSeePawn(&Pawn, true);
+	if (!bCouldSee)
+	{
+		INC_DWORD_STAT(STAT_Sensing_CulledPairs);
+	}
+	return bCouldSee;
+}
+
+void UMovablePawnSensingComponent::BeginBatchSightResult(const TArray<APawn*>& Targets)
+{
+	BatchSightTargets = &Targets;
+	BatchSightSurvivors.Reset();
+}
+
+void UMovablePawnSensingComponent::AddBatchSightSurvivor(const APawn* Pawn)
+{
+	BatchSightSurvivors.Add(Pawn);
+}
+
+void UMovablePawnSensingComponent::ClearBatchSightResult()
+{
+	BatchSightTargets = nullptr;
+	BatchSightSurvivors.Reset();
+}
+
+bool UMovablePawnSensingComponent::IsNoiseRelevant(const APawn& Pawn, const UPawnNoiseEmitterComponent& NoiseEmitterComponent, bool bSourceWithinNoiseEmitter) const
+{
+	// If sound has no volume, it's not relevant.
+	if (NoiseEmitterComponent.GetLastNoiseVolume(bSourceWithinNoiseEmitter) <= 0.f)
+	{
+		return false;
+	}
+
+	float LastNoiseTime = NoiseEmitterComponent.GetLastNoiseTime(bSourceWithinNoiseEmitter);
+	// If the sound is too old, it's not relevant.
+	if (Pawn.GetWorld()->TimeSince(LastNoiseTime) > HearingMaxSoundAge)
 	{
 		return false;
 	}
@@ -485,17 +1488,17 @@ FVector UMovablePawnSensingComponent::GetSensorRotation() const
 	return SensorRotation;
 }
 
-bool UMovablePawnSensingComponent::CanHear(const FVector& NoiseLoc, float Loudness, bool bFailedLOS) const
+ESensingHearingRange UMovablePawnSensingComponent::GetHearingRange(const FVector& NoiseLoc, float Loudness, bool bFailedLOS) const
 {
 	if (Loudness <= 0.f)
 	{
-		return false;
+		return ESensingHearingRange::OutOfRange;
 	}
 
 	const AActor* const Owner = GetOwner();
 	if (!IsValid(Owner))
 	{
-		return false;
+		return ESensingHearingRange::OutOfRange;
 	}
 
 	FVector const HearingLocation = GetSensorLocation();
@@ -504,23 +1507,55 @@ bool UMovablePawnSensingComponent::CanHear(const FVector& NoiseLoc, float Loudne
 	if (LoudnessAdjustedDistSq <= FMath::Square(HearingThreshold))
 	{
 		// Hear even occluded sounds within HearingThreshold
-		return true;
+		return ESensingHearingRange::Audible;
 	}
 
 	// check if sound close enough to do LOS check, and LOS hasn't already failed
 	if (bFailedLOS || (LoudnessAdjustedDistSq > FMath::Square(LOSHearingThreshold)))
 	{
-		return false;
+		return ESensingHearingRange::OutOfRange;
 	}
 
-	// check if sound is occluded
-	return !Owner->GetWorld()->LineTraceTestByChannel(HearingLocation, NoiseLoc, ECC_Visibility, FCollisionQueryParams(SCENE_QUERY_STAT(CanHear), true, Owner));
+	// Sound goes around walls through the openings between rooms, the length of that path decides instead of a trace.
+	const USensingSubsystem* SensingSubsystem = bUseRoomGraph ? GetSensingSubsystem() : nullptr;
+	float PropagatedDistance = 0.f;
+	if (SensingSubsystem != nullptr && SensingSubsystem->GetPropagatedSoundDistance(HearingLocation, NoiseLoc, PropagatedDistance))
+	{
+		return PropagatedDistance <= LOSHearingThreshold * Loudness ? ESensingHearingRange::Audible : ESensingHearingRange::OutOfRange;
+	}
+
+	return ESensingHearingRange::NeedsOcclusionCheck;
+}
+
+FCollisionQueryParams UMovablePawnSensingComponent::GetNoiseOcclusionQueryParams() const
+{
+	return FCollisionQueryParams(SCENE_QUERY_STAT(CanHear), true, GetOwner());
+}
+
+bool UMovablePawnSensingComponent::IsNoiseOccluded(const FVector& NoiseLoc) const
+{
+	INC_DWORD_STAT(STAT_Sensing_HearingTraces);
+	return GetWorld()->LineTraceTestByChannel(GetSensorLocation(), NoiseLoc, ECC_Visibility, GetNoiseOcclusionQueryParams());
+}
+
+bool UMovablePawnSensingComponent::CanHear(const FVector& NoiseLoc, float Loudness, bool bFailedLOS) const
+{
+	switch (GetHearingRange(NoiseLoc, Loudness, bFailedLOS))
+	{
+	case ESensingHearingRange::Audible:
+		return true;
+	case ESensingHearingRange::NeedsOcclusionCheck:
+		// check if sound is occluded
+		return !IsNoiseOccluded(NoiseLoc);
+	default:
+		return false;
+	}
 }
 
 bool UMovablePawnSensingComponent::ShouldCheckVisibilityOf(APawn* Pawn) const
 {
 	const bool bPawnIsPlayer = (Pawn->Controller && Pawn->Controller->PlayerState);
-	if (!bSeePawns || (bOnlySensePlayers && !bPawnIsPlayer))
+	if (!bSeePawns || SensingLOD >= ESensingLOD::HearingOnly || (bOnlySensePlayers && !bPawnIsPlayer))
 	{
 		return false;
 	}
@@ -6,16 +6,189 @@
 #include "UObject/ObjectMacros.h"
 #include "Engine/EngineTypes.h"
 #include "Components/ActorComponent.h"
+#include "Components/SceneComponent.h"
+#include "CollisionQueryParams.h"
+#include "WorldCollision.h"
+#include "SensingReplication.h"
 #include "MovablePawnSensingComponent.generated.h"
 
 class AActor;
 class AController;
 class APawn;
 class UPawnNoiseEmitterComponent;
+class USensingSubsystem;
+struct FSensingNoiseEvent;
+
+/** World locations a line of sight check traces to, see UMovablePawnSensingComponent::SightSamplePoints. */
+typedef TArray<FVector, TInlineAllocator<8>> FSightSampleLocations;
+
+/** How much work a sensor does per update, picked from its significance to the players, see USensingSubsystem. */
+UENUM(BlueprintType)
+enum class ESensingLOD : uint8
+{
+	/** Sight and hearing every SensingInterval. */
+	Full,
+	/** Sight and hearing, every SensingInterval * ReducedSensingIntervalScale. */
+	Reduced,
+	/** Hearing only, every SensingInterval * ReducedSensingIntervalScale. */
+	HearingOnly,
+	/** No updates at all. */
+	Suspended,
+};
+
+/** How a noise relates to a sensor's hearing thresholds, before any occlusion test. */
+enum class ESensingHearingRange : uint8
+{
+	OutOfRange,
+	Audible,
+	NeedsOcclusionCheck,
+};
+
+/** Outcome of testing a single noise. Pending means an asynchronous occlusion trace will decide it later. */
+enum class ESensingNoiseResult : uint8
+{
+	NotHeard,
+	Heard,
+	Pending,
+};
+
+/** Which step of SensePawn() an asynchronous trace belongs to. */
+enum class ESensingTraceStage : uint8
+{
+	/** One of the line of sight traces to a target's sample points, all issued together. */
+	Sight,
+	NoiseOcclusion,
+};
+
+/** A point on a target that line of sight is traced to. */
+USTRUCT(BlueprintType)
+struct FSightSamplePoint
+{
+	GENERATED_BODY()
+
+	/** Socket of the target's character mesh to trace to. Targets without such a socket use HeightFraction instead. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AI)
+		FName SocketName;
+
+	/** Height on the target's collision capsule, from -1 at the bottom through 0 at its center to 1 at the top. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AI, meta = (ClampMin = "-1.0", ClampMax = "1.0"))
+		float HeightFraction = 0.f;
+};
+
+/**
+ * A line of sight or noise occlusion result remembered between sensing updates, see UMovablePawnSensingComponent::bUseVisibilityCache.
+ * The result holds for as long as none of the end points moved and no dynamic occluder changed across the traces.
+ */
+struct FSensingTraceCacheEntry
+{
+	FVector Start = FVector::ZeroVector;
+
+	/**
+	 * Box around the end points of the traces, a single point when there is only one trace. Line of sight traces to
+	 * every sample point of the target, so the whole fan from Start to this box is checked for occluder changes.
+	 */
+	FBox EndBounds = FBox(ForceInit);
+
+	/** World time the result was traced at. */
+	double Time = 0.0;
+
+	/** USensingSubsystem::GetOccluderGeneration() when the traces were issued. */
+	uint32 OccluderGeneration = 0;
+
+	bool bValid = false;
+	bool bResult = false;
+};
+
+/**
+ * Bookkeeping for a trace issued with AsyncLineTraceByChannel, or deferred to the sensing subsystem's parallel trace phase,
+ * consumed when its result arrives.
+ */
+struct FPendingSensingTrace
+{
+	TWeakObjectPtr<APawn> Pawn;
+	ESensingTraceStage Stage = ESensingTraceStage::Sight;
+
+	/** Key of the FPendingSightBatch the trace counts towards, for ESensingTraceStage::Sight. */
+	uint32 SightBatchId = 0;
+	FVector NoiseLocation = FVector::ZeroVector;
+	float NoiseVolume = 0.f;
+	float NoiseTime = 0.f;
+	bool bSourceWithinNoiseEmitter = false;
+
+	/** True if the noise came from the sensing subsystem's noise bus rather than from the pawn's noise emitter. */
+	bool bFromNoiseEvent = false;
+
+	/** End points the trace was issued for, stored in the visibility cache once the result is known. */
+	FSensingTraceCacheEntry CacheEntry;
+};
+
+/** Line of sight traces to the sample points of one target that are still in flight. */
+struct FPendingSightBatch
+{
+	int32 NumPending = 0;
+	int32 NumClear = 0;
+};
+
+/** What a sensor currently knows about one target, so notifications are only broadcast when something changes. */
+struct FSensedTargetState
+{
+	/** Stable id of the target (its UObject unique id). */
+	uint32 TargetId = 0;
+
+	TWeakObjectPtr<APawn> Pawn;
+
+	/** Time stamps of the last local and remote noise of this target that we have already reported. */
+	float LastLocalNoiseTime = -1.f;
+	float LastRemoteNoiseTime = -1.f;
+
+	/** Last line of sight result, bResult is true if the target was visible. */
+	FSensingTraceCacheEntry SightCache;
+
+	/** Last occlusion results of the local and remote noise, bResult is true if the noise was occluded. */
+	FSensingTraceCacheEntry LocalNoiseCache;
+	FSensingTraceCacheEntry RemoteNoiseCache;
+
+	/** True while we have line of sight to the target. */
+	uint8 bSeen : 1;
+
+	/** True if the target was heard during its last update. */
+	uint8 bHeard : 1;
+
+	/** True if the last line of sight check of this update failed. Noises made by the target are then only heard within HearingThreshold. */
+	uint8 bFailedLineOfSight : 1;
+
+	/** True if this update checked the target's line of sight, or skipped it on the sight sampling schedule. Seen targets that were not are no longer seen. */
+	uint8 bSightChecked : 1;
+
+	/** How aware we are of the target, from 0 to 1. Rises when it is seen or heard and decays at AwarenessDecayRate otherwise. */
+	float Awareness = 0.f;
+
+	/** Number of times the target reached the sight sampling schedule, see UMovablePawnSensingComponent::ShouldSkipSightCheck(). */
+	uint32 SightSampleCount = 0;
+
+	/** Seeded offset into the sampling schedule, so targets at the same distance are not all checked on the same update. */
+	uint32 SightSamplePhase = 0;
+
+	/** Direction from the sensor to the target when it last reached the sampling schedule, to measure its angular speed. */
+	FVector LastSightSampleDirection = FVector::ZeroVector;
+	double LastSightSampleTime = -1.0;
+
+	/** Value of the sensor's update counter when the target was last within reach of its senses. */
+	uint32 LastTouchedUpdate = 0;
+
+	FSensedTargetState()
+		: bSeen(false)
+		, bHeard(false)
+		, bFailedLineOfSight(false)
+		, bSightChecked(false)
+	{
+	}
+};
 
 /**
  * MovablePawnSensingComponent encapsulates sensory (ie sight and hearing) settings and functionality for an Actor,
- * allowing the actor to see/hear Pawns in the world. It does nothing on network clients.
+ * allowing the actor to see/hear Pawns in the world. Sensing only runs on the server, clients receive what each sensor
+ * perceives (see GetPerceptionOf() and IsAlarmed()) to drive their own feedback.
  * The component can be moved in order to change where the Actor's sensory organs (ie eyes and ears) are.
  */
 UCLASS(ClassGroup = (Custom), meta = (BlueprintSpawnableComponent))
@@ -25,6 +198,7 @@ class STEALTHGAME_API UMovablePawnSensingComponent : public USceneComponent
 
 	DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FSeePawnDelegate, APawn*, Pawn);
 	DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FHearNoiseDelegate, APawn*, Instigator, const FVector&, Location, float, Volume);
+	DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FAlarmedDelegate, bool, bAlarmed);
 
 	/** Max distance at which a makenoise(1.0) loudness sound can be heard, regardless of occlusion */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AI)
@@ -65,7 +239,7 @@ class STEALTHGAME_API UMovablePawnSensingComponent : public USceneComponent
 	UPROPERTY(BlueprintReadOnly, Category = Debug)
 		FVector SensorLocationVector;
 
-	//Toggle for enabing debugging
+	//Toggle for filling in the debug vectors above. Only has an effect in builds with ENABLE_SENSING_DEBUG, the visual logger records every sensor regardless
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Debug)
 		bool bIsDebug;
 
@@ -93,6 +267,13 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "AI|Components|MovablePawnSensing")
 		float GetPeripheralVisionCosine() const;
 
+	/** SightRadius scaled down by the light level at Other, see DarkSightRadiusScale. */
+	UFUNCTION(BlueprintCallable, Category = "AI|Components|MovablePawnSensing")
+		float GetEffectiveSightRadius(const APawn* Other) const;
+
+	/** DarkSightRadiusScale, or 1 if illumination is not used. */
+	float GetDarkSightRadiusScale() const { return bUseIllumination ? DarkSightRadiusScale : 1.f; }
+
 	/** If true, component will perform sensing updates. At runtime change this using SetSensingUpdatesEnabled(). */
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = AI)
 		uint32 bEnableSensingUpdates : 1;
@@ -112,10 +293,125 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AI)
 		uint32 bHearNoises : 1;
 
-	/** True when we had LoS to a pawn in the previus check, false otherwise */
+	/**
+	 * If true, line of sight and hearing occlusion traces are issued with AsyncLineTraceByChannel and their results
+	 * are consumed on the next frame, instead of blocking the game thread. Notifications arrive one frame later. Default: false
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AI)
+		uint32 bUseAsyncTraces : 1;
+
+	/**
+	 * If true, hearing listens to the noises reported through AActor::MakeNoise() since the last update, delivered by the
+	 * sensing subsystem, instead of polling the last local and remote noise of every pawn's noise emitter. No noise is missed
+	 * between updates, and the cost depends on the number of noises made nearby rather than on the number of pawns.
+	 * HearingMaxSoundAge does not apply. Default: false
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AI)
+		uint32 bUseNoiseEvents : 1;
+
+	/**
+	 * If true, OnSeePawn is broadcast on every update a pawn stays visible and OnHearNoise every update a noise stays relevant.
+	 * Otherwise notifications are only broadcast when a pawn starts being seen, or when a new noise is heard. Default: false
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AI)
+		uint32 bBroadcastContinuously : 1;
+
+	/** Number of sensing updates after which a target that is neither seen nor heard, and that we are no longer aware of, is forgotten. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AI, AdvancedDisplay, meta = (ClampMin = "1"))
+		int32 TargetStateExpiryUpdates;
+
+	/**
+	 * If true, line of sight and noise occlusion results are reused on later updates, as long as neither the sensor nor the
+	 * target moved more than VisibilityCacheTolerance and no movable occluder changed across the trace. Sight direction is
+	 * not part of the cache, the view cone is still tested every update. Default: true
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AI)
+		uint32 bUseVisibilityCache : 1;
+
+	/**
+	 * If true, line of sight and noise occlusion traces are skipped when the potentially visible set baked by an
+	 * ASensingVisibilityVolume proves that static geometry blocks them. Default: true
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AI)
+		uint32 bUsePotentiallyVisibleSet : 1;
+
+	/**
+	 * If true, noises between two rooms of a room graph baked by an ASensingVisibilityVolume are heard if the path through
+	 * the portals between the rooms is within LOSHearingThreshold, instead of tracing a straight line. Default: true
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AI)
+		uint32 bUseRoomGraph : 1;
+
+	/** How far the sensor or a target may move before a cached trace result is traced again. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AI, meta = (EditCondition = "bUseVisibilityCache", ClampMin = "0.0"))
+		float VisibilityCacheTolerance;
+
+	/**
+	 * Cached trace results older than this many seconds are traced again, to catch occluders the sensing subsystem does not track
+	 * (such as components whose mobility changed at runtime). A value <= 0 keeps results until they are invalidated.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AI, meta = (EditCondition = "bUseVisibilityCache"))
+		float VisibilityCacheMaxAge;
+
+	/** Number of traces the visibility cache saved this sensor. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = Debug)
+		int32 VisibilityCacheHits;
+
+	/** Number of visibility cache lookups that had to trace. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = Debug)
+		int32 VisibilityCacheMisses;
+
+	/**
+	 * If true, the sensing subsystem lowers our SensingLOD when we matter little to the players: far away, on another floor,
+	 * behind walls and off screen. Sensors that currently see a pawn never drop below ESensingLOD::Reduced. Default: true
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AI)
+		uint32 bUseSignificanceLOD : 1;
+
+	/** SensingInterval is multiplied by this at ESensingLOD::Reduced and ESensingLOD::HearingOnly. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AI, meta = (EditCondition = "bUseSignificanceLOD", ClampMin = "1.0"))
+		float ReducedSensingIntervalScale;
+
+	/** Changes the sensing LOD. Resumes updates when leaving ESensingLOD::Suspended and stops them when entering it. */
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly, Category = "AI|Components|MovablePawnSensing")
+		void SetSensingLOD(ESensingLOD NewLOD);
+
+	UFUNCTION(BlueprintCallable, Category = "AI|Components|MovablePawnSensing")
+		ESensingLOD GetSensingLOD() const { return SensingLOD; }
+
+	/** Time between two updates at the current sensing LOD. */
+	float GetEffectiveSensingInterval() const;
+
+	/** True when we have LoS to at least one pawn, false otherwise */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = AI)
 		bool bHadLoSToPawn = false;
 
+	/** Returns true if Pawn was visible during its last check. */
+	UFUNCTION(BlueprintCallable, Category = "AI|Components|MovablePawnSensing")
+		bool IsSeeingPawn(const APawn* Pawn) const;
+
+	/**
+	 * What we perceive of Pawn, as replicated, so this also works on clients. Awareness is quantized to 1/255.
+	 * @return false if Pawn is neither seen, heard nor remembered.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "AI|Components|MovablePawnSensing")
+		bool GetPerceptionOf(const APawn* Pawn, bool& bOutSeen, bool& bOutHeard, float& OutAwareness) const;
+
+	/** Raises or clears the alarm, which is replicated along with the perceived targets. */
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly, Category = "AI|Components|MovablePawnSensing")
+		void SetAlarmed(bool bNewAlarmed);
+
+	UFUNCTION(BlueprintCallable, Category = "AI|Components|MovablePawnSensing")
+		bool IsAlarmed() const { return bAlarmed; }
+
+	/** Awareness a target gets while it is heard but not seen. Seen targets are fully aware. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AI, meta = (ClampMin = "0.0", ClampMax = "1.0"))
+		float HeardAwareness;
+
+	/** Awareness lost per second by targets that are neither seen nor heard. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AI, meta = (ClampMin = "0.0"))
+		float AwarenessDecayRate;
+
 	/** Is the given actor our owner? Used to ensure that we are not trying to sense our self / our owner. */
 	virtual bool IsSensorActor(const AActor* Actor) const;
 
@@ -132,6 +428,50 @@ public:
 	 */
 	virtual bool CouldSeePawn(const APawn* Other, bool bMaySkipChecks = false);
 
+	/**
+	 * Skips checks on pawns that are more than SightSampleFullRateFraction of SightRadius away, so far pawns take longer to acquire.
+	 * Each target is checked once every GetSightSamplePeriod() calls, at a phase derived from the sensing subsystem's seed,
+	 * so detection times are the same from run to run.
+	 */
+	virtual bool ShouldSkipSightCheck(const APawn& Other, float DistSquared);
+
+	/** Number of sensing updates between two sight checks of a target at Distance that sweeps across our view at AngularSpeed (radians per second). */
+	virtual int32 GetSightSamplePeriod(float Distance, float AngularSpeed) const;
+
+	/** Fraction of SightRadius within which targets are checked on every update. Further targets are checked proportionally less often. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AI, meta = (ClampMin = "0.0", ClampMax = "1.0"))
+		float SightSampleFullRateFraction;
+
+	/**
+	 * Angular speed, in degrees per second, at which a target is checked twice as often as a still one at the same distance.
+	 * Targets crossing our view quickly are picked up sooner. A value <= 0 ignores angular speed.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AI)
+		float SightSampleReferenceAngularSpeed;
+
+	/**
+	 * Points on a target that line of sight is traced to, in order. The target is seen as soon as one of them is visible,
+	 * so a pawn peeking out of partial cover is still spotted. Targets beyond FARSIGHTTHRESHOLD, and actors other than
+	 * pawns that are beyond NEARSIGHTTHRESHOLD or have no capsule, are only traced to their target location.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AI)
+		TArray<FSightSamplePoint> SightSamplePoints;
+
+	/**
+	 * If true, targets in the dark are only seen from closer, using the light levels baked by an ASensingVisibilityVolume.
+	 * Default: true
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AI)
+		uint32 bUseIllumination : 1;
+
+	/** Fraction of SightRadius within which a target in complete darkness is seen. The radius grows linearly to SightRadius as the target gets lit. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AI, meta = (EditCondition = "bUseIllumination", ClampMin = "0.0", ClampMax = "1.0"))
+		float DarkSightRadiusScale;
+
+	/** Sample heights on a sneaking AStealthGameCharacter are scaled by this. Its capsule stays full height while it ducks. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = AI, meta = (ClampMin = "0.0", ClampMax = "1.0"))
+		float SneakingSightHeightScale;
+
 	/** Returns true if we should check whether we can hear the given Pawn (because we are able to hear, and the Pawn has the correct team relationship to us) */
 	virtual bool ShouldCheckAudibilityOf(APawn* Pawn) const;
 
@@ -142,6 +482,9 @@ public:
 	 */
 	virtual bool HasLineOfSightTo(const AActor* Other) const;
 
+	/** Traces to every sample point of Other. @return the fraction of them that is visible. */
+	virtual float GetLineOfSightFraction(const AActor* Other) const;
+
 	/** Test whether the noise is loud enough and recent enough to care about.  bSourceWithinNoiseEmitter is true iff the
 	 * noise was made by the pawn itself or within close proximity (its collision volume).  Otherwise the noise was made
 	 * at significant distance from the pawn.
@@ -151,8 +494,19 @@ public:
 	/** @Returns true if sensor can hear this noise. Only executed if the noise has been determined to be relevant (via IsNoiseRelevant) */
 	virtual bool CanHear(const FVector& NoiseLoc, float Loudness, bool bFailedLOS) const;
 
+	/**
+	 * The distance part of CanHear(): whether the noise is audible outright, out of range, or needs an occlusion trace.
+	 * Noises that a room graph knows the path to are never left to the trace.
+	 */
+	ESensingHearingRange GetHearingRange(const FVector& NoiseLoc, float Loudness, bool bFailedLOS) const;
+
+	/** Traces from the sensor to NoiseLoc. @return true if the noise is blocked. */
+	bool IsNoiseOccluded(const FVector& NoiseLoc) const;
+
 	//~ Begin UActorComponent Interface.
 	virtual void InitializeComponent() override;
+	virtual void UninitializeComponent() override;
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
 	//~ End UActorComponent Interface.
 
 	/** Get position where hearing/seeing occurs (i.e. ear/eye position).  If we ever need different positions for hearing/seeing, we'll deal with that then! */
@@ -166,18 +520,152 @@ protected:
 	/** See if there are interesting sounds and sights that we want to detect, and respond to them if so. */
 	virtual void SensePawn(APawn& Pawn);
 
-	/** Update function called on timer intervals. */
-	virtual void OnTimer();
+	/** CouldSeePawn() for the periodic update, using the sensing subsystem's batch cull result when it covers Pawn. */
+	bool CouldSeePawnThisUpdate(const APawn& Pawn);
+
+	/** Records the result of a line of sight check on Pawn, and broadcasts the see/unsee notifications if it changed. */
+	void UpdateLineOfSight(APawn& Pawn, bool bHasLineOfSight);
+
+	/** Records that a noise of Pawn was heard, and broadcasts OnHearNoise if we had not heard that noise yet. */
+	void NotifyNoiseHeard(APawn& Pawn, bool bSourceWithinNoiseEmitter, const FVector& NoiseLoc, float Loudness, float NoiseTime);
+
+	FSensedTargetState* FindTargetState(const APawn& Pawn);
+	const FSensedTargetState* FindTargetState(const APawn& Pawn) const;
+
+	/** Returns the state of Pawn, creating it if needed, and marks the target as touched by the current update. */
+	FSensedTargetState& FindOrAddTargetState(const APawn& Pawn);
+
+	/** Drops the state of targets that no longer exist, and of targets we have lost all interest in for TargetStateExpiryUpdates updates. */
+	void PruneTargetStates();
+
+	void RemoveTargetStateAt(int32 Index);
+
+	/** Updates the awareness of every target and copies what changed into ReplicatedTargets. */
+	void UpdateReplicatedPerception();
+
+	/** Targets we perceive, replicated to clients. Only updated on the server, and only if the component replicates. */
+	UPROPERTY(Replicated)
+		FSensedTargetReplicationArray ReplicatedTargets;
+
+	UPROPERTY(ReplicatedUsing = OnRep_Alarmed)
+		uint8 bAlarmed : 1;
+
+	UFUNCTION()
+		void OnRep_Alarmed();
+
+	/** World time of the last UpdateReplicatedPerception(), awareness decays from there. */
+	double LastPerceptionUpdateTime;
 
-	/** Handle for efficient management of OnTimer timer */
-	FTimerHandle TimerHandle_OnTimer;
+	bool IsSeeingAnyTarget() const;
+
+	/** Per-target perception state, packed so updates can walk it. */
+	TArray<FSensedTargetState> TargetStates;
+
+	/** Index into TargetStates of each target, keyed by FSensedTargetState::TargetId. */
+	TMap<uint32, int32> TargetStateIndices;
+
+	/** Number of UpdateAISensing() calls so far, used to expire target states. */
+	uint32 SensingUpdateCount;
+
+	/** Hearing half of SensePawn(): checks the local noise and then the remote noise of Pawn's noise emitter. */
+	void SensePawnNoise(APawn& Pawn, bool bHasFailedLineOfSightCheck);
+
+	/** Tests one of Pawn's noises and broadcasts OnHearNoise if it is heard. */
+	ESensingNoiseResult SenseNoise(APawn& Pawn, const UPawnNoiseEmitterComponent& NoiseEmitterComponent, bool bSourceWithinNoiseEmitter, bool bFailedLOS);
+
+	/** Tests a noise Pawn made at NoiseLoc, and broadcasts OnHearNoise if it is heard. */
+	ESensingNoiseResult SenseNoiseAt(APawn& Pawn, const FVector& NoiseLoc, float Loudness, float NoiseTime, bool bSourceWithinNoiseEmitter, bool bFailedLOS, bool bFromNoiseEvent);
+
+	/** Hearing for bUseNoiseEvents: tests every noise event made within earshot since the last update. */
+	void SenseNoiseEvents();
+
+	/** Id of the last noise event processed by SenseNoiseEvents(). */
+	uint32 LastNoiseEventId;
+
+	/** Scratch array for SenseNoiseEvents(). */
+	TArray<const FSensingNoiseEvent*> NoiseEventCandidates;
+
+	/** Query params shared by the synchronous and asynchronous line of sight traces. */
+	FCollisionQueryParams GetLineOfSightQueryParams(const AActor* Other) const;
+
+	/** Query params shared by the synchronous and asynchronous hearing occlusion traces. */
+	FCollisionQueryParams GetNoiseOcclusionQueryParams() const;
+
+	/** Whether Other is close enough, and shaped right, to trace to all of SightSamplePoints rather than just its target location. */
+	bool ShouldTraceSightSamplePoints(const AActor* Other) const;
+
+	/** End points of the line of sight traces to Other. */
+	void GetSightSampleLocations(const AActor* Other, FSightSampleLocations& OutLocations) const;
+
+	/** Traces one line of sight ray. @return true if it is blocked. */
+	bool IsSightRayBlocked(const FVector& ViewPoint, const FVector& Location, const FCollisionQueryParams& Params) const;
+
+	/** Traces from the sensor to every location. @return the fraction that is visible, or 1 / Num as soon as one is if bStopAtFirstClear. */
+	float TraceSightSamples(const AActor* Other, const FSightSampleLocations& Locations, bool bStopAtFirstClear) const;
+
+	/** Returns false if the baked potentially visible set proves that the traces from Start to all of Ends are blocked. */
+	bool IsPotentiallyVisible(const FVector& Start, TArrayView<const FVector> Ends) const;
+
+	/** Returns true and the cached result if Entry still holds for the traces from Start to all of Ends. Counts a visibility cache hit or miss. */
+	bool LookupTraceCache(const FSensingTraceCacheEntry& Entry, const FVector& Start, TArrayView<const FVector> Ends, bool& bOutResult);
+
+	/** Describes the traces from Start to all of Ends that are about to be issued, so their result can be stored with StoreTraceCache(). */
+	FSensingTraceCacheEntry MakeTraceCacheEntry(const FVector& Start, TArrayView<const FVector> Ends) const;
+
+	void StoreTraceCache(FSensingTraceCacheEntry& Cache, const FSensingTraceCacheEntry& Entry, bool bResult) const;
+
+	/** Issues the line of sight traces to all of Locations at once. Hearing follows in OnAsyncTraceCompleted() once the last one is back. */
+	void RequestAsyncLineOfSight(APawn& Pawn, const FSightSampleLocations& Locations, const FSensingTraceCacheEntry& CacheEntry);
+
+	/** Issues an occlusion trace for a noise that is within LOSHearingThreshold. */
+	void RequestAsyncNoiseOcclusion(APawn& Pawn, const FVector& NoiseLoc, float Loudness, float NoiseTime, bool bSourceWithinNoiseEmitter, bool bFromNoiseEvent, const FSensingTraceCacheEntry& CacheEntry);
+
+	void SubmitAsyncTrace(const FPendingSensingTrace& Request, const FVector& Start, const FVector& End, const FCollisionQueryParams& Params);
+
+	/** Called by the world once an asynchronous trace has finished. */
+	void OnAsyncTraceCompleted(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum);
+
+	/** Continues the SensePawn() step an asynchronous or deferred trace belongs to. Updates the replicated perception once no trace is left pending. */
+	void OnTraceCompleted(uint32 RequestId, const FVector& Start, const FVector& End, bool bBlocked);
+
+	/** True if traces should be handed to the sensing subsystem or the async trace system rather than run right away. */
+	bool ShouldDeferTraces() const;
+
+	/** Asynchronous traces we are waiting on, keyed by the UserData passed to AsyncLineTraceByChannel. */
+	TMap<uint32, FPendingSensingTrace> PendingTraces;
+
+	/** Line of sight traces in flight, grouped per target. Keyed by FPendingSensingTrace::SightBatchId. */
+	TMap<uint32, FPendingSightBatch> PendingSightBatches;
+
+	/** Id handed out to the last asynchronous trace. */
+	uint32 LastAsyncTraceId;
+
+	FTraceDelegate AsyncTraceDelegate;
+
+	/** Name our updates show up under in Unreal Insights, the owner's name. Built once rather than every update. */
+	FString TraceScopeName;
+
+	/** Update function called by the USensingSubsystem when this sensor's interval has elapsed. */
+	virtual void OnTimer();
 
 	/** Modify the timer to fire in TimeDelay seconds. A value <= 0 disables the timer. */
 	virtual void SetTimer(const float TimeDelay);
 
+	/** Returns the sensing scheduler of our world, if there is one. */
+	USensingSubsystem* GetSensingSubsystem() const;
+
 	/** Calls SensePawn on any Pawns that we are allowed to sense. */
 	virtual void UpdateAISensing();
 
+	/**
+	 * Radius around the sensor in which UpdateAISensing() looks for pawns when bOnlySensePlayers is false.
+	 * Noises louder than 1.0 made by pawns outside of it are not heard.
+	 */
+	virtual float GetSensingRadius() const;
+
+	/** Scratch array for the candidates gathered from the sensing subsystem's pawn grid. */
+	TArray<APawn*> SensingCandidates;
+
 	AActor* GetSensorActor() const;	// Get the actor used as the actual sensor location is derived from this actor.
 
 public:
@@ -193,6 +681,14 @@ public:
 	UPROPERTY(BlueprintAssignable)
 		FHearNoiseDelegate OnHearNoise;
 
+	/** Delegate to execute when what we perceive of a Pawn changes, see GetPerceptionOf(). Also executed on clients. */
+	UPROPERTY(BlueprintAssignable)
+		FSeePawnDelegate OnTargetPerceptionChanged;
+
+	/** Delegate to execute when the alarm is raised or cleared. Also executed on clients. */
+	UPROPERTY(BlueprintAssignable)
+		FAlarmedDelegate OnAlarmedChanged;
+
 
 protected:
 
@@ -215,6 +711,35 @@ protected:
 	/** Cosine of limits of peripheral vision. Computed from PeripheralVisionAngle. */
 	UPROPERTY()
 		float PeripheralVisionCosine;
+
+	/** Current sensing LOD. Use SetSensingLOD to change the value at runtime. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = AI)
+		ESensingLOD SensingLOD;
+
+private:
+
+	// Scheduling state, owned by the USensingSubsystem which replaces the per-component timer.
+	friend class USensingSubsystem;
+
+	/** World time at which OnTimer() should run next. Only meaningful while bSensingUpdatePending is set. */
+	double NextSensingUpdateTime;
+
+	/** World time at which the pending update was scheduled. Used to report the elapsed interval. */
+	double SensingScheduledTime;
+
+	/** True while an update is scheduled with the sensing subsystem. */
+	bool bSensingUpdatePending;
+
+	/** Called by the sensing subsystem before it fills in the batch cull result for Targets. */
+	void BeginBatchSightResult(const TArray<APawn*>& Targets);
+	void AddBatchSightSurvivor(const APawn* Pawn);
+	void ClearBatchSightResult();
+
+	/** Targets cone culled by the subsystem for the current update, or null if there is no batch result. */
+	const TArray<APawn*>* BatchSightTargets;
+
+	/** Those of BatchSightTargets that are within sight radius and peripheral vision. */
+	TArray<const APawn*, TInlineAllocator<4>> BatchSightSurvivors;
 };
 
 
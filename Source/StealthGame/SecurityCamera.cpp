@@ -2,6 +2,7 @@
 
 
 #include "SecurityCamera.h"
+#include "StealthGame.h"
 #include "Components/SceneCaptureComponent2D.h"
 #include "Components/StaticMeshComponent.h"
 #include "Components/SpotLightComponent.h"
@@ -14,6 +15,9 @@
 
 #define LineOfSight ECC_GameTraceChannel2
 
+DECLARE_CYCLE_STAT(TEXT("Alarm Notify"), STAT_Sensing_AlarmNotify, STATGROUP_Sensing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Alarm Notifications"), STAT_Sensing_AlarmNotifications, STATGROUP_Sensing);
+
 // Sets default values
 ASecurityCamera::ASecurityCamera()
 {
@@ -42,6 +46,9 @@ ASecurityCamera::ASecurityCamera()
  	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
 
+	// So clients get what the camera's sensor perceives.
+	bReplicates = true;
+
 	HasTarget = false;
 }
 
@@ -91,17 +98,20 @@ void ASecurityCamera::Tick(float DeltaTime)
 void ASecurityCamera::SetAlarmState(bool bAlarmState)
 {
 	HasTarget = bAlarmState;
+	PawnSensing->SetAlarmed(HasTarget);
 }
 
 
 void ASecurityCamera::OnPlayerSeen_Implementation() 
 {
 	HasTarget = true;
+	PawnSensing->SetAlarmed(HasTarget);
 }
 
 void ASecurityCamera::OnPlayerUnSeen_Implementation() 
 {
 	HasTarget = false;
+	PawnSensing->SetAlarmed(HasTarget);
 }
 
 void ASecurityCamera::SetCameraAsAlert() 
@@ -135,6 +145,10 @@ void ASecurityCamera::SetCameraAsNotAlert()
 
 void ASecurityCamera::NotifyAlarmObservers()
 {
+	SCOPE_CYCLE_COUNTER(STAT_Sensing_AlarmNotify);
+	TRACE_CPUPROFILER_EVENT_SCOPE(ASecurityCamera::NotifyAlarmObservers);
+	STEALTH_FRAME_COST_SCOPE(Alarms);
+	INC_DWORD_STAT_BY(STAT_Sensing_AlarmNotifications, AlarmObservers.Num());
 
 	for (int i = 0; i < AlarmObservers.Num(); i++) 
 	{
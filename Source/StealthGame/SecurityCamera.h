@@ -141,8 +141,10 @@ protected:
 	UFUNCTION(BlueprintCallable)
 		void SetCameraAsNotAlert();
 	
-	void NotifyAlarmObservers();
 public:	
+	/** Passes HasTarget on to every AlarmObservers entry that implements IAlarmInterface. */
+	void NotifyAlarmObservers();
+
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 	virtual void SetAlarmState(bool bAlarmState) override;
@@ -0,0 +1,484 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SensingBenchmarkGameMode.h"
+#include "StealthGame.h"
+#include "StealthGameCharacter.h"
+#include "SecurityCamera.h"
+#include "LaserComponent.h"
+#include "MovablePawnSensingComponent.h"
+#include "SensingSubsystem.h"
+#include "Engine/World.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Components/StaticMeshComponent.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/Controller.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/App.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "HAL/FileManager.h"
+#include "UObject/ConstructorHelpers.h"
+
+/** /Engine/BasicShapes/Cube is this many units across. */
+static const float WallMeshSize = 100.f;
+
+static const float WallThickness = 20.f;
+
+/** Wanderers that take longer than this to reach their destination are assumed stuck and pick another one. */
+static const float WanderTimeout = 10.f;
+
+static const float WanderArrivalDistance = 100.f;
+
+static float GetFloatOption(const FString& Options, const TCHAR* Key, float DefaultValue)
+{
+	const FString Value = UGameplayStatics::ParseOption(Options, Key);
+	return Value.IsEmpty() ? DefaultValue : FCString::Atof(*Value);
+}
+
+/** Nearest-rank percentile of an ascending array. */
+static float GetPercentile(const TArray<float>& SortedSamples, float Percentile)
+{
+	if (SortedSamples.Num() == 0)
+	{
+		return 0.f;
+	}
+
+	const int32 Rank = FMath::CeilToInt(Percentile * SortedSamples.Num()) - 1;
+	return SortedSamples[FMath::Clamp(Rank, 0, SortedSamples.Num() - 1)];
+}
+
+ASensingBenchmarkGameMode::ASensingBenchmarkGameMode()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	static ConstructorHelpers::FClassFinder<APawn> GuardClassFinder(TEXT("/Game/StealthGame/Blueprints/BP_Guard"));
+	GuardClass = GuardClassFinder.Succeeded() ? GuardClassFinder.Class : TSubclassOf<APawn>(ACharacter::StaticClass());
+
+	static ConstructorHelpers::FObjectFinder<UStaticMesh> WallMeshFinder(TEXT("/Engine/BasicShapes/Cube"));
+	WallMesh = WallMeshFinder.Object;
+
+	BotClass = AStealthGameCharacter::StaticClass();
+	CameraClass = ASecurityCamera::StaticClass();
+	DefaultPawnClass = BotClass;
+
+	RoomSize = 1000.f;
+	DoorwayWidth = 200.f;
+	WallHeight = 300.f;
+	InstancesPerRoom = 4.f;
+	AlarmObserversPerCamera = 4;
+
+	NumGuards = 0;
+	NumCameras = 0;
+	NumLasers = 0;
+	NumBots = 0;
+	Seed = 0;
+	Duration = 0.f;
+	WarmupDuration = 0.f;
+	FixedFrameRate = 30.f;
+	SensingBudget = -1.f;
+	bSenseAllPawns = false;
+	NumRooms = 1;
+	ElapsedTime = 0.f;
+	LastFrameTime = 0.0;
+	bFinished = false;
+}
+
+void ASensingBenchmarkGameMode::InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage)
+{
+	Super::InitGame(MapName, Options, ErrorMessage);
+
+	NumGuards = FMath::Max(UGameplayStatics::GetIntOption(Options, TEXT("Guards"), 100), 0);
+	NumCameras = FMath::Max(UGameplayStatics::GetIntOption(Options, TEXT("Cameras"), 10), 0);
+	NumLasers = FMath::Max(UGameplayStatics::GetIntOption(Options, TEXT("Lasers"), 100), 0);
+	NumBots = FMath::Max(UGameplayStatics::GetIntOption(Options, TEXT("Bots"), 10), 0);
+	Seed = UGameplayStatics::GetIntOption(Options, TEXT("Seed"), 0);
+	Duration = FMath::Max(GetFloatOption(Options, TEXT("Seconds"), 30.f), 1.f);
+	WarmupDuration = FMath::Max(GetFloatOption(Options, TEXT("Warmup"), 2.f), 0.f);
+	FixedFrameRate = FMath::Max(GetFloatOption(Options, TEXT("FPS"), 30.f), 1.f);
+	SensingBudget = GetFloatOption(Options, TEXT("Budget"), -1.f);
+	bSenseAllPawns = UGameplayStatics::GetIntOption(Options, TEXT("SenseAllPawns"), 0) != 0;
+	CsvFileName = UGameplayStatics::ParseOption(Options, TEXT("Csv"));
+	if (CsvFileName.IsEmpty())
+	{
+		CsvFileName = TEXT("SensingBenchmark.csv");
+	}
+
+	const int32 NumInstances = NumGuards + NumCameras + NumLasers + NumBots;
+	NumRooms = FMath::Max(FMath::CeilToInt(FMath::Sqrt(NumInstances / FMath::Max(InstancesPerRoom, 1.f))), 1);
+
+	RandomStream.Initialize(Seed);
+
+	// Step the game by exactly 1 / FPS every frame and run as fast as possible, so simulated time and
+	// everything that depends on it is the same on every run no matter how long the frames really take.
+	FApp::SetBenchmarking(true);
+	FApp::SetFixedDeltaTime(1.0 / FixedFrameRate);
+}
+
+void ASensingBenchmarkGameMode::StartPlay()
+{
+	// Players have logged in by now, so the pawns spawned here find the player in their BeginPlay like they would in a level.
+	UWorld* World = GetWorld();
+	if (USensingSubsystem* SensingSubsystem = World->GetSubsystem<USensingSubsystem>())
+	{
+		SensingSubsystem->SetSensingSeed(Seed);
+		if (SensingBudget >= 0.f)
+		{
+			SensingSubsystem->SetSensingBudget(SensingBudget);
+		}
+	}
+
+	BuildLevel();
+	SpawnGuards();
+	SpawnCameras();
+	SpawnLasers();
+	SpawnBots();
+
+	if (APawn* Player = UGameplayStatics::GetPlayerPawn(World, 0))
+	{
+		Player->TeleportTo(GetRandomFloorLocation() + FVector(0.f, 0.f, 100.f), Player->GetActorRotation());
+		AddWanderer(Player);
+	}
+
+	UE_LOG(LogSensing, Log, TEXT("Sensing benchmark: %d guards, %d cameras, %d lasers, %d bots in %dx%d rooms, seed %d, %.0f seconds at %.0f fps"),
+		NumGuards, NumCameras, NumLasers, NumBots, NumRooms, NumRooms, Seed, Duration, FixedFrameRate);
+
+#if ENABLE_STEALTH_FRAME_COSTS
+	FStealthFrameCosts::Reset();
+	FStealthFrameCosts::bEnabled = true;
+#else
+	UE_LOG(LogSensing, Warning, TEXT("Sensing benchmark: frame costs are compiled out of this build, only whole frames are timed."));
+#endif
+
+	Super::StartPlay();
+}
+
+void ASensingBenchmarkGameMode::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+#if ENABLE_STEALTH_FRAME_COSTS
+	FStealthFrameCosts::bEnabled = false;
+#endif
+	FApp::SetBenchmarking(false);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ASensingBenchmarkGameMode::BuildLevel()
+{
+	const float Extent = NumRooms * RoomSize;
+	const float WallZ = WallHeight * 0.5f;
+
+	SpawnWall(FVector(Extent * 0.5f, Extent * 0.5f, -WallMeshSize * 0.5f), FVector(Extent, Extent, WallMeshSize));
+
+	// Outer walls.
+	SpawnWall(FVector(Extent * 0.5f, 0.f, WallZ), FVector(Extent, WallThickness, WallHeight));
+	SpawnWall(FVector(Extent * 0.5f, Extent, WallZ), FVector(Extent, WallThickness, WallHeight));
+	SpawnWall(FVector(0.f, Extent * 0.5f, WallZ), FVector(WallThickness, Extent, WallHeight));
+	SpawnWall(FVector(Extent, Extent * 0.5f, WallZ), FVector(WallThickness, Extent, WallHeight));
+
+	// One wall between every two neighboring rooms, with a doorway at one end or the other.
+	const float SegmentLength = FMath::Max(RoomSize - DoorwayWidth, 0.f);
+	for (int32 Line = 1; Line < NumRooms; ++Line)
+	{
+		for (int32 Room = 0; Room < NumRooms; ++Room)
+		{
+			const float LineOffset = Line * RoomSize;
+
+			const float XSegmentCenter = Room * RoomSize + (RandomStream.FRand() < 0.5f ? SegmentLength * 0.5f : RoomSize - SegmentLength * 0.5f);
+			SpawnWall(FVector(LineOffset, XSegmentCenter, WallZ), FVector(WallThickness, SegmentLength, WallHeight));
+
+			const float YSegmentCenter = Room * RoomSize + (RandomStream.FRand() < 0.5f ? SegmentLength * 0.5f : RoomSize - SegmentLength * 0.5f);
+			SpawnWall(FVector(YSegmentCenter, LineOffset, WallZ), FVector(SegmentLength, WallThickness, WallHeight));
+		}
+	}
+}
+
+void ASensingBenchmarkGameMode::SpawnWall(const FVector& Center, const FVector& Size)
+{
+	if (WallMesh == nullptr || Size.GetMin() <= 0.f)
+	{
+		return;
+	}
+
+	// Deferred so the mesh can be set while the component is still unregistered, walls stay static like level geometry.
+	const FTransform Transform(FRotator::ZeroRotator, Center, Size / WallMeshSize);
+	AStaticMeshActor* Wall = GetWorld()->SpawnActorDeferred<AStaticMeshActor>(AStaticMeshActor::StaticClass(), Transform);
+	if (Wall != nullptr)
+	{
+		Wall->GetStaticMeshComponent()->SetStaticMesh(WallMesh);
+		Wall->FinishSpawning(Transform);
+	}
+}
+
+void ASensingBenchmarkGameMode::SpawnGuards()
+{
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	for (int32 Index = 0; Index < NumGuards; ++Index)
+	{
+		const FRotator Rotation(0.f, RandomStream.FRandRange(-180.f, 180.f), 0.f);
+		APawn* Guard = GetWorld()->SpawnActor<APawn>(GuardClass, GetRandomFloorLocation() + FVector(0.f, 0.f, 100.f), Rotation, SpawnParams);
+		if (Guard == nullptr)
+		{
+			continue;
+		}
+
+		if (Guard->FindComponentByClass<UMovablePawnSensingComponent>() == nullptr)
+		{
+			UMovablePawnSensingComponent* PawnSensing = NewObject<UMovablePawnSensingComponent>(Guard, TEXT("PawnSensing"));
+			PawnSensing->SetupAttachment(Guard->GetRootComponent());
+			Guard->AddInstanceComponent(PawnSensing);
+			PawnSensing->RegisterComponent();
+		}
+		ConfigureSensor(Guard);
+
+		if (Guard->GetController() == nullptr)
+		{
+			Guard->SpawnDefaultController();
+		}
+		AddWanderer(Guard);
+	}
+}
+
+void ASensingBenchmarkGameMode::SpawnCameras()
+{
+	TArray<ASecurityCamera*> Cameras;
+	Cameras.Reserve(NumCameras);
+
+	for (int32 Index = 0; Index < NumCameras; ++Index)
+	{
+		const FVector Location = GetRandomFloorLocation() + FVector(0.f, 0.f, WallHeight - 50.f);
+		const FRotator Rotation(-30.f, RandomStream.FRandRange(-180.f, 180.f), 0.f);
+		if (ASecurityCamera* Camera = GetWorld()->SpawnActor<ASecurityCamera>(CameraClass, Location, Rotation))
+		{
+			ConfigureSensor(Camera);
+			Cameras.Add(Camera);
+		}
+	}
+
+	CameraAlarms.Reserve(Cameras.Num());
+	for (ASecurityCamera* Camera : Cameras)
+	{
+		for (int32 Index = 0; Index < AlarmObserversPerCamera && Cameras.Num() > 1; ++Index)
+		{
+			ASecurityCamera* Observer = Cameras[RandomStream.RandHelper(Cameras.Num())];
+			if (Observer != Camera)
+			{
+				Camera->AlarmObservers.AddUnique(Observer);
+			}
+		}
+
+		CameraAlarms.Add({ Camera, Camera->HasTarget });
+	}
+}
+
+void ASensingBenchmarkGameMode::SpawnLasers()
+{
+	for (int32 Index = 0; Index < NumLasers; ++Index)
+	{
+		const FTransform Transform(FRotator(0.f, RandomStream.FRandRange(-180.f, 180.f), 0.f),
+			GetRandomFloorLocation() + FVector(0.f, 0.f, RandomStream.FRandRange(20.f, 150.f)));
+
+		// Deferred so the laser and its Niagara components are registered together with the actor.
+		AActor* LaserActor = GetWorld()->SpawnActorDeferred<AActor>(AActor::StaticClass(), Transform);
+		if (LaserActor == nullptr)
+		{
+			continue;
+		}
+
+		ULaserComponent* Laser = NewObject<ULaserComponent>(LaserActor, TEXT("Laser"));
+		LaserActor->SetRootComponent(Laser);
+		LaserActor->AddInstanceComponent(Laser);
+		LaserActor->FinishSpawning(Transform);
+	}
+}
+
+void ASensingBenchmarkGameMode::SpawnBots()
+{
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	for (int32 Index = 0; Index < NumBots; ++Index)
+	{
+		ACharacter* Bot = GetWorld()->SpawnActor<ACharacter>(BotClass, GetRandomFloorLocation() + FVector(0.f, 0.f, 100.f), FRotator::ZeroRotator, SpawnParams);
+		if (Bot == nullptr)
+		{
+			continue;
+		}
+
+		if (Bot->GetController() == nullptr)
+		{
+			Bot->SpawnDefaultController();
+		}
+		AddWanderer(Bot);
+	}
+}
+
+void ASensingBenchmarkGameMode::ConfigureSensor(AActor* Actor) const
+{
+	if (UMovablePawnSensingComponent* PawnSensing = Actor->FindComponentByClass<UMovablePawnSensingComponent>())
+	{
+		PawnSensing->bOnlySensePlayers = !bSenseAllPawns;
+	}
+}
+
+FVector ASensingBenchmarkGameMode::GetRandomFloorLocation()
+{
+	const float Margin = 0.1f;
+	return FVector(
+		(RandomStream.RandHelper(NumRooms) + RandomStream.FRandRange(Margin, 1.f - Margin)) * RoomSize,
+		(RandomStream.RandHelper(NumRooms) + RandomStream.FRandRange(Margin, 1.f - Margin)) * RoomSize,
+		0.f);
+}
+
+FVector ASensingBenchmarkGameMode::GetWanderDestination(const FVector& From)
+{
+	const float Extent = NumRooms * RoomSize;
+	const float Angle = RandomStream.FRandRange(0.f, 2.f * PI);
+	const FVector2D Offset = FVector2D(FMath::Cos(Angle), FMath::Sin(Angle)) * RandomStream.FRandRange(0.5f, 1.5f) * RoomSize;
+
+	return FVector(
+		FMath::Clamp(From.X + Offset.X, WallThickness, Extent - WallThickness),
+		FMath::Clamp(From.Y + Offset.Y, WallThickness, Extent - WallThickness),
+		From.Z);
+}
+
+void ASensingBenchmarkGameMode::AddWanderer(APawn* Pawn)
+{
+	Wanderers.Add({ Pawn, GetWanderDestination(Pawn->GetActorLocation()), WanderTimeout });
+}
+
+void ASensingBenchmarkGameMode::UpdateWanderers(float DeltaSeconds)
+{
+	for (FWanderer& Wanderer : Wanderers)
+	{
+		APawn* Pawn = Wanderer.Pawn.Get();
+		if (Pawn == nullptr)
+		{
+			continue;
+		}
+
+		const FVector Location = Pawn->GetActorLocation();
+		const FVector ToDestination = FVector(Wanderer.Destination.X - Location.X, Wanderer.Destination.Y - Location.Y, 0.f);
+
+		Wanderer.TimeLeft -= DeltaSeconds;
+		if (Wanderer.TimeLeft <= 0.f || ToDestination.SizeSquared() < FMath::Square(WanderArrivalDistance))
+		{
+			Wanderer.Destination = GetWanderDestination(Location);
+			Wanderer.TimeLeft = WanderTimeout;
+			continue;
+		}
+
+		const FVector Direction = ToDestination.GetSafeNormal();
+		if (AController* Controller = Pawn->GetController())
+		{
+			// Pawns face their control rotation, and the sensors look where the pawn faces.
+			Controller->SetControlRotation(Direction.Rotation());
+		}
+		Pawn->AddMovementInput(Direction);
+	}
+}
+
+void ASensingBenchmarkGameMode::UpdateAlarms()
+{
+	for (FCameraAlarm& CameraAlarm : CameraAlarms)
+	{
+		ASecurityCamera* Camera = CameraAlarm.Camera.Get();
+		if (Camera != nullptr && Camera->HasTarget != CameraAlarm.bHadTarget)
+		{
+			CameraAlarm.bHadTarget = Camera->HasTarget;
+			Camera->NotifyAlarmObservers();
+		}
+	}
+}
+
+void ASensingBenchmarkGameMode::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (bFinished)
+	{
+		return;
+	}
+
+	// The game mode ticks before the lasers and after last frame's sensing, so every sample covers exactly one frame of each.
+	const double Now = FPlatformTime::Seconds();
+	ElapsedTime += DeltaSeconds;
+	if (ElapsedTime > WarmupDuration && LastFrameTime > 0.0)
+	{
+		FrameMs.Add((float)((Now - LastFrameTime) * 1000.0));
+#if ENABLE_STEALTH_FRAME_COSTS
+		SensingMs.Add((float)(FStealthFrameCosts::Seconds[(int32)EStealthFrameCost::Sensing] * 1000.0));
+		LaserMs.Add((float)(FStealthFrameCosts::Seconds[(int32)EStealthFrameCost::Lasers] * 1000.0));
+		AlarmMs.Add((float)(FStealthFrameCosts::Seconds[(int32)EStealthFrameCost::Alarms] * 1000.0));
+#endif
+	}
+	LastFrameTime = Now;
+#if ENABLE_STEALTH_FRAME_COSTS
+	FStealthFrameCosts::Reset();
+#endif
+
+	UpdateWanderers(DeltaSeconds);
+	UpdateAlarms();
+
+	if (ElapsedTime >= WarmupDuration + Duration)
+	{
+		bFinished = true;
+		WriteResults();
+		FPlatformMisc::RequestExit(false);
+	}
+}
+
+void ASensingBenchmarkGameMode::WriteResults() const
+{
+	const FString Path = FPaths::ProjectSavedDir() / TEXT("Benchmarks") / CsvFileName;
+
+	FString Csv;
+	if (!IFileManager::Get().FileExists(*Path))
+	{
+		Csv += TEXT("Part,Guards,Cameras,Lasers,Bots,Rooms,Seed,FPS,Frames,MeanMs,P50Ms,P90Ms,P99Ms,MaxMs\n");
+	}
+
+	auto AppendRow = [this, &Csv](const TCHAR* Part, TArray<float> Samples)
+	{
+		if (Samples.Num() == 0)
+		{
+			return;
+		}
+
+		Samples.Sort();
+
+		double Total = 0.0;
+		for (const float Sample : Samples)
+		{
+			Total += Sample;
+		}
+
+		const float Mean = (float)(Total / Samples.Num());
+		const float P50 = GetPercentile(Samples, 0.5f);
+		const float P90 = GetPercentile(Samples, 0.9f);
+		const float P99 = GetPercentile(Samples, 0.99f);
+		const float Max = Samples.Last();
+
+		Csv += FString::Printf(TEXT("%s,%d,%d,%d,%d,%d,%d,%.0f,%d,%.4f,%.4f,%.4f,%.4f,%.4f\n"),
+			Part, NumGuards, NumCameras, NumLasers, NumBots, NumRooms * NumRooms, Seed, FixedFrameRate, Samples.Num(), Mean, P50, P90, P99, Max);
+
+		UE_LOG(LogSensing, Display, TEXT("Sensing benchmark %s: mean %.3f ms, p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms"), Part, Mean, P50, P90, P99, Max);
+	};
+
+	AppendRow(TEXT("Frame"), FrameMs);
+	AppendRow(TEXT("Sensing"), SensingMs);
+	AppendRow(TEXT("Lasers"), LaserMs);
+	AppendRow(TEXT("Alarms"), AlarmMs);
+
+	if (FFileHelper::SaveStringToFile(Csv, *Path, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM, &IFileManager::Get(), FILEWRITE_Append))
+	{
+		UE_LOG(LogSensing, Display, TEXT("Sensing benchmark results written to %s"), *Path);
+	}
+	else
+	{
+		UE_LOG(LogSensing, Error, TEXT("Sensing benchmark could not write %s"), *Path);
+	}
+}
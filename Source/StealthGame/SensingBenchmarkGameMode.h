@@ -0,0 +1,156 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/GameModeBase.h"
+#include "SensingBenchmarkGameMode.generated.h"
+
+class ACharacter;
+class ASecurityCamera;
+
+/**
+ * Headless scalability benchmark of sensing, lasers and alarms. Builds a walled grid level, fills it with the requested
+ * number of guards, security cameras, lasers and wandering bots, runs for a fixed number of seconds at a fixed timestep,
+ * then appends the per-frame game thread cost percentiles of each part of the game to a CSV file and quits.
+ *
+ * Everything is driven from the URL options, and the layout and bot paths only depend on Seed, so runs are reproducible:
+ *
+ *   UE4Editor StealthGame /Engine/Maps/Entry?game=/Script/StealthGame.SensingBenchmarkGameMode?Guards=1000?Cameras=100?Lasers=1000?Bots=100
+ *       -game -nullrhi -nosound -unattended
+ *
+ * Options: Guards, Cameras, Lasers, Bots, Seed, Seconds, Warmup, FPS, Budget (sensing budget in microseconds, 0 for none),
+ * SenseAllPawns (guards and cameras sense the bots, not only the player) and Csv (file name in Saved/Benchmarks, rows are appended
+ * so a sweep of runs ends up in one file).
+ */
+UCLASS(config = Game)
+class STEALTHGAME_API ASensingBenchmarkGameMode : public AGameModeBase
+{
+	GENERATED_BODY()
+
+public:
+	ASensingBenchmarkGameMode();
+
+	//~ Begin AGameModeBase Interface.
+	virtual void InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) override;
+	virtual void StartPlay() override;
+	//~ End AGameModeBase Interface.
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	virtual void Tick(float DeltaSeconds) override;
+
+protected:
+	/** Pawn spawned for each guard. Gets a UMovablePawnSensingComponent if it doesn't have one. */
+	UPROPERTY(EditDefaultsOnly, Category = Benchmark)
+		TSubclassOf<APawn> GuardClass;
+
+	/** Pawn spawned for each bot, and for the player. */
+	UPROPERTY(EditDefaultsOnly, Category = Benchmark)
+		TSubclassOf<ACharacter> BotClass;
+
+	UPROPERTY(EditDefaultsOnly, Category = Benchmark)
+		TSubclassOf<ASecurityCamera> CameraClass;
+
+	/** Mesh stretched into the floor and walls. */
+	UPROPERTY(EditDefaultsOnly, Category = Benchmark)
+		class UStaticMesh* WallMesh;
+
+	/** Size of the square rooms of the grid. */
+	UPROPERTY(config, EditDefaultsOnly, Category = Benchmark)
+		float RoomSize;
+
+	/** Width of the doorway left in every wall between two rooms. */
+	UPROPERTY(config, EditDefaultsOnly, Category = Benchmark)
+		float DoorwayWidth;
+
+	UPROPERTY(config, EditDefaultsOnly, Category = Benchmark)
+		float WallHeight;
+
+	/** Number of guards, cameras, lasers and bots per room. Sets how many rooms the grid has. */
+	UPROPERTY(config, EditDefaultsOnly, Category = Benchmark)
+		float InstancesPerRoom;
+
+	/** Number of random cameras each camera passes its alarm state on to. */
+	UPROPERTY(config, EditDefaultsOnly, Category = Benchmark)
+		int32 AlarmObserversPerCamera;
+
+private:
+	/** Spawns the floor and the walls of a NumRooms x NumRooms grid. */
+	void BuildLevel();
+
+	void SpawnWall(const FVector& Center, const FVector& Size);
+
+	void SpawnGuards();
+	void SpawnCameras();
+	void SpawnLasers();
+	void SpawnBots();
+
+	/** Random location on the floor of a random room. */
+	FVector GetRandomFloorLocation();
+
+	/** Random location on the floor about a room away from From. */
+	FVector GetWanderDestination(const FVector& From);
+
+	/** Starts wandering Pawn around the grid, it needs a controller to move. */
+	void AddWanderer(APawn* Pawn);
+
+	/** Applies the SenseAllPawns option to the sensing component of Actor, if any. */
+	void ConfigureSensor(AActor* Actor) const;
+
+	/** Steers every wandering pawn towards its destination, picking a new one when it gets there or gets stuck. */
+	void UpdateWanderers(float DeltaSeconds);
+
+	/** Passes the alarm state of every camera that gained or lost its target this frame on to its observers. */
+	void UpdateAlarms();
+
+	/** Appends the percentiles of the recorded frames to the CSV file. */
+	void WriteResults() const;
+
+	int32 NumGuards;
+	int32 NumCameras;
+	int32 NumLasers;
+	int32 NumBots;
+	int32 Seed;
+	float Duration;
+	float WarmupDuration;
+	float FixedFrameRate;
+	float SensingBudget;
+	bool bSenseAllPawns;
+	FString CsvFileName;
+
+	int32 NumRooms;
+
+	FRandomStream RandomStream;
+
+	struct FWanderer
+	{
+		TWeakObjectPtr<APawn> Pawn;
+		FVector Destination;
+		float TimeLeft;
+	};
+
+	TArray<FWanderer> Wanderers;
+
+	struct FCameraAlarm
+	{
+		TWeakObjectPtr<ASecurityCamera> Camera;
+		bool bHadTarget;
+	};
+
+	TArray<FCameraAlarm> CameraAlarms;
+
+	/** Game time since StartPlay(). */
+	float ElapsedTime;
+
+	/** Wall clock time of the previous Tick(). */
+	double LastFrameTime;
+
+	// Milliseconds per recorded frame, for the whole frame and each EStealthFrameCost.
+	TArray<float> FrameMs;
+	TArray<float> SensingMs;
+	TArray<float> LaserMs;
+	TArray<float> AlarmMs;
+
+	bool bFinished;
+};
@@ -0,0 +1,140 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SensingCulling.h"
+#include "Math/VectorRegister.h"
+
+// Coordinate used to pad the target arrays. Far enough to fail any sight radius, small enough not to overflow when squared.
+#define SENSINGCULL_UNREACHABLE 1.0e15f
+
+void FSensingCullSensors::Reset()
+{
+	LocationX.Reset();
+	LocationY.Reset();
+	LocationZ.Reset();
+	FacingX.Reset();
+	FacingY.Reset();
+	FacingZ.Reset();
+	SightRadiusSquared.Reset();
+	PeripheralVisionCosine.Reset();
+	DarkSightRadiusScale.Reset();
+}
+
+int32 FSensingCullSensors::Add(const FVector& Location, const FVector& Facing, float SightRadius, float InPeripheralVisionCosine, float InDarkSightRadiusScale)
+{
+	LocationX.Add(Location.X);
+	LocationY.Add(Location.Y);
+	LocationZ.Add(Location.Z);
+	FacingX.Add(Facing.X);
+	FacingY.Add(Facing.Y);
+	FacingZ.Add(Facing.Z);
+	SightRadiusSquared.Add(FMath::Square(SightRadius));
+	DarkSightRadiusScale.Add(InDarkSightRadiusScale);
+	return PeripheralVisionCosine.Add(InPeripheralVisionCosine);
+}
+
+void FSensingCullTargets::Reset()
+{
+	LocationX.Reset();
+	LocationY.Reset();
+	LocationZ.Reset();
+	Illumination.Reset();
+	NumTargets = 0;
+}
+
+int32 FSensingCullTargets::Add(const FVector& Location, float InIllumination)
+{
+	// Drop any padding left over from a previous Finalize().
+	LocationX.SetNum(NumTargets, false);
+	LocationY.SetNum(NumTargets, false);
+	LocationZ.SetNum(NumTargets, false);
+	Illumination.SetNum(NumTargets, false);
+
+	LocationX.Add(Location.X);
+	LocationY.Add(Location.Y);
+	LocationZ.Add(Location.Z);
+	Illumination.Add(InIllumination);
+	return NumTargets++;
+}
+
+void FSensingCullTargets::Finalize()
+{
+	const int32 PaddedNum = Align(NumTargets, 4);
+	while (LocationX.Num() < PaddedNum)
+	{
+		LocationX.Add(SENSINGCULL_UNREACHABLE);
+		LocationY.Add(SENSINGCULL_UNREACHABLE);
+		LocationZ.Add(SENSINGCULL_UNREACHABLE);
+		Illumination.Add(0.f);
+	}
+}
+
+void SensingCulling::CullSightPairs(const FSensingCullSensors& Sensors, const FSensingCullTargets& Targets, TArray<FSensingCullPair>& OutSurvivors)
+{
+	const int32 NumTargets = Targets.Num();
+	const int32 PaddedNumTargets = Targets.LocationX.Num();
+	check(PaddedNumTargets % 4 == 0 && PaddedNumTargets >= NumTargets);
+
+	const float* RESTRICT TargetX = Targets.LocationX.GetData();
+	const float* RESTRICT TargetY = Targets.LocationY.GetData();
+	const float* RESTRICT TargetZ = Targets.LocationZ.GetData();
+	const float* RESTRICT TargetIllumination = Targets.Illumination.GetData();
+
+	// Same tolerance as the FVector::GetSafeNormal() call of CouldSeePawn().
+	const VectorRegister AtSensorDistSquared = VectorSetFloat1(SMALL_NUMBER);
+
+	for (int32 SensorIndex = 0; SensorIndex < Sensors.Num(); ++SensorIndex)
+	{
+		const VectorRegister SensorX = VectorSetFloat1(Sensors.LocationX[SensorIndex]);
+		const VectorRegister SensorY = VectorSetFloat1(Sensors.LocationY[SensorIndex]);
+		const VectorRegister SensorZ = VectorSetFloat1(Sensors.LocationZ[SensorIndex]);
+		const VectorRegister FacingX = VectorSetFloat1(Sensors.FacingX[SensorIndex]);
+		const VectorRegister FacingY = VectorSetFloat1(Sensors.FacingY[SensorIndex]);
+		const VectorRegister FacingZ = VectorSetFloat1(Sensors.FacingZ[SensorIndex]);
+		const VectorRegister RadiusSquared = VectorSetFloat1(Sensors.SightRadiusSquared[SensorIndex]);
+		const VectorRegister DarkScale = VectorSetFloat1(Sensors.DarkSightRadiusScale[SensorIndex]);
+		const VectorRegister LitScale = VectorSetFloat1(1.f - Sensors.DarkSightRadiusScale[SensorIndex]);
+
+		// Keep the sign of the cosine so cones wider than 90 degrees still work without a square root.
+		const float Cosine = Sensors.PeripheralVisionCosine[SensorIndex];
+		const VectorRegister SignedCosineSquared = VectorSetFloat1(Cosine * FMath::Abs(Cosine));
+
+		// A target on top of the sensor has no direction. CouldSeePawn() then dots a zero vector, which only passes cones of 90 degrees or more.
+		const VectorRegister InConeAtSensor = VectorCompareGE(VectorZero(), VectorSetFloat1(Cosine));
+
+		for (int32 TargetIndex = 0; TargetIndex < PaddedNumTargets; TargetIndex += 4)
+		{
+			const VectorRegister ToTargetX = VectorSubtract(VectorLoadAligned(TargetX + TargetIndex), SensorX);
+			const VectorRegister ToTargetY = VectorSubtract(VectorLoadAligned(TargetY + TargetIndex), SensorY);
+			const VectorRegister ToTargetZ = VectorSubtract(VectorLoadAligned(TargetZ + TargetIndex), SensorZ);
+
+			// check max sight distance
+			VectorRegister DistSquared = VectorMultiply(ToTargetX, ToTargetX);
+			DistSquared = VectorMultiplyAdd(ToTargetY, ToTargetY, DistSquared);
+			DistSquared = VectorMultiplyAdd(ToTargetZ, ToTargetZ, DistSquared);
+			const VectorRegister RadiusScale = VectorMultiplyAdd(LitScale, VectorLoadAligned(TargetIllumination + TargetIndex), DarkScale);
+			const VectorRegister InRange = VectorCompareLE(DistSquared, VectorMultiply(RadiusSquared, VectorMultiply(RadiusScale, RadiusScale)));
+
+			// check field of view
+			VectorRegister Dot = VectorMultiply(ToTargetX, FacingX);
+			Dot = VectorMultiplyAdd(ToTargetY, FacingY, Dot);
+			Dot = VectorMultiplyAdd(ToTargetZ, FacingZ, Dot);
+			const VectorRegister SignedDotSquared = VectorMultiply(Dot, VectorAbs(Dot));
+			const VectorRegister AtSensor = VectorCompareLT(DistSquared, AtSensorDistSquared);
+			const VectorRegister InCone = VectorSelect(AtSensor, InConeAtSensor, VectorCompareGE(SignedDotSquared, VectorMultiply(SignedCosineSquared, DistSquared)));
+
+			int32 Mask = VectorMaskBits(VectorBitwiseAnd(InRange, InCone));
+			while (Mask != 0)
+			{
+				const int32 Lane = (int32)FMath::CountTrailingZeros((uint32)Mask);
+				Mask &= Mask - 1;
+
+				const int32 SurvivorIndex = TargetIndex + Lane;
+				if (SurvivorIndex < NumTargets)
+				{
+					OutSurvivors.Add({ SensorIndex, SurvivorIndex });
+				}
+			}
+		}
+	}
+}
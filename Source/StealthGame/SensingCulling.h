@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Structure-of-arrays copy of the sensors taking part in a batch sight cull.
+ * Facing directions must be normalized. Every array has one entry per sensor.
+ */
+struct STEALTHGAME_API FSensingCullSensors
+{
+	TArray<float> LocationX;
+	TArray<float> LocationY;
+	TArray<float> LocationZ;
+	TArray<float> FacingX;
+	TArray<float> FacingY;
+	TArray<float> FacingZ;
+	TArray<float> SightRadiusSquared;
+	TArray<float> PeripheralVisionCosine;
+	TArray<float> DarkSightRadiusScale;
+
+	void Reset();
+
+	/** Appends a sensor and returns its index. A DarkSightRadiusScale of 1 ignores the targets' illumination. */
+	int32 Add(const FVector& Location, const FVector& Facing, float SightRadius, float InPeripheralVisionCosine, float InDarkSightRadiusScale = 1.f);
+
+	int32 Num() const { return LocationX.Num(); }
+};
+
+/**
+ * Structure-of-arrays copy of the targets taking part in a batch sight cull.
+ * The arrays are padded to a multiple of four with unreachable targets so the kernel can always load whole registers.
+ */
+struct STEALTHGAME_API FSensingCullTargets
+{
+	TArray<float, TAlignedHeapAllocator<16>> LocationX;
+	TArray<float, TAlignedHeapAllocator<16>> LocationY;
+	TArray<float, TAlignedHeapAllocator<16>> LocationZ;
+
+	/** Light level at each target, from 0 to 1, see USensingSubsystem::GetIllumination(). */
+	TArray<float, TAlignedHeapAllocator<16>> Illumination;
+
+	void Reset();
+
+	/** Appends a target and returns its index. Call Finalize() once every target has been added. */
+	int32 Add(const FVector& Location, float InIllumination = 1.f);
+
+	/** Pads the arrays up to a whole number of vector registers. */
+	void Finalize();
+
+	int32 Num() const { return NumTargets; }
+
+private:
+	int32 NumTargets = 0;
+};
+
+/** A sensor/target pair that survived the batch cull and still needs a line of sight trace. */
+struct FSensingCullPair
+{
+	int32 SensorIndex;
+	int32 TargetIndex;
+};
+
+namespace SensingCulling
+{
+	/**
+	 * Runs the distance and peripheral vision tests of UMovablePawnSensingComponent::CouldSeePawn() for every
+	 * sensor/target pair, four targets per vector instruction, and appends the pairs that pass to OutSurvivors.
+	 * Each sight radius is scaled from the sensor's DarkSightRadiusScale up to 1 by the target's illumination.
+	 * The cone test is done without square roots: dot * |dot| >= cos * |cos| * distSq is the same as
+	 * dot / dist >= cos, for either sign of the cosine.
+	 */
+	STEALTHGAME_API void CullSightPairs(const FSensingCullSensors& Sensors, const FSensingCullTargets& Targets, TArray<FSensingCullPair>& OutSurvivors);
+}
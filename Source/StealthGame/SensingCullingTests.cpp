@@ -0,0 +1,152 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "MovablePawnSensingComponent.h"
+#include "SecurityCamera.h"
+#include "SensingCulling.h"
+#include "SensingSubsystem.h"
+#include "SensingTestWorld.h"
+
+/**
+ * Runs random sensor/target sets through SensingCulling::CullSightPairs() and UMovablePawnSensingComponent::CouldSeePawn(),
+ * and requires both to agree on every pair. Pairs within float rounding of the sight radius or of the cone edge may go
+ * either way and are skipped. Targets placed exactly on a sensor are always included.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSensingBatchCullMatchesCouldSeePawnTest, "StealthGame.Sensing.BatchCullMatchesCouldSeePawn",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FSensingBatchCullMatchesCouldSeePawnTest::RunTest(const FString& Parameters)
+{
+	FSensingTestWorld TestWorld;
+	FRandomStream RandomStream(0);
+	const float AreaSize = 2000.f;
+	const int32 NumSensors = 32;
+	const int32 NumTargets = 64;
+
+	TArray<UMovablePawnSensingComponent*> Sensors;
+	for (int32 Index = 0; Index < NumSensors; ++Index)
+	{
+		const FTransform Transform(FRotator(RandomStream.FRandRange(-60.f, 60.f), RandomStream.FRandRange(-180.f, 180.f), 0.f),
+			FVector(RandomStream.FRandRange(0.f, AreaSize), RandomStream.FRandRange(0.f, AreaSize), RandomStream.FRandRange(0.f, 300.f)));
+		const float SightRadius = RandomStream.FRandRange(200.f, AreaSize);
+
+		// Cover narrow cones as well as cones wider than 90 degrees, whose cosine is negative.
+		const float PeripheralVisionAngle = RandomStream.FRandRange(5.f, 175.f);
+		Sensors.Add(TestWorld.SpawnComponentActor<UMovablePawnSensingComponent>(Transform, [SightRadius, PeripheralVisionAngle](UMovablePawnSensingComponent* PawnSensing)
+		{
+			PawnSensing->SightRadius = SightRadius;
+			PawnSensing->bUseIllumination = false;
+			PawnSensing->SetPeripheralVisionAngle(PeripheralVisionAngle);
+		}));
+	}
+
+	TArray<ACharacter*> Targets;
+	for (int32 Index = 0; Index < NumTargets; ++Index)
+	{
+		Targets.Add(TestWorld.SpawnCharacter(FVector(RandomStream.FRandRange(0.f, AreaSize), RandomStream.FRandRange(0.f, AreaSize), RandomStream.FRandRange(0.f, 300.f))));
+	}
+	for (int32 Index = 0; Index < NumSensors; Index += 4)
+	{
+		Targets.Add(TestWorld.SpawnCharacter(Sensors[Index]->GetSensorLocation()));
+	}
+
+	FSensingCullSensors CullSensors;
+	for (UMovablePawnSensingComponent* Sensor : Sensors)
+	{
+		CullSensors.Add(Sensor->GetSensorLocation(), Sensor->GetSensorRotation().GetSafeNormal(), Sensor->SightRadius, Sensor->GetPeripheralVisionCosine(), Sensor->GetDarkSightRadiusScale());
+	}
+
+	FSensingCullTargets CullTargets;
+	for (const ACharacter* Target : Targets)
+	{
+		CullTargets.Add(Target->GetActorLocation());
+	}
+	CullTargets.Finalize();
+
+	TArray<FSensingCullPair> Survivors;
+	SensingCulling::CullSightPairs(CullSensors, CullTargets, Survivors);
+
+	TSet<TPair<int32, int32>> SurvivorSet;
+	for (const FSensingCullPair& Pair : Survivors)
+	{
+		SurvivorSet.Add(TPair<int32, int32>(Pair.SensorIndex, Pair.TargetIndex));
+	}
+
+	int32 NumCompared = 0;
+	for (int32 SensorIndex = 0; SensorIndex < Sensors.Num(); ++SensorIndex)
+	{
+		UMovablePawnSensingComponent* Sensor = Sensors[SensorIndex];
+		for (int32 TargetIndex = 0; TargetIndex < Targets.Num(); ++TargetIndex)
+		{
+			const FVector SelfToOther = Targets[TargetIndex]->GetActorLocation() - Sensor->GetSensorLocation();
+			const float RadiusMargin = FMath::Abs(SelfToOther.SizeSquared() - FMath::Square(Sensor->SightRadius));
+			const float ConeMargin = FMath::Abs((SelfToOther.GetSafeNormal() | Sensor->GetSensorRotation().GetSafeNormal()) - Sensor->GetPeripheralVisionCosine());
+			if (!SelfToOther.IsNearlyZero(0.f) && (RadiusMargin < 1.f || ConeMargin < KINDA_SMALL_NUMBER))
+			{
+				continue;
+			}
+
+			const bool bExpected = Sensor->CouldSeePawn(Targets[TargetIndex]);
+			const bool bCulledIn = SurvivorSet.Contains(TPair<int32, int32>(SensorIndex, TargetIndex));
+			TestEqual(FString::Printf(TEXT("Sensor %d, target %d"), SensorIndex, TargetIndex), bCulledIn, bExpected);
+			++NumCompared;
+		}
+	}
+
+	TestTrue(TEXT("Most pairs are compared"), NumCompared > Sensors.Num() * Targets.Num() * 9 / 10);
+	return true;
+}
+
+/**
+ * Walks a pawn out of a security camera's view and back in. Culled pawns are never traced, so losing them must not
+ * depend on a failed line of sight check.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSensingLosesSightOutsideViewTest, "StealthGame.Sensing.LosesSightOutsideView",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FSensingLosesSightOutsideViewTest::RunTest(const FString& Parameters)
+{
+	FSensingTestWorld TestWorld;
+	UWorld* World = TestWorld.Get();
+	USensingSubsystem* SensingSubsystem = World->GetSubsystem<USensingSubsystem>();
+	SensingSubsystem->SetSensingSeed(0);
+	SensingSubsystem->SetSensingBudget(0.f);
+
+	// The camera binds its sensing delegates in BeginPlay, without them the sensor has nothing to sense for.
+	ASecurityCamera* Camera = World->SpawnActor<ASecurityCamera>(FVector(0.f, 0.f, 100.f), FRotator::ZeroRotator);
+	Camera->DispatchBeginPlay();
+	UMovablePawnSensingComponent* PawnSensing = Camera->FindComponentByClass<UMovablePawnSensingComponent>();
+	PawnSensing->bOnlySensePlayers = false;
+	PawnSensing->bUseSignificanceLOD = false;
+	PawnSensing->bUseIllumination = false;
+	PawnSensing->SetSensingInterval(0.1f);
+
+	ACharacter* Target = TestWorld.SpawnCharacter(FVector(500.f, 0.f, 100.f));
+	const auto RunSensing = [&TestWorld, SensingSubsystem]()
+	{
+		for (int32 Frame = 0; Frame < 5; ++Frame)
+		{
+			TestWorld.Step(0.1f);
+			SensingSubsystem->Tick(0.1f);
+		}
+	};
+
+	RunSensing();
+	TestEqual(TEXT("Seen in front of the camera"), PawnSensing->IsSeeingPawn(Target), true);
+
+	Target->SetActorLocation(FVector(-500.f, 0.f, 100.f));
+	RunSensing();
+	TestEqual(TEXT("Unseen behind the camera"), PawnSensing->IsSeeingPawn(Target), false);
+
+	Target->SetActorLocation(FVector(500.f, 0.f, 100.f));
+	RunSensing();
+	TestEqual(TEXT("Seen again in front of the camera"), PawnSensing->IsSeeingPawn(Target), true);
+	return true;
+}
+
+#endif
@@ -0,0 +1,149 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SensingIlluminationData.h"
+
+USensingIlluminationData::USensingIlluminationData()
+{
+	Origin = FVector::ZeroVector;
+	CellSize = 100.f;
+	NumBricks = FIntVector::ZeroValue;
+}
+
+bool USensingIlluminationData::GetIllumination(const FVector& Location, float& OutIllumination) const
+{
+	if (!IsBaked())
+	{
+		return false;
+	}
+
+	const FVector Local = (Location - Origin) / CellSize;
+	const int32 CellX = FMath::FloorToInt(Local.X);
+	const int32 CellY = FMath::FloorToInt(Local.Y);
+	const int32 CellZ = FMath::FloorToInt(Local.Z);
+	if (CellX < 0 || CellY < 0 || CellZ < 0
+		|| CellX >= NumBricks.X * BrickCells || CellY >= NumBricks.Y * BrickCells || CellZ >= NumBricks.Z * BrickCells)
+	{
+		return false;
+	}
+
+	const int32 Brick = ((CellZ / BrickCells) * NumBricks.Y + CellY / BrickCells) * NumBricks.X + CellX / BrickCells;
+	const int32 Entry = Bricks[Brick];
+	if (Entry < 0)
+	{
+		OutIllumination = (-1 - Entry) / 255.f;
+		return true;
+	}
+
+	// The eight points around the cell, all within the brick.
+	const uint8* Levels = BrickLevels.GetData() + Entry + ((CellZ % BrickCells) * BrickPoints + CellY % BrickCells) * BrickPoints + CellX % BrickCells;
+	const int32 StepY = BrickPoints;
+	const int32 StepZ = BrickPoints * BrickPoints;
+
+	const float FracX = Local.X - CellX;
+	const float FracY = Local.Y - CellY;
+	const float FracZ = Local.Z - CellZ;
+	const float Y0Z0 = FMath::Lerp<float>(Levels[0], Levels[1], FracX);
+	const float Y1Z0 = FMath::Lerp<float>(Levels[StepY], Levels[StepY + 1], FracX);
+	const float Y0Z1 = FMath::Lerp<float>(Levels[StepZ], Levels[StepZ + 1], FracX);
+	const float Y1Z1 = FMath::Lerp<float>(Levels[StepZ + StepY], Levels[StepZ + StepY + 1], FracX);
+	OutIllumination = FMath::Lerp(FMath::Lerp(Y0Z0, Y1Z0, FracY), FMath::Lerp(Y0Z1, Y1Z1, FracY), FracZ) / 255.f;
+	return true;
+}
+
+#if WITH_EDITOR
+FIntVector USensingIlluminationData::GetNumPointsFor(const FBox& Bounds, float InCellSize)
+{
+	const float BrickSize = FMath::Max(InCellSize, 1.f) * BrickCells;
+	const FVector Size = Bounds.GetSize();
+	const FIntVector Bricks(
+		FMath::Max(FMath::CeilToInt(Size.X / BrickSize), 1),
+		FMath::Max(FMath::CeilToInt(Size.Y / BrickSize), 1),
+		FMath::Max(FMath::CeilToInt(Size.Z / BrickSize), 1));
+	return Bricks * BrickCells + FIntVector(1);
+}
+
+void USensingIlluminationData::ResetGrid(const FBox& Bounds, float InCellSize)
+{
+	CellSize = FMath::Max(InCellSize, 1.f);
+	Origin = Bounds.Min;
+	NumBricks = (GetNumPointsFor(Bounds, CellSize) - FIntVector(1)) / BrickCells;
+
+	Bricks.Reset();
+	BrickLevels.Reset();
+}
+
+FVector USensingIlluminationData::GetPointLocation(const FIntVector& Point) const
+{
+	return Origin + FVector(Point.X, Point.Y, Point.Z) * CellSize;
+}
+
+void USensingIlluminationData::SetPointLevels(const TArray<uint8>& Levels)
+{
+	const FIntVector NumPoints = GetNumPoints();
+	check(Levels.Num() == NumPoints.X * NumPoints.Y * NumPoints.Z);
+
+	Bricks.Reset(NumBricks.X * NumBricks.Y * NumBricks.Z);
+	BrickLevels.Reset();
+
+	TArray<uint8, TInlineAllocator<BrickPoints * BrickPoints * BrickPoints>> Brick;
+	for (int32 BrickZ = 0; BrickZ < NumBricks.Z; ++BrickZ)
+	{
+		for (int32 BrickY = 0; BrickY < NumBricks.Y; ++BrickY)
+		{
+			for (int32 BrickX = 0; BrickX < NumBricks.X; ++BrickX)
+			{
+				Brick.Reset();
+				bool bUniform = true;
+				for (int32 Z = 0; Z < BrickPoints; ++Z)
+				{
+					for (int32 Y = 0; Y < BrickPoints; ++Y)
+					{
+						for (int32 X = 0; X < BrickPoints; ++X)
+						{
+							const int32 PointX = BrickX * BrickCells + X;
+							const int32 PointY = BrickY * BrickCells + Y;
+							const int32 PointZ = BrickZ * BrickCells + Z;
+							const uint8 Level = Levels[(PointZ * NumPoints.Y + PointY) * NumPoints.X + PointX];
+							bUniform &= Brick.Num() == 0 || Level == Brick[0];
+							Brick.Add(Level);
+						}
+					}
+				}
+
+				if (bUniform)
+				{
+					Bricks.Add(-1 - (int32)Brick[0]);
+				}
+				else
+				{
+					Bricks.Add(BrickLevels.Num());
+					BrickLevels.Append(Brick);
+				}
+			}
+		}
+	}
+}
+
+void USensingIlluminationData::ClearGrid()
+{
+	NumBricks = FIntVector::ZeroValue;
+	Bricks.Empty();
+	BrickLevels.Empty();
+}
+
+float USensingIlluminationData::GetUniformBrickFraction() const
+{
+	if (Bricks.Num() == 0)
+	{
+		return 0.f;
+	}
+
+	int32 NumUniform = 0;
+	for (const int32 Entry : Bricks)
+	{
+		NumUniform += Entry < 0 ? 1 : 0;
+	}
+	return (float)NumUniform / Bricks.Num();
+}
+#endif
@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "SensingIlluminationData.generated.h"
+
+/**
+ * Baked light levels of a box of space, see ASensingVisibilityVolume::BakeIllumination().
+ * Light levels are sampled on a regular grid of points and looked up with trilinear filtering. The grid is cut into
+ * bricks of BrickCells cells per axis, and bricks of a single level (usually dark) store just that level.
+ */
+UCLASS(BlueprintType)
+class STEALTHGAME_API USensingIlluminationData : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	USensingIlluminationData();
+
+	/** Cells per brick along each axis. A brick holds BrickCells + 1 points per axis, so filtering never reads outside of it. */
+	static const int32 BrickCells = 4;
+	static const int32 BrickPoints = BrickCells + 1;
+
+	/**
+	 * Light level at Location, from 0 in complete darkness to 1 when fully lit.
+	 * @return false if Location is outside the baked box.
+	 */
+	bool GetIllumination(const FVector& Location, float& OutIllumination) const;
+
+	bool IsBaked() const { return Bricks.Num() > 0; }
+
+#if WITH_EDITOR
+	/** Number of grid points ResetGrid() would lay out for Bounds. */
+	static FIntVector GetNumPointsFor(const FBox& Bounds, float InCellSize);
+
+	/** Clears the data and lays out a grid of InCellSize cells covering Bounds. */
+	void ResetGrid(const FBox& Bounds, float InCellSize);
+
+	FIntVector GetNumPoints() const { return NumBricks * BrickCells + FIntVector(1); }
+
+	FVector GetPointLocation(const FIntVector& Point) const;
+
+	/** Fills the bricks from the light level of every grid point, X fastest, 0 to 255. */
+	void SetPointLevels(const TArray<uint8>& Levels);
+
+	/** Empties the grid, leaving every location unknown. */
+	void ClearGrid();
+
+	/** Fraction of the bricks that hold a single level. */
+	float GetUniformBrickFraction() const;
+#endif
+
+protected:
+	/** World location of grid point (0, 0, 0). */
+	UPROPERTY(VisibleAnywhere, Category = Sensing)
+		FVector Origin;
+
+	UPROPERTY(VisibleAnywhere, Category = Sensing)
+		float CellSize;
+
+	/** Number of bricks along each axis. */
+	UPROPERTY(VisibleAnywhere, Category = Sensing)
+		FIntVector NumBricks;
+
+	/** Per brick, X fastest: the offset of its points in BrickLevels, or -1 - Level for a brick of a single level. */
+	UPROPERTY()
+		TArray<int32> Bricks;
+
+	/** BrickPoints cubed light levels per stored brick, X fastest. */
+	UPROPERTY()
+		TArray<uint8> BrickLevels;
+};
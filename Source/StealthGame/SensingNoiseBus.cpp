@@ -0,0 +1,131 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SensingNoiseBus.h"
+#include "GameFramework/Pawn.h"
+
+FSensingNoiseBus::FSensingNoiseBus(float InCellSize)
+	: CellSize(FMath::Max(InCellSize, 1.f))
+	, MaxLoudness(0.f)
+	, LastId(0)
+{
+}
+
+void FSensingNoiseBus::SetCellSize(float InCellSize)
+{
+	CellSize = FMath::Max(InCellSize, 1.f);
+	RebuildBuckets();
+}
+
+FIntPoint FSensingNoiseBus::GetCell(const FVector& Location) const
+{
+	return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+}
+
+void FSensingNoiseBus::Add(const FSensingNoiseEvent& Event)
+{
+	// Footsteps and the like fire many times per frame, a sensor only needs to hear the loudest of them.
+	FSensingNoiseEvent* Queued = PendingEvents.FindByPredicate([&Event](const FSensingNoiseEvent& Candidate)
+	{
+		return Candidate.Instigator == Event.Instigator && Candidate.bSourceWithinNoiseEmitter == Event.bSourceWithinNoiseEmitter;
+	});
+
+	if (Queued == nullptr)
+	{
+		PendingEvents.Add(Event);
+	}
+	else if (Event.Loudness > Queued->Loudness)
+	{
+		*Queued = Event;
+	}
+}
+
+void FSensingNoiseBus::Flush(float Now, float Lifetime, int32 MaxEvents)
+{
+	int32 NumExpired = 0;
+	while (NumExpired < Events.Num() && Now - Events[NumExpired].Time > Lifetime)
+	{
+		++NumExpired;
+	}
+	NumExpired = FMath::Max(NumExpired, Events.Num() + PendingEvents.Num() - FMath::Max(MaxEvents, 1));
+	NumExpired = FMath::Min(NumExpired, Events.Num());
+
+	if (NumExpired == 0 && PendingEvents.Num() == 0)
+	{
+		return;
+	}
+
+	Events.RemoveAt(0, NumExpired, false);
+	for (FSensingNoiseEvent& Event : PendingEvents)
+	{
+		Event.Id = ++LastId;
+		Events.Add(Event);
+	}
+	PendingEvents.Reset();
+
+	RebuildBuckets();
+}
+
+void FSensingNoiseBus::RebuildBuckets()
+{
+	Buckets.Reset();
+	MaxLoudness = 0.f;
+	for (int32 Index = 0; Index < Events.Num(); ++Index)
+	{
+		Buckets.FindOrAdd(GetCell(Events[Index].Location)).Add(Index);
+		MaxLoudness = FMath::Max(MaxLoudness, Events[Index].Loudness);
+	}
+}
+
+void FSensingNoiseBus::Query(const FVector& Center, float HearingRange, uint32 SinceId, TArray<const FSensingNoiseEvent*>& OutEvents) const
+{
+	if (SinceId >= LastId || Events.Num() == 0)
+	{
+		return;
+	}
+
+	const float Radius = HearingRange * MaxLoudness;
+	const FIntPoint MinCell = GetCell(Center - FVector(Radius));
+	const FIntPoint MaxCell = GetCell(Center + FVector(Radius));
+	const int64 NumCells = (int64)(MaxCell.X - MinCell.X + 1) * (MaxCell.Y - MinCell.Y + 1);
+
+	auto TryAdd = [&](const FSensingNoiseEvent& Event)
+	{
+		if (Event.Id > SinceId && FVector::DistSquared(Center, Event.Location) <= FMath::Square(HearingRange * Event.Loudness))
+		{
+			OutEvents.Add(&Event);
+		}
+	};
+
+	// A very loud noise widens the query past the number of occupied cells, then it is cheaper to just look at every event.
+	if (NumCells > Buckets.Num())
+	{
+		for (const FSensingNoiseEvent& Event : Events)
+		{
+			TryAdd(Event);
+		}
+		return;
+	}
+
+	for (int32 CellY = MinCell.Y; CellY <= MaxCell.Y; ++CellY)
+	{
+		for (int32 CellX = MinCell.X; CellX <= MaxCell.X; ++CellX)
+		{
+			if (const TArray<int32, TInlineAllocator<4>>* Bucket = Buckets.Find(FIntPoint(CellX, CellY)))
+			{
+				for (const int32 Index : *Bucket)
+				{
+					TryAdd(Events[Index]);
+				}
+			}
+		}
+	}
+}
+
+void FSensingNoiseBus::Reset()
+{
+	Events.Reset();
+	PendingEvents.Reset();
+	Buckets.Reset();
+	MaxLoudness = 0.f;
+}
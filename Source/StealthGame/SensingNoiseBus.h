@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class APawn;
+
+/** A noise reported through AActor::MakeNoise(), as delivered to the sensing components. */
+struct FSensingNoiseEvent
+{
+	/** Increases with every committed event, so sensors can ask for the events they have not processed yet. */
+	uint32 Id = 0;
+
+	TWeakObjectPtr<APawn> Instigator;
+
+	FVector Location = FVector::ZeroVector;
+
+	float Loudness = 0.f;
+
+	/** World time the noise was made at. */
+	float Time = 0.f;
+
+	/** Range passed to MakeNoise(), the noise can't be heard further than this. 0 means no limit. */
+	float MaxRange = 0.f;
+
+	FName Tag;
+
+	/** True if the noise was made by the instigator itself, as opposed to somewhere else on its behalf. */
+	bool bSourceWithinNoiseEmitter = false;
+};
+
+/**
+ * Collects the noise events of a world and buckets them over the XY plane, so a sensor only visits the noises around it.
+ * Events added during a frame are coalesced per instigator and committed together by Flush(), which also drops events
+ * older than the lifetime. Event pointers returned by Query() are valid until the next Flush().
+ */
+class STEALTHGAME_API FSensingNoiseBus
+{
+public:
+	explicit FSensingNoiseBus(float InCellSize = 2000.f);
+
+	void SetCellSize(float InCellSize);
+
+	/** Queues an event for the next Flush(). Louder events replace quieter ones of the same instigator and kind queued this frame. */
+	void Add(const FSensingNoiseEvent& Event);
+
+	/** Commits the events queued since the last flush, and forgets committed events older than Lifetime seconds or beyond MaxEvents. */
+	void Flush(float Now, float Lifetime, int32 MaxEvents);
+
+	/**
+	 * Appends the committed events newer than SinceId whose location is within HearingRange * Loudness of Center,
+	 * the furthest any sensor with that hearing range could hear them.
+	 */
+	void Query(const FVector& Center, float HearingRange, uint32 SinceId, TArray<const FSensingNoiseEvent*>& OutEvents) const;
+
+	/** Id of the newest committed event, 0 if there never was one. */
+	uint32 GetLastId() const { return LastId; }
+
+	void Reset();
+
+	int32 Num() const { return Events.Num(); }
+
+private:
+	FIntPoint GetCell(const FVector& Location) const;
+
+	/** Rebuilds Buckets and MaxLoudness from Events. */
+	void RebuildBuckets();
+
+	float CellSize;
+
+	/** Committed events, oldest first. */
+	TArray<FSensingNoiseEvent> Events;
+
+	/** Events queued this frame, at most one per instigator and kind. */
+	TArray<FSensingNoiseEvent> PendingEvents;
+
+	/** Indices into Events bucketed by cell. */
+	TMap<FIntPoint, TArray<int32, TInlineAllocator<4>>> Buckets;
+
+	/** Loudest committed event, bounds the radius of Query(). */
+	float MaxLoudness;
+
+	uint32 LastId;
+};
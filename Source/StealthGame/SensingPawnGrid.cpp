@@ -0,0 +1,143 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SensingPawnGrid.h"
+#include "GameFramework/Pawn.h"
+
+FSensingPawnGrid::FSensingPawnGrid(float InCellSize)
+	: CellSize(FMath::Max(InCellSize, 1.f))
+{
+}
+
+void FSensingPawnGrid::SetCellSize(float InCellSize)
+{
+	CellSize = FMath::Max(InCellSize, 1.f);
+
+	Cells.Reset();
+	for (TSparseArray<FEntry>::TIterator It(Entries); It; ++It)
+	{
+		if (const APawn* Pawn = It->Pawn.Get())
+		{
+			It->Cell = GetCell(Pawn->GetActorLocation());
+			AddToCell(It->Cell, It.GetIndex());
+		}
+	}
+}
+
+FIntPoint FSensingPawnGrid::GetCell(const FVector& Location) const
+{
+	return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+}
+
+void FSensingPawnGrid::AddToCell(const FIntPoint& Cell, int32 EntryIndex)
+{
+	Cells.FindOrAdd(Cell).Add(EntryIndex);
+}
+
+void FSensingPawnGrid::RemoveFromCell(const FIntPoint& Cell, int32 EntryIndex)
+{
+	if (TArray<int32, TInlineAllocator<4>>* CellEntries = Cells.Find(Cell))
+	{
+		CellEntries->RemoveSingleSwap(EntryIndex, false);
+		if (CellEntries->Num() == 0)
+		{
+			Cells.Remove(Cell);
+		}
+	}
+}
+
+void FSensingPawnGrid::Add(APawn* Pawn)
+{
+	if (Pawn == nullptr || PawnToEntry.Contains(Pawn))
+	{
+		return;
+	}
+
+	FEntry Entry;
+	Entry.Pawn = Pawn;
+	Entry.Cell = GetCell(Pawn->GetActorLocation());
+
+	const int32 EntryIndex = Entries.Add(Entry);
+	AddToCell(Entry.Cell, EntryIndex);
+	PawnToEntry.Add(Pawn, EntryIndex);
+}
+
+void FSensingPawnGrid::Remove(const APawn* Pawn)
+{
+	int32 EntryIndex = INDEX_NONE;
+	if (PawnToEntry.RemoveAndCopyValue(Pawn, EntryIndex))
+	{
+		RemoveFromCell(Entries[EntryIndex].Cell, EntryIndex);
+		Entries.RemoveAt(EntryIndex);
+	}
+}
+
+void FSensingPawnGrid::UnlinkEntry(int32 EntryIndex)
+{
+	// The pawn is gone, so look the key up by value instead of by pointer.
+	for (TMap<TObjectKey<APawn>, int32>::TIterator It(PawnToEntry); It; ++It)
+	{
+		if (It.Value() == EntryIndex)
+		{
+			It.RemoveCurrent();
+			break;
+		}
+	}
+
+	RemoveFromCell(Entries[EntryIndex].Cell, EntryIndex);
+}
+
+void FSensingPawnGrid::Update()
+{
+	for (TSparseArray<FEntry>::TIterator It(Entries); It; ++It)
+	{
+		const APawn* Pawn = It->Pawn.Get();
+		if (Pawn == nullptr)
+		{
+			UnlinkEntry(It.GetIndex());
+			It.RemoveCurrent();
+			continue;
+		}
+
+		const FIntPoint NewCell = GetCell(Pawn->GetActorLocation());
+		if (NewCell != It->Cell)
+		{
+			RemoveFromCell(It->Cell, It.GetIndex());
+			AddToCell(NewCell, It.GetIndex());
+			It->Cell = NewCell;
+		}
+	}
+}
+
+void FSensingPawnGrid::Query(const FVector& Center, float Radius, TArray<APawn*>& OutPawns) const
+{
+	const FIntPoint MinCell = GetCell(Center - FVector(Radius));
+	const FIntPoint MaxCell = GetCell(Center + FVector(Radius));
+
+	for (int32 CellY = MinCell.Y; CellY <= MaxCell.Y; ++CellY)
+	{
+		for (int32 CellX = MinCell.X; CellX <= MaxCell.X; ++CellX)
+		{
+			const TArray<int32, TInlineAllocator<4>>* CellEntries = Cells.Find(FIntPoint(CellX, CellY));
+			if (CellEntries == nullptr)
+			{
+				continue;
+			}
+
+			for (const int32 EntryIndex : *CellEntries)
+			{
+				if (APawn* Pawn = Entries[EntryIndex].Pawn.Get())
+				{
+					OutPawns.Add(Pawn);
+				}
+			}
+		}
+	}
+}
+
+void FSensingPawnGrid::Reset()
+{
+	Entries.Reset();
+	Cells.Reset();
+	PawnToEntry.Reset();
+}
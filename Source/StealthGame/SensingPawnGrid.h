@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/ObjectKey.h"
+
+class APawn;
+
+/**
+ * Uniform spatial hash of pawns over the XY plane, used to find sensing candidates without walking every pawn in the world.
+ * Pawns are bucketed by the cell their actor location falls in. Update() only moves the pawns whose cell changed,
+ * so keeping the grid current costs one location read per pawn per frame.
+ */
+class STEALTHGAME_API FSensingPawnGrid
+{
+public:
+	explicit FSensingPawnGrid(float InCellSize = 2000.f);
+
+	/** Changes the cell size and rebuckets every pawn. */
+	void SetCellSize(float InCellSize);
+
+	float GetCellSize() const { return CellSize; }
+
+	void Add(APawn* Pawn);
+
+	void Remove(const APawn* Pawn);
+
+	/** Moves pawns that crossed a cell boundary and drops pawns that have been destroyed. */
+	void Update();
+
+	/** Appends every pawn in the cells overlapped by the given sphere. Pawns near the edge of those cells may lie outside the sphere. */
+	void Query(const FVector& Center, float Radius, TArray<APawn*>& OutPawns) const;
+
+	void Reset();
+
+	int32 Num() const { return Entries.Num(); }
+
+private:
+	struct FEntry
+	{
+		TWeakObjectPtr<APawn> Pawn;
+		FIntPoint Cell;
+	};
+
+	FIntPoint GetCell(const FVector& Location) const;
+
+	void AddToCell(const FIntPoint& Cell, int32 EntryIndex);
+	void RemoveFromCell(const FIntPoint& Cell, int32 EntryIndex);
+
+	/** Removes a destroyed pawn's entry from its cell and from PawnToEntry, the caller frees the entry itself. */
+	void UnlinkEntry(int32 EntryIndex);
+
+	float CellSize;
+
+	/** Every tracked pawn. Sparse so that entry indices stay valid while pawns come and go. */
+	TSparseArray<FEntry> Entries;
+
+	/** Entry indices bucketed by cell. Empty cells are removed. */
+	TMap<FIntPoint, TArray<int32, TInlineAllocator<4>>> Cells;
+
+	/** Entry index of every tracked pawn. */
+	TMap<TObjectKey<APawn>, int32> PawnToEntry;
+};
@@ -0,0 +1,515 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "StealthGame.h"
+#include "MovablePawnSensingComponent.h"
+#include "SensingSubsystem.h"
+#include "LaserComponent.h"
+#include "LaserSubsystem.h"
+#include "SecurityCamera.h"
+#include "SensingTestWorld.h"
+#include "HAL/FileManager.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+
+/**
+ * Performance regression tests of sensing, lasers and alarms. Run headless with
+ *
+ *   UE4Editor StealthGame -game -nullrhi -unattended -ExecCmds="Automation RunTests StealthGame.Perf; Quit"
+ *
+ * Every scenario measures the game thread time and the heap allocations per operation, and fails if they exceed the
+ * baseline recorded in Tests/SensingPerfBaselines.json by more than the scenario's tolerance. Scenarios without a recorded
+ * baseline only warn. Pass -UpdatePerfBaselines to write the measured values to Saved/Automation/SensingPerfBaselines.json,
+ * to be copied over the checked-in file once reviewed.
+ */
+namespace SensingPerfTests
+{
+	static const float FrameTime = 1.f / 30.f;
+	static const int32 WarmupFrames = 30;
+	static const int32 MeasuredFrames = 120;
+
+	/**
+	 * Forwards everything to the allocator it wraps, and counts the allocations made by one thread while counting.
+	 * Installed as GMalloc for the measured part of a scenario only. Other threads keep working through it meanwhile,
+	 * so it is never deleted.
+	 */
+	class FCountingMalloc final : public FMalloc
+	{
+	public:
+		explicit FCountingMalloc(FMalloc* InInner)
+			: Inner(InInner)
+			, CountingThreadId(0)
+			, NumAllocations(0)
+		{
+		}
+
+		FMalloc* GetInner() const { return Inner; }
+
+		void Begin()
+		{
+			NumAllocations = 0;
+			CountingThreadId = FPlatformTLS::GetCurrentThreadId();
+		}
+
+		uint64 End()
+		{
+			CountingThreadId = 0;
+			return NumAllocations;
+		}
+
+		virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+		{
+			CountAllocation();
+			return Inner->Malloc(Count, Alignment);
+		}
+
+		virtual void* TryMalloc(SIZE_T Count, uint32 Alignment) override
+		{
+			CountAllocation();
+			return Inner->TryMalloc(Count, Alignment);
+		}
+
+		virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			if (Count > 0)
+			{
+				CountAllocation();
+			}
+			return Inner->Realloc(Original, Count, Alignment);
+		}
+
+		virtual void* TryRealloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			if (Count > 0)
+			{
+				CountAllocation();
+			}
+			return Inner->TryRealloc(Original, Count, Alignment);
+		}
+
+		virtual void Free(void* Original) override { Inner->Free(Original); }
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return Inner->QuantizeSize(Count, Alignment); }
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+		virtual void Trim(bool bTrimThreadCaches) override { Inner->Trim(bTrimThreadCaches); }
+		virtual void SetupTLSCachesOnCurrentThread() override { Inner->SetupTLSCachesOnCurrentThread(); }
+		virtual void ClearAndDisableTLSCachesOnCurrentThread() override { Inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+		virtual void InitializeStatsMetadata() override { Inner->InitializeStatsMetadata(); }
+		virtual void UpdateStats() override { Inner->UpdateStats(); }
+		virtual void GetAllocatorStats(FGenericMemoryStats& OutStats) override { Inner->GetAllocatorStats(OutStats); }
+		virtual void DumpAllocatorStats(FOutputDevice& Ar) override { Inner->DumpAllocatorStats(Ar); }
+		virtual bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+		virtual bool ValidateHeap() override { return Inner->ValidateHeap(); }
+		virtual const TCHAR* GetDescriptiveName() override { return Inner->GetDescriptiveName(); }
+
+	private:
+		void CountAllocation()
+		{
+			if (CountingThreadId != 0 && FPlatformTLS::GetCurrentThreadId() == CountingThreadId)
+			{
+				++NumAllocations;
+			}
+		}
+
+		FMalloc* Inner;
+		volatile uint32 CountingThreadId;
+		uint64 NumAllocations;
+	};
+
+	/** Time and heap allocations of the code run between two Resume() / Pause() calls. */
+	class FMeasurement
+	{
+	public:
+		FMeasurement()
+			: Cycles(0)
+			, StartCycles(0)
+			, NumAllocations(0)
+		{
+			static FCountingMalloc* CountingMalloc = new FCountingMalloc(GMalloc);
+			Counter = CountingMalloc;
+		}
+
+		void Resume()
+		{
+			GMalloc = Counter;
+			Counter->Begin();
+			StartCycles = FPlatformTime::Cycles64();
+		}
+
+		void Pause()
+		{
+			Cycles += FPlatformTime::Cycles64() - StartCycles;
+			NumAllocations += Counter->End();
+			GMalloc = Counter->GetInner();
+		}
+
+		double GetNanoseconds() const { return FPlatformTime::ToMilliseconds64(Cycles) * 1000000.0; }
+		uint64 GetNumAllocations() const { return NumAllocations; }
+
+	private:
+		FCountingMalloc* Counter;
+		uint64 Cycles;
+		uint64 StartCycles;
+		uint64 NumAllocations;
+	};
+
+	struct FPerfResult
+	{
+		double NanosecondsPerOp = 0.0;
+		double AllocationsPerOp = 0.0;
+		uint64 NumOps = 0;
+	};
+
+	static FPerfResult MakeResult(const FMeasurement& Measurement, uint64 NumOps)
+	{
+		FPerfResult Result;
+		Result.NumOps = NumOps;
+		if (NumOps > 0)
+		{
+			Result.NanosecondsPerOp = Measurement.GetNanoseconds() / NumOps;
+			Result.AllocationsPerOp = (double)Measurement.GetNumAllocations() / NumOps;
+		}
+		return Result;
+	}
+
+	/** Parses "AxB" test parameters. */
+	static void ParseDimensions(const FString& Parameters, int32& OutA, int32& OutB)
+	{
+		FString A, B;
+		if (!Parameters.Split(TEXT("x"), &A, &B))
+		{
+			A = Parameters;
+		}
+		OutA = FCString::Atoi(*A);
+		OutB = FCString::Atoi(*B);
+	}
+
+	static FString GetCheckedInBaselinePath()
+	{
+		return FPaths::ProjectDir() / TEXT("Tests/SensingPerfBaselines.json");
+	}
+
+	static FString GetUpdatedBaselinePath()
+	{
+		return FPaths::ProjectSavedDir() / TEXT("Automation/SensingPerfBaselines.json");
+	}
+
+	static TSharedPtr<FJsonObject> LoadBaselines(const FString& Path)
+	{
+		FString Json;
+		TSharedPtr<FJsonObject> Baselines;
+		if (FFileHelper::LoadFileToString(Json, *Path))
+		{
+			FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Json), Baselines);
+		}
+		return Baselines;
+	}
+
+	static void RecordBaseline(const FString& Scenario, const FPerfResult& Result)
+	{
+		// Start from the file updated by the previous scenarios of this run, so they all end up in it.
+		const FString Path = GetUpdatedBaselinePath();
+		TSharedPtr<FJsonObject> Baselines = LoadBaselines(IFileManager::Get().FileExists(*Path) ? Path : GetCheckedInBaselinePath());
+		if (!Baselines.IsValid())
+		{
+			Baselines = MakeShared<FJsonObject>();
+		}
+
+		const TSharedPtr<FJsonObject>* ScenariosPtr = nullptr;
+		TSharedPtr<FJsonObject> Scenarios = Baselines->TryGetObjectField(TEXT("Scenarios"), ScenariosPtr) ? *ScenariosPtr : MakeShared<FJsonObject>();
+		const TSharedPtr<FJsonObject>* ScenarioPtr = nullptr;
+		TSharedPtr<FJsonObject> Entry = Scenarios->TryGetObjectField(Scenario, ScenarioPtr) ? *ScenarioPtr : MakeShared<FJsonObject>();
+
+		Entry->SetNumberField(TEXT("NanosecondsPerOp"), FMath::RoundToDouble(Result.NanosecondsPerOp));
+		Entry->SetNumberField(TEXT("AllocationsPerOp"), FMath::RoundToDouble(Result.AllocationsPerOp * 1000.0) / 1000.0);
+		Scenarios->SetObjectField(Scenario, Entry);
+		Baselines->SetObjectField(TEXT("Scenarios"), Scenarios);
+
+		FString Json;
+		FJsonSerializer::Serialize(Baselines.ToSharedRef(), TJsonWriterFactory<>::Create(&Json));
+		FFileHelper::SaveStringToFile(Json, *Path);
+	}
+
+	/** Logs Result and fails Test if it regressed past the baseline of Scenario. */
+	static void CheckAgainstBaseline(FAutomationTestBase& Test, const FString& Scenario, const FPerfResult& Result)
+	{
+		Test.AddInfo(FString::Printf(TEXT("%s: %.1f ns and %.3f allocations per op over %llu ops"),
+			*Scenario, Result.NanosecondsPerOp, Result.AllocationsPerOp, Result.NumOps));
+
+		if (Result.NumOps == 0)
+		{
+			Test.AddError(FString::Printf(TEXT("%s did not run a single operation"), *Scenario));
+			return;
+		}
+
+		if (FParse::Param(FCommandLine::Get(), TEXT("UpdatePerfBaselines")))
+		{
+			RecordBaseline(Scenario, Result);
+		}
+
+		const TSharedPtr<FJsonObject> Baselines = LoadBaselines(GetCheckedInBaselinePath());
+		const TSharedPtr<FJsonObject>* ScenariosPtr = nullptr;
+		const TSharedPtr<FJsonObject>* EntryPtr = nullptr;
+		if (!Baselines.IsValid() || !Baselines->TryGetObjectField(TEXT("Scenarios"), ScenariosPtr) || !(*ScenariosPtr)->TryGetObjectField(Scenario, EntryPtr))
+		{
+			Test.AddWarning(FString::Printf(TEXT("%s has no baseline in %s"), *Scenario, *GetCheckedInBaselinePath()));
+			return;
+		}
+
+		const FJsonObject& Entry = **EntryPtr;
+		auto GetTolerance = [&Baselines, &Entry](const TCHAR* Field)
+		{
+			double Tolerance = 0.0;
+			return Entry.TryGetNumberField(Field, Tolerance) || Baselines->TryGetNumberField(Field, Tolerance) ? Tolerance : 0.0;
+		};
+
+		// Time is compared relatively, allocations absolutely: most scenarios should not allocate at all once warm.
+		double BaselineNanoseconds = 0.0;
+		if (Entry.TryGetNumberField(TEXT("NanosecondsPerOp"), BaselineNanoseconds) && BaselineNanoseconds > 0.0)
+		{
+			const double Limit = BaselineNanoseconds * (1.0 + GetTolerance(TEXT("TimeTolerance")));
+			if (Result.NanosecondsPerOp > Limit)
+			{
+				Test.AddError(FString::Printf(TEXT("%s regressed: %.1f ns per op, baseline %.1f ns, limit %.1f ns"),
+					*Scenario, Result.NanosecondsPerOp, BaselineNanoseconds, Limit));
+			}
+		}
+		else
+		{
+			Test.AddWarning(FString::Printf(TEXT("%s has no time baseline"), *Scenario));
+		}
+
+		double BaselineAllocations = 0.0;
+		if (Entry.TryGetNumberField(TEXT("AllocationsPerOp"), BaselineAllocations))
+		{
+			const double Limit = BaselineAllocations + GetTolerance(TEXT("AllocationTolerance"));
+			if (Result.AllocationsPerOp > Limit)
+			{
+				Test.AddError(FString::Printf(TEXT("%s regressed: %.3f allocations per op, baseline %.3f, limit %.3f"),
+					*Scenario, Result.AllocationsPerOp, BaselineAllocations, Limit));
+			}
+		}
+		else
+		{
+			Test.AddWarning(FString::Printf(TEXT("%s has no allocation baseline"), *Scenario));
+		}
+	}
+
+	/** NumSensors sensors in the middle of NumTargets moving pawns. One op is one sensor update. */
+	static FPerfResult RunSensorsVsTargets(int32 NumSensors, int32 NumTargets)
+	{
+		FSensingTestWorld PerfWorld;
+		UWorld* World = PerfWorld.Get();
+		USensingSubsystem* SensingSubsystem = World->GetSubsystem<USensingSubsystem>();
+		SensingSubsystem->SetSensingSeed(0);
+		SensingSubsystem->SetSensingBudget(0.f);
+
+		FRandomStream RandomStream(0);
+		const float AreaSize = 4000.f;
+
+		for (int32 Index = 0; Index < NumSensors; ++Index)
+		{
+			const FTransform Transform(FRotator(0.f, RandomStream.FRandRange(-180.f, 180.f), 0.f),
+				FVector(RandomStream.FRandRange(0.f, AreaSize), RandomStream.FRandRange(0.f, AreaSize), 100.f));
+			PerfWorld.SpawnComponentActor<UMovablePawnSensingComponent>(Transform, [](UMovablePawnSensingComponent* PawnSensing)
+			{
+				// Update every frame, and sense the targets rather than the (missing) players.
+				PawnSensing->SensingInterval = FrameTime;
+				PawnSensing->bOnlySensePlayers = false;
+				PawnSensing->bUseSignificanceLOD = false;
+			});
+		}
+
+		TArray<ACharacter*> Targets;
+		TArray<FVector> Centers;
+		for (int32 Index = 0; Index < NumTargets; ++Index)
+		{
+			const FVector Center(RandomStream.FRandRange(0.f, AreaSize), RandomStream.FRandRange(0.f, AreaSize), 100.f);
+			Centers.Add(Center);
+			Targets.Add(PerfWorld.SpawnCharacter(Center));
+		}
+
+		FMeasurement Measurement;
+		uint64 FirstUpdate = 0;
+		for (int32 Frame = 0; Frame < WarmupFrames + MeasuredFrames; ++Frame)
+		{
+			// Targets walk in small circles, so the visibility cache sees the movement a level would have.
+			const float Angle = Frame * FrameTime;
+			for (int32 Index = 0; Index < Targets.Num(); ++Index)
+			{
+				Targets[Index]->SetActorLocation(Centers[Index] + FVector(FMath::Cos(Angle + Index), FMath::Sin(Angle + Index), 0.f) * 200.f);
+			}
+			PerfWorld.Step(FrameTime);
+
+			if (Frame == WarmupFrames)
+			{
+				FirstUpdate = SensingSubsystem->GetNumSensorUpdates();
+			}
+
+			if (Frame >= WarmupFrames)
+			{
+				Measurement.Resume();
+			}
+			SensingSubsystem->Tick(FrameTime);
+			if (Frame >= WarmupFrames)
+			{
+				Measurement.Pause();
+			}
+		}
+
+		return MakeResult(Measurement, SensingSubsystem->GetNumSensorUpdates() - FirstUpdate);
+	}
+
+	/** NumLasers parallel lasers crossed by NumPawns walking pawns. One op is one laser update. */
+	static FPerfResult RunLasersWithMovingPawns(int32 NumLasers, int32 NumPawns)
+	{
+		FSensingTestWorld PerfWorld;
+		const float LaserSpacing = 100.f;
+		const float CorridorLength = NumLasers * LaserSpacing;
+
+		for (int32 Index = 0; Index < NumLasers; ++Index)
+		{
+			// Lasers point across the corridor (+Y), the pawns walk down it (+X).
+			const FTransform Transform(FRotator(0.f, 90.f, 0.f), FVector(Index * LaserSpacing, -250.f, 100.f));
+			PerfWorld.SpawnComponentActor<ULaserComponent>(Transform, [](ULaserComponent*) {});
+		}
+
+		TArray<ACharacter*> Pawns;
+		for (int32 Index = 0; Index < NumPawns; ++Index)
+		{
+			Pawns.Add(PerfWorld.SpawnCharacter(FVector(Index * CorridorLength / FMath::Max(NumPawns, 1), 0.f, 100.f)));
+		}
+
+		// The lasers registered with the laser subsystem when they were spawned, and are updated as one batch.
+		ULaserSubsystem* LaserSubsystem = PerfWorld.Get()->GetSubsystem<ULaserSubsystem>();
+
+		FMeasurement Measurement;
+		const float WalkSpeed = 600.f;
+		for (int32 Frame = 0; Frame < WarmupFrames + MeasuredFrames; ++Frame)
+		{
+			for (int32 Index = 0; Index < Pawns.Num(); ++Index)
+			{
+				const float X = FMath::Fmod(Index * CorridorLength / FMath::Max(NumPawns, 1) + Frame * FrameTime * WalkSpeed, CorridorLength);
+				Pawns[Index]->SetActorLocation(FVector(X, 0.f, 100.f));
+			}
+			PerfWorld.Step(FrameTime);
+
+			if (Frame >= WarmupFrames)
+			{
+				Measurement.Resume();
+			}
+			LaserSubsystem->Tick(FrameTime);
+			if (Frame >= WarmupFrames)
+			{
+				Measurement.Pause();
+			}
+		}
+
+		return MakeResult(Measurement, (uint64)NumLasers * MeasuredFrames);
+	}
+
+	/** One camera raising and clearing its alarm to NumObservers other cameras. One op is one observer notified. */
+	static FPerfResult RunAlarmFanOut(int32 NumObservers)
+	{
+		FSensingTestWorld PerfWorld;
+		UWorld* World = PerfWorld.Get();
+
+		ASecurityCamera* Source = World->SpawnActor<ASecurityCamera>(FVector::ZeroVector, FRotator::ZeroRotator);
+		for (int32 Index = 0; Index < NumObservers; ++Index)
+		{
+			Source->AlarmObservers.Add(World->SpawnActor<ASecurityCamera>(FVector(0.f, (Index + 1) * 100.f, 0.f), FRotator::ZeroRotator));
+		}
+
+		const int32 NumRounds = 1000;
+		FMeasurement Measurement;
+		for (int32 Round = 0; Round < WarmupFrames + NumRounds; ++Round)
+		{
+			Source->HasTarget = (Round & 1) == 0;
+
+			if (Round >= WarmupFrames)
+			{
+				Measurement.Resume();
+			}
+			Source->NotifyAlarmObservers();
+			if (Round >= WarmupFrames)
+			{
+				Measurement.Pause();
+			}
+		}
+
+		return MakeResult(Measurement, (uint64)NumObservers * NumRounds);
+	}
+}
+
+using namespace SensingPerfTests;
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FSensingPerfSensorsVsTargetsTest, "StealthGame.Perf.SensorsVsTargets",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+void FSensingPerfSensorsVsTargetsTest::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+	for (const TCHAR* Dimensions : { TEXT("16x16"), TEXT("64x64"), TEXT("256x64") })
+	{
+		OutBeautifiedNames.Add(Dimensions);
+		OutTestCommands.Add(Dimensions);
+	}
+}
+
+bool FSensingPerfSensorsVsTargetsTest::RunTest(const FString& Parameters)
+{
+	int32 NumSensors = 0;
+	int32 NumTargets = 0;
+	ParseDimensions(Parameters, NumSensors, NumTargets);
+	CheckAgainstBaseline(*this, TEXT("SensorsVsTargets.") + Parameters, RunSensorsVsTargets(NumSensors, NumTargets));
+	return true;
+}
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FSensingPerfLasersTest, "StealthGame.Perf.LasersWithMovingPawns",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+void FSensingPerfLasersTest::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+	for (const TCHAR* Dimensions : { TEXT("64x8"), TEXT("512x32") })
+	{
+		OutBeautifiedNames.Add(Dimensions);
+		OutTestCommands.Add(Dimensions);
+	}
+}
+
+bool FSensingPerfLasersTest::RunTest(const FString& Parameters)
+{
+	int32 NumLasers = 0;
+	int32 NumPawns = 0;
+	ParseDimensions(Parameters, NumLasers, NumPawns);
+	CheckAgainstBaseline(*this, TEXT("LasersWithMovingPawns.") + Parameters, RunLasersWithMovingPawns(NumLasers, NumPawns));
+	return true;
+}
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FSensingPerfAlarmFanOutTest, "StealthGame.Perf.AlarmFanOut",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+void FSensingPerfAlarmFanOutTest::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+	for (const TCHAR* NumObservers : { TEXT("8"), TEXT("64"), TEXT("512") })
+	{
+		OutBeautifiedNames.Add(NumObservers);
+		OutTestCommands.Add(NumObservers);
+	}
+}
+
+bool FSensingPerfAlarmFanOutTest::RunTest(const FString& Parameters)
+{
+	CheckAgainstBaseline(*this, TEXT("AlarmFanOut.") + Parameters, RunAlarmFanOut(FCString::Atoi(*Parameters)));
+	return true;
+}
+
+#endif
@@ -0,0 +1,59 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SensingReplication.h"
+#include "StealthGame.h"
+#include "MovablePawnSensingComponent.h"
+#include "GameFramework/Pawn.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Replicated Perception Bytes"), STAT_Sensing_ReplicatedPerceptionBytes, STATGROUP_Sensing);
+
+void FSensedTargetReplicationItem::PostReplicatedAdd(const FSensedTargetReplicationArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner != nullptr)
+	{
+		InArraySerializer.Owner->OnTargetPerceptionChanged.Broadcast(Pawn);
+	}
+}
+
+void FSensedTargetReplicationItem::PostReplicatedChange(const FSensedTargetReplicationArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner != nullptr)
+	{
+		InArraySerializer.Owner->OnTargetPerceptionChanged.Broadcast(Pawn);
+	}
+}
+
+void FSensedTargetReplicationItem::PreReplicatedRemove(const FSensedTargetReplicationArray& InArraySerializer)
+{
+	// Cleared first, so listeners querying the sensor find the target no longer perceived.
+	Flags = 0;
+	Awareness = 0;
+	if (InArraySerializer.Owner != nullptr)
+	{
+		InArraySerializer.Owner->OnTargetPerceptionChanged.Broadcast(Pawn);
+	}
+}
+
+const FSensedTargetReplicationItem* FSensedTargetReplicationArray::Find(const APawn* Pawn) const
+{
+	return Pawn != nullptr ? Items.FindByPredicate([Pawn](const FSensedTargetReplicationItem& Item) { return Item.Pawn == Pawn; }) : nullptr;
+}
+
+FSensedTargetReplicationItem* FSensedTargetReplicationArray::Find(const APawn* Pawn)
+{
+	return Pawn != nullptr ? Items.FindByPredicate([Pawn](const FSensedTargetReplicationItem& Item) { return Item.Pawn == Pawn; }) : nullptr;
+}
+
+bool FSensedTargetReplicationArray::NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+{
+	const int64 StartBits = DeltaParms.Writer != nullptr ? DeltaParms.Writer->GetNumBits() : 0;
+
+	const bool bResult = FFastArraySerializer::FastArrayDeltaSerialize<FSensedTargetReplicationItem, FSensedTargetReplicationArray>(Items, DeltaParms, *this);
+
+	if (DeltaParms.Writer != nullptr)
+	{
+		INC_DWORD_STAT_BY(STAT_Sensing_ReplicatedPerceptionBytes, (DeltaParms.Writer->GetNumBits() - StartBits + 7) / 8);
+	}
+	return bResult;
+}
@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/NetSerialization.h"
+#include "SensingReplication.generated.h"
+
+class APawn;
+class UMovablePawnSensingComponent;
+
+/** Bits of FSensedTargetReplicationItem::Flags. */
+enum class ESensedTargetFlags : uint8
+{
+	None = 0,
+	Seen = 1 << 0,
+	Heard = 1 << 1,
+};
+ENUM_CLASS_FLAGS(ESensedTargetFlags);
+
+/**
+ * What a sensor perceives of one target, as replicated to clients: the pawn, two flag bits and a quantized awareness.
+ * Only the properties that changed are sent with an item.
+ */
+USTRUCT()
+struct FSensedTargetReplicationItem : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+		APawn* Pawn = nullptr;
+
+	/** ESensedTargetFlags. */
+	UPROPERTY()
+		uint8 Flags = 0;
+
+	/** Awareness of the target from 0 to 1, quantized to a byte. */
+	UPROPERTY()
+		uint8 Awareness = 0;
+
+	bool HasFlag(ESensedTargetFlags Flag) const { return (Flags & (uint8)Flag) != 0; }
+
+	float GetAwareness() const { return Awareness / 255.f; }
+
+	//~ Begin FFastArraySerializerItem Interface.
+	void PostReplicatedAdd(const struct FSensedTargetReplicationArray& InArraySerializer);
+	void PostReplicatedChange(const struct FSensedTargetReplicationArray& InArraySerializer);
+	void PreReplicatedRemove(const struct FSensedTargetReplicationArray& InArraySerializer);
+	//~ End FFastArraySerializerItem Interface.
+};
+
+/**
+ * The targets a sensor currently perceives, delta serialized: only the items added, changed or removed since the last
+ * update a client received are sent. Targets the sensor neither perceives nor remembers have no item at all.
+ */
+USTRUCT()
+struct FSensedTargetReplicationArray : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+		TArray<FSensedTargetReplicationItem> Items;
+
+	/** Sensor the array belongs to, whose OnTargetPerceptionChanged is broadcast as changes arrive. Set by the sensor. */
+	UMovablePawnSensingComponent* Owner = nullptr;
+
+	/** Item of Pawn, or null if it is not perceived. */
+	const FSensedTargetReplicationItem* Find(const APawn* Pawn) const;
+	FSensedTargetReplicationItem* Find(const APawn* Pawn);
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms);
+};
+
+template<>
+struct TStructOpsTypeTraits<FSensedTargetReplicationArray> : public TStructOpsTypeTraitsBase2<FSensedTargetReplicationArray>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
+};
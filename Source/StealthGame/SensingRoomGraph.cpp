@@ -0,0 +1,131 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SensingRoomGraph.h"
+
+USensingRoomGraph::USensingRoomGraph()
+{
+	PortalDistancePenalty = 200.f;
+}
+
+int32 USensingRoomGraph::FindRoom(const FVector& Location) const
+{
+	// Levels have tens of rooms at most, a linear search is cheaper than anything fancier.
+	for (int32 Index = 0; Index < Rooms.Num(); ++Index)
+	{
+		if (Rooms[Index].Bounds.IsInsideOrOn(Location))
+		{
+			return Index;
+		}
+	}
+	return INDEX_NONE;
+}
+
+bool USensingRoomGraph::GetPropagatedDistance(const FVector& From, const FVector& To, float& OutDistance) const
+{
+	const int32 FromRoom = FindRoom(From);
+	const int32 ToRoom = FindRoom(To);
+	if (FromRoom == INDEX_NONE || ToRoom == INDEX_NONE)
+	{
+		return false;
+	}
+
+	if (FromRoom == ToRoom)
+	{
+		OutDistance = FVector::Dist(From, To);
+		return true;
+	}
+
+	const int32 NumPortals = Portals.Num();
+	float BestDistance = BIG_NUMBER;
+	for (const int32 FromPortal : Rooms[FromRoom].Portals)
+	{
+		const float ToFirstPortal = FVector::Dist(From, Portals[FromPortal].Location) + PortalDistancePenalty;
+		for (const int32 ToPortal : Rooms[ToRoom].Portals)
+		{
+			const float BetweenPortals = PortalDistances[FromPortal * NumPortals + ToPortal];
+			if (BetweenPortals < BIG_NUMBER)
+			{
+				BestDistance = FMath::Min(BestDistance, ToFirstPortal + BetweenPortals + FVector::Dist(Portals[ToPortal].Location, To));
+			}
+		}
+	}
+
+	OutDistance = BestDistance;
+	return true;
+}
+
+#if WITH_EDITOR
+void USensingRoomGraph::ResetRooms(const TArray<FBox>& RoomBounds, float InPortalDistancePenalty)
+{
+	PortalDistancePenalty = InPortalDistancePenalty;
+	Portals.Reset();
+	PortalDistances.Reset();
+
+	Rooms.Reset(RoomBounds.Num());
+	for (const FBox& Bounds : RoomBounds)
+	{
+		FSensingRoom& Room = Rooms.AddDefaulted_GetRef();
+		Room.Bounds = Bounds;
+	}
+}
+
+void USensingRoomGraph::AddPortal(const FVector& Location, int32 RoomA, int32 RoomB)
+{
+	const int32 PortalIndex = Portals.Num();
+	FSensingPortal& Portal = Portals.AddDefaulted_GetRef();
+	Portal.Location = Location;
+	Portal.RoomA = RoomA;
+	Portal.RoomB = RoomB;
+
+	Rooms[RoomA].Portals.Add(PortalIndex);
+	Rooms[RoomB].Portals.Add(PortalIndex);
+}
+
+void USensingRoomGraph::BuildDistanceTable()
+{
+	const int32 NumPortals = Portals.Num();
+	PortalDistances.Init(BIG_NUMBER, NumPortals * NumPortals);
+
+	// Two portals of the same room are connected by a straight line across it.
+	for (int32 Portal = 0; Portal < NumPortals; ++Portal)
+	{
+		PortalDistances[Portal * NumPortals + Portal] = 0.f;
+	}
+	for (const FSensingRoom& Room : Rooms)
+	{
+		for (const int32 PortalA : Room.Portals)
+		{
+			for (const int32 PortalB : Room.Portals)
+			{
+				if (PortalA != PortalB)
+				{
+					const float Distance = FVector::Dist(Portals[PortalA].Location, Portals[PortalB].Location) + PortalDistancePenalty;
+					float& Entry = PortalDistances[PortalA * NumPortals + PortalB];
+					Entry = FMath::Min(Entry, Distance);
+				}
+			}
+		}
+	}
+
+	// Floyd-Warshall. Portal counts are small enough for the cubic cost to be irrelevant at bake time.
+	for (int32 Via = 0; Via < NumPortals; ++Via)
+	{
+		for (int32 From = 0; From < NumPortals; ++From)
+		{
+			const float FromToVia = PortalDistances[From * NumPortals + Via];
+			if (FromToVia >= BIG_NUMBER)
+			{
+				continue;
+			}
+
+			for (int32 To = 0; To < NumPortals; ++To)
+			{
+				const float Distance = FromToVia + PortalDistances[Via * NumPortals + To];
+				float& Entry = PortalDistances[From * NumPortals + To];
+				Entry = FMath::Min(Entry, Distance);
+			}
+		}
+	}
+}
+#endif
@@ -0,0 +1,89 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "SensingRoomGraph.generated.h"
+
+/** A room of a USensingRoomGraph, approximated by the bounding box of its ASensingRoomVolume. */
+USTRUCT()
+struct FSensingRoom
+{
+	GENERATED_BODY()
+
+	UPROPERTY(VisibleAnywhere, Category = Sensing)
+		FBox Bounds = FBox(ForceInit);
+
+	/** Indices of the portals leading out of the room. */
+	UPROPERTY(VisibleAnywhere, Category = Sensing)
+		TArray<int32> Portals;
+};
+
+/** An opening between two rooms that sound travels through. */
+USTRUCT()
+struct FSensingPortal
+{
+	GENERATED_BODY()
+
+	UPROPERTY(VisibleAnywhere, Category = Sensing)
+		FVector Location = FVector::ZeroVector;
+
+	UPROPERTY(VisibleAnywhere, Category = Sensing)
+		int32 RoomA = INDEX_NONE;
+
+	UPROPERTY(VisibleAnywhere, Category = Sensing)
+		int32 RoomB = INDEX_NONE;
+};
+
+/**
+ * Rooms and the portals between them, baked by ASensingVisibilityVolume from the level's ASensingRoomVolumes.
+ * Sound between two rooms travels through portals, so its path can be much longer than the straight line. The shortest
+ * path between every two portals is precomputed, which leaves a handful of distance sums per lookup at runtime.
+ */
+UCLASS(BlueprintType)
+class STEALTHGAME_API USensingRoomGraph : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	USensingRoomGraph();
+
+	/** Returns the room containing Location, or INDEX_NONE. */
+	int32 FindRoom(const FVector& Location) const;
+
+	/**
+	 * Length of the path sound takes from From to To: straight within a room, through the portals otherwise, plus
+	 * PortalDistancePenalty per portal crossed. BIG_NUMBER if no portal path connects the two rooms.
+	 * @return false if either location is outside every room, in which case nothing is known.
+	 */
+	bool GetPropagatedDistance(const FVector& From, const FVector& To, float& OutDistance) const;
+
+	int32 GetNumRooms() const { return Rooms.Num(); }
+	int32 GetNumPortals() const { return Portals.Num(); }
+
+#if WITH_EDITOR
+	/** Clears the graph and adds one room per box, without portals. */
+	void ResetRooms(const TArray<FBox>& RoomBounds, float InPortalDistancePenalty);
+
+	void AddPortal(const FVector& Location, int32 RoomA, int32 RoomB);
+
+	/** Precomputes the shortest path between every two portals. Call once every portal has been added. */
+	void BuildDistanceTable();
+#endif
+
+protected:
+	UPROPERTY(VisibleAnywhere, Category = Sensing)
+		TArray<FSensingRoom> Rooms;
+
+	UPROPERTY(VisibleAnywhere, Category = Sensing)
+		TArray<FSensingPortal> Portals;
+
+	/** Extra distance per portal crossed, to account for the sound lost at openings. */
+	UPROPERTY(VisibleAnywhere, Category = Sensing)
+		float PortalDistancePenalty;
+
+	/** Shortest path length between every two portals, row major. The penalty of every portal after the first is included. */
+	UPROPERTY()
+		TArray<float> PortalDistances;
+};
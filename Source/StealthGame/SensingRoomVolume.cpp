@@ -0,0 +1,11 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SensingRoomVolume.h"
+#include "Components/BrushComponent.h"
+#include "Engine/CollisionProfile.h"
+
+ASensingRoomVolume::ASensingRoomVolume()
+{
+	GetBrushComponent()->SetCollisionProfileName(UCollisionProfile::NoCollision_ProfileName);
+}
@@ -0,0 +1,21 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Volume.h"
+#include "SensingRoomVolume.generated.h"
+
+/**
+ * Marks out a room for sound propagation. Rooms are approximated by their bounding box and should be roughly convex,
+ * sound within a room is assumed to travel in a straight line. Openings between rooms whose volumes touch are found
+ * when the ASensingVisibilityVolume around them bakes its room graph.
+ */
+UCLASS()
+class STEALTHGAME_API ASensingRoomVolume : public AVolume
+{
+	GENERATED_BODY()
+
+public:
+	ASensingRoomVolume();
+};
@@ -0,0 +1,933 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SensingSubsystem.h"
+#include "StealthGame.h"
+#include "MovablePawnSensingComponent.h"
+#include "SensingVisibilityData.h"
+#include "SensingRoomGraph.h"
+#include "SensingIlluminationData.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/Pawn.h"
+#include "Components/PrimitiveComponent.h"
+#include "EngineUtils.h"
+#include "SignificanceManager.h"
+#include "Algo/Sort.h"
+#include "Async/ParallelFor.h"
+
+static const FName SensingSignificanceTag(TEXT("Sensing"));
+
+DECLARE_CYCLE_STAT(TEXT("Parallel Traces"), STAT_Sensing_ParallelTraces, STATGROUP_Sensing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Deferred Traces"), STAT_Sensing_DeferredTraces, STATGROUP_Sensing);
+
+/** Results of deferred traces can defer more traces (hearing after a failed line of sight), but never this many times over. */
+static const int32 MaxDeferredTraceRounds = 4;
+
+/**
+ * Sensing subsystems alive in any world. AActor's noise delegate is global, so the first one installs
+ * USensingSubsystem::MakeNoise and the last one to go puts the engine's implementation back.
+ */
+static int32 NumNoiseRoutingSubsystems = 0;
+
+USensingSubsystem::USensingSubsystem()
+{
+	SensingBudgetMicroseconds = 1000.f;
+	bBatchSightCulling = true;
+	bParallelSensingTraces = false;
+	MinParallelSensingTraces = 32;
+	bDeferringTraces = false;
+	PawnGridCellSize = 2000.f;
+	SensingSeed = 0;
+	SignificanceDistance = 10000.f;
+	SignificanceFloorHeight = 300.f;
+	OtherFloorSignificanceScale = 0.5f;
+	OccludedSignificanceScale = 0.5f;
+	FullSensingSignificance = 0.5f;
+	ReducedSensingSignificance = 0.25f;
+	SignificanceUpdateInterval = 0.25f;
+	NoiseEventLifetime = 5.f;
+	MaxNoiseEvents = 1024;
+	NoiseBucketCellSize = 2000.f;
+	LastSignificanceUpdateTime = -1.0;
+	MaxOccluderChanges = 256;
+	OccluderMoveTolerance = 1.f;
+	bPawnGridInitialized = false;
+	OccluderGeneration = 0;
+	ForgottenOccluderGeneration = 0;
+	bOccluderTrackingInitialized = false;
+	VisibilityCacheHits = 0;
+	VisibilityCacheMisses = 0;
+	NextSensorIndex = 0;
+	NumSensorUpdates = 0;
+	bIsUpdatingSensors = false;
+	bNeedsCompaction = false;
+}
+
+bool USensingSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	// Sensing only ever runs in game and PIE worlds, editor preview worlds don't need a scheduler.
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World != nullptr && World->IsGameWorld();
+}
+
+void USensingSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	PawnGrid.SetCellSize(PawnGridCellSize);
+	NoiseBus.SetCellSize(NoiseBucketCellSize);
+
+	// The delegate is global and shared with the subsystems of other worlds, MakeNoise() hands each noise to its own world's.
+	// It keeps the engine's behavior and adds the noise bus.
+	if (NumNoiseRoutingSubsystems++ == 0)
+	{
+		AActor::SetMakeNoiseDelegate(FMakeNoiseDelegate::CreateStatic(&USensingSubsystem::MakeNoise));
+	}
+}
+
+void USensingSubsystem::Deinitialize()
+{
+	Sensors.Reset();
+	NextSensorIndex = 0;
+
+	if (ActorSpawnedHandle.IsValid())
+	{
+		GetWorld()->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+		ActorSpawnedHandle.Reset();
+	}
+	if (PhysicsStateCreatedHandle.IsValid())
+	{
+		UActorComponent::GlobalCreatePhysicsDelegate.Remove(PhysicsStateCreatedHandle);
+		PhysicsStateCreatedHandle.Reset();
+	}
+	PawnGrid.Reset();
+	bPawnGridInitialized = false;
+
+	DynamicOccluders.Reset();
+	OccluderChanges.Reset();
+	bOccluderTrackingInitialized = false;
+	VisibilityData.Reset();
+	RoomGraphs.Reset();
+	IlluminationData.Reset();
+	NoiseBus.Reset();
+	DeferredTraces.Reset();
+	TracesInFlight.Reset();
+	TraceResults.Reset();
+
+	// AActor has no getter for the delegate, the engine's implementation is the one we replaced and forward to.
+	if (--NumNoiseRoutingSubsystems == 0)
+	{
+		AActor::SetMakeNoiseDelegate(FMakeNoiseDelegate::CreateStatic(&AActor::MakeNoiseImpl));
+	}
+
+	Super::Deinitialize();
+}
+
+ETickableTickType USensingSubsystem::GetTickableTickType() const
+{
+	// The CDO is constructed like any other instance, make sure it never ends up ticking.
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool USensingSubsystem::IsTickable() const
+{
+	return Sensors.Num() > 0;
+}
+
+TStatId USensingSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(USensingSubsystem, STATGROUP_Tickables);
+}
+
+UWorld* USensingSubsystem::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
+
+void USensingSubsystem::Tick(float DeltaTime)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(USensingSubsystem::Tick);
+	STEALTH_FRAME_COST_SCOPE(Sensing);
+
+	const UWorld* World = GetWorld();
+	if (!IsValid(World))
+	{
+		return;
+	}
+
+	const double Now = World->GetTimeSeconds();
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+	const uint64 BudgetCycles = (uint64)(SensingBudgetMicroseconds / (FPlatformTime::GetSecondsPerCycle64() * 1000000.0));
+
+	if (bPawnGridInitialized)
+	{
+		PawnGrid.Update();
+	}
+
+	if (bOccluderTrackingInitialized)
+	{
+		UpdateDynamicOccluders();
+	}
+
+	UpdateSignificance(Now);
+
+	// Commit the noises made since last frame before anyone listens for them.
+	NoiseBus.Flush((float)Now, NoiseEventLifetime, MaxNoiseEvents);
+
+	// Collect the sensors that are due, in round-robin order starting where the previous frame left off.
+	DueSensorSlots.Reset();
+	const int32 NumSensors = Sensors.Num();
+	for (int32 Visited = 0; Visited < NumSensors; ++Visited)
+	{
+		const int32 Slot = (NextSensorIndex + Visited) % NumSensors;
+		const UMovablePawnSensingComponent* Sensor = Sensors[Slot].Get();
+		if (Sensor != nullptr && Sensor->bSensingUpdatePending && Sensor->NextSensingUpdateTime <= Now)
+		{
+			DueSensorSlots.Add(Slot);
+		}
+	}
+
+	if (DueSensorSlots.Num() == 0)
+	{
+		return;
+	}
+
+	if (bBatchSightCulling)
+	{
+		BatchCullSight();
+	}
+
+	bIsUpdatingSensors = true;
+	bDeferringTraces = bParallelSensingTraces;
+
+	int32 NumUpdated = 0;
+	for (; NumUpdated < DueSensorSlots.Num(); ++NumUpdated)
+	{
+		const int32 Slot = DueSensorSlots[NumUpdated];
+		NextSensorIndex = Slot + 1;
+
+		UMovablePawnSensingComponent* Sensor = Sensors[Slot].Get();
+		if (Sensor == nullptr || !Sensor->bSensingUpdatePending)
+		{
+			// Unregistered or unscheduled by another sensor's update.
+			continue;
+		}
+
+		// Clear the pending flag first, OnTimer() reschedules the sensor if it still wants updates.
+		Sensor->bSensingUpdatePending = false;
+		Sensor->OnTimer();
+		Sensor->ClearBatchSightResult();
+		++NumSensorUpdates;
+
+		if (SensingBudgetMicroseconds > 0.f && (FPlatformTime::Cycles64() - StartCycles) >= BudgetCycles)
+		{
+			++NumUpdated;
+			break;
+		}
+	}
+
+	// Batch results of sensors that did not fit in the budget would be stale by next frame.
+	for (int32 Index = NumUpdated; Index < DueSensorSlots.Num(); ++Index)
+	{
+		if (UMovablePawnSensingComponent* Sensor = Sensors[DueSensorSlots[Index]].Get())
+		{
+			Sensor->ClearBatchSightResult();
+		}
+	}
+
+	RunDeferredTraces();
+	bDeferringTraces = false;
+
+	bIsUpdatingSensors = false;
+
+	if (bNeedsCompaction)
+	{
+		CompactSensors();
+	}
+}
+
+void USensingSubsystem::BatchCullSight()
+{
+	SCOPE_CYCLE_COUNTER(STAT_Sensing_ConeCulling);
+
+	UWorld* World = GetWorld();
+
+	// Players are candidates of every sensor, so they are the one target set worth sharing across the batch.
+	BatchTargetPawns.Reset();
+	BatchTargets.Reset();
+	for (FConstPlayerControllerIterator Iterator = World->GetPlayerControllerIterator(); Iterator; ++Iterator)
+	{
+		APlayerController* PC = Iterator->Get();
+		APawn* Pawn = IsValid(PC) ? PC->GetPawn() : nullptr;
+		if (IsValid(Pawn))
+		{
+			BatchTargetPawns.Add(Pawn);
+			BatchTargets.Add(Pawn->GetActorLocation(), GetIllumination(Pawn->GetActorLocation()));
+		}
+	}
+
+	if (BatchTargetPawns.Num() == 0)
+	{
+		return;
+	}
+	BatchTargets.Finalize();
+
+	BatchSensorList.Reset();
+	BatchSensors.Reset();
+	for (const int32 Slot : DueSensorSlots)
+	{
+		UMovablePawnSensingComponent* Sensor = Sensors[Slot].Get();
+		if (Sensor != nullptr && Sensor->bSeePawns && Sensor->GetSensingLOD() < ESensingLOD::HearingOnly && Sensor->CanSenseAnything())
+		{
+			BatchSensorList.Add(Sensor);
+			BatchSensors.Add(Sensor->GetSensorLocation(), Sensor->GetSensorRotation().GetSafeNormal(), Sensor->SightRadius, Sensor->GetPeripheralVisionCosine(), Sensor->GetDarkSightRadiusScale());
+			Sensor->BeginBatchSightResult(BatchTargetPawns);
+		}
+	}
+
+	BatchSurvivors.Reset();
+	SensingCulling::CullSightPairs(BatchSensors, BatchTargets, BatchSurvivors);
+	INC_DWORD_STAT_BY(STAT_Sensing_CulledPairs, BatchSensors.Num() * BatchTargets.Num() - BatchSurvivors.Num());
+
+	for (const FSensingCullPair& Pair : BatchSurvivors)
+	{
+		BatchSensorList[Pair.SensorIndex]->AddBatchSightSurvivor(BatchTargetPawns[Pair.TargetIndex]);
+	}
+}
+
+void USensingSubsystem::DeferTrace(UMovablePawnSensingComponent* Sensor, uint32 RequestId, const FVector& Start, const FVector& End, const FCollisionQueryParams& Params)
+{
+	check(bDeferringTraces);
+	DeferredTraces.Add({ Sensor, RequestId, Start, End, Params });
+}
+
+void USensingSubsystem::RunDeferredTraces()
+{
+	SCOPE_CYCLE_COUNTER(STAT_Sensing_ParallelTraces);
+	TRACE_CPUPROFILER_EVENT_SCOPE(USensingSubsystem::RunDeferredTraces);
+
+	const UWorld* World = GetWorld();
+	for (int32 Round = 0; DeferredTraces.Num() > 0; ++Round)
+	{
+		// Results handed back in the last round trace right away, so this always ends.
+		if (Round + 1 >= MaxDeferredTraceRounds)
+		{
+			bDeferringTraces = false;
+		}
+
+		Swap(TracesInFlight, DeferredTraces);
+		DeferredTraces.Reset();
+
+		const int32 NumTraces = TracesInFlight.Num();
+		INC_DWORD_STAT_BY(STAT_Sensing_DeferredTraces, NumTraces);
+		TraceResults.SetNumUninitialized(NumTraces, false);
+
+		// Scene queries are safe from any thread as long as nothing moves, and nothing does until the sensing update is over.
+		// Each worker only writes its own result, so no locks are needed and the results come back in submission order,
+		// which keeps the notifications as deterministic as the game thread traces.
+		ParallelFor(NumTraces, [this, World](int32 Index)
+		{
+			const FDeferredTrace& Trace = TracesInFlight[Index];
+			TraceResults[Index] = World->LineTraceTestByChannel(Trace.Start, Trace.End, ECC_Visibility, Trace.Params) ? 1 : 0;
+		}, NumTraces < MinParallelSensingTraces);
+
+		for (int32 Index = 0; Index < NumTraces; ++Index)
+		{
+			const FDeferredTrace& Trace = TracesInFlight[Index];
+			if (UMovablePawnSensingComponent* Sensor = Trace.Sensor.Get())
+			{
+				Sensor->OnTraceCompleted(Trace.RequestId, Trace.Start, Trace.End, TraceResults[Index] != 0);
+			}
+		}
+	}
+
+	TracesInFlight.Reset();
+}
+
+void USensingSubsystem::UpdateSignificance(double Now)
+{
+	if (LastSignificanceUpdateTime >= 0.0 && Now - LastSignificanceUpdateTime < SignificanceUpdateInterval)
+	{
+		return;
+	}
+	LastSignificanceUpdateTime = Now;
+
+	UWorld* World = GetWorld();
+	USignificanceManager* SignificanceManager = FSignificanceManagerModule::Get(World);
+	if (SignificanceManager == nullptr)
+	{
+		return;
+	}
+
+	SignificanceViewpoints.Reset();
+	for (FConstPlayerControllerIterator Iterator = World->GetPlayerControllerIterator(); Iterator; ++Iterator)
+	{
+		const APlayerController* PC = Iterator->Get();
+		if (IsValid(PC))
+		{
+			FVector ViewLocation;
+			FRotator ViewRotation;
+			PC->GetPlayerViewPoint(ViewLocation, ViewRotation);
+			SignificanceViewpoints.Emplace(ViewRotation, ViewLocation);
+		}
+	}
+
+	// Without players there is nobody to be significant to, leave every sensor where it was until one joins.
+	if (SignificanceViewpoints.Num() > 0)
+	{
+		SignificanceManager->Update(SignificanceViewpoints);
+	}
+}
+
+float USensingSubsystem::GetSensorSignificance(const UMovablePawnSensingComponent* Sensor, const FTransform& Viewpoint) const
+{
+	const FVector SensorLocation = Sensor->GetSensorLocation();
+	const FVector ViewLocation = Viewpoint.GetLocation();
+
+	const float DistanceSquared = FVector::DistSquared(SensorLocation, ViewLocation);
+	if (SignificanceDistance <= 0.f || DistanceSquared >= FMath::Square(SignificanceDistance))
+	{
+		return 0.f;
+	}
+
+	float Significance = 1.f - FMath::Sqrt(DistanceSquared) / SignificanceDistance;
+
+	if (FMath::Abs(SensorLocation.Z - ViewLocation.Z) > SignificanceFloorHeight)
+	{
+		Significance *= OtherFloorSignificanceScale;
+	}
+
+	// Prefer the baked rooms, the baked visibility stands in for them where there are none: if static geometry hides the
+	// sensor from the player, they are apart.
+	bool bSameRoom = true;
+	if (!IsInSameRoom(ViewLocation, SensorLocation, bSameRoom))
+	{
+		bSameRoom = IsPotentiallyVisible(ViewLocation, SensorLocation);
+	}
+	if (!bSameRoom)
+	{
+		Significance *= OccludedSignificanceScale;
+	}
+
+	// Whatever the player can see should react like it would up close.
+	const AActor* Owner = Sensor->GetOwner();
+	if (Owner != nullptr && Owner->WasRecentlyRendered(0.2f))
+	{
+		Significance = FMath::Max(Significance, FullSensingSignificance);
+	}
+
+	return Significance;
+}
+
+ESensingLOD USensingSubsystem::GetSensingLODForSignificance(float Significance) const
+{
+	if (Significance >= FullSensingSignificance)
+	{
+		return ESensingLOD::Full;
+	}
+	if (Significance >= ReducedSensingSignificance)
+	{
+		return ESensingLOD::Reduced;
+	}
+	return Significance > 0.f ? ESensingLOD::HearingOnly : ESensingLOD::Suspended;
+}
+
+void USensingSubsystem::MakeNoise(AActor* NoiseMaker, float Loudness, APawn* NoiseInstigator, const FVector& NoiseLocation, float MaxRange, FName Tag)
+{
+	AActor::MakeNoiseImpl(NoiseMaker, Loudness, NoiseInstigator, NoiseLocation, MaxRange, Tag);
+
+	if (NoiseMaker == nullptr)
+	{
+		return;
+	}
+
+	// Same instigator resolution as the engine's implementation. The noise goes to the sensors of the instigator's world.
+	APawn* Instigator = NoiseInstigator ? NoiseInstigator : NoiseMaker->GetInstigator();
+	UWorld* World = Instigator ? Instigator->GetWorld() : nullptr;
+	USensingSubsystem* SensingSubsystem = World ? World->GetSubsystem<USensingSubsystem>() : nullptr;
+	if (SensingSubsystem == nullptr)
+	{
+		return;
+	}
+
+	FSensingNoiseEvent Event;
+	Event.Instigator = Instigator;
+	Event.Location = NoiseLocation;
+	Event.Loudness = Loudness;
+	Event.Time = World->GetTimeSeconds();
+	Event.MaxRange = MaxRange;
+	Event.Tag = Tag;
+	Event.bSourceWithinNoiseEmitter = (NoiseMaker == Instigator);
+	SensingSubsystem->ReportNoiseEvent(Event);
+}
+
+void USensingSubsystem::ReportNoiseEvent(const FSensingNoiseEvent& Event)
+{
+	if (Event.Loudness > 0.f && Event.Instigator.IsValid())
+	{
+		NoiseBus.Add(Event);
+	}
+}
+
+uint32 USensingSubsystem::GatherNoiseEvents(const FVector& Center, float HearingRange, uint32 SinceId, TArray<const FSensingNoiseEvent*>& OutEvents) const
+{
+	const int32 FirstNewEvent = OutEvents.Num();
+	NoiseBus.Query(Center, HearingRange, SinceId, OutEvents);
+
+	// Buckets come back in no particular order, but noises of the same pawn have to be heard in the order they were made.
+	Algo::SortBy(MakeArrayView(OutEvents.GetData() + FirstNewEvent, OutEvents.Num() - FirstNewEvent), [](const FSensingNoiseEvent* Event) { return Event->Id; });
+	return NoiseBus.GetLastId();
+}
+
+void USensingSubsystem::InitializePawnGrid()
+{
+	UWorld* World = GetWorld();
+	for (APawn* Pawn : TActorRange<APawn>(World))
+	{
+		PawnGrid.Add(Pawn);
+	}
+
+	AddActorSpawnedHandler();
+	bPawnGridInitialized = true;
+}
+
+void USensingSubsystem::AddActorSpawnedHandler()
+{
+	if (!ActorSpawnedHandle.IsValid())
+	{
+		ActorSpawnedHandle = GetWorld()->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &USensingSubsystem::OnActorSpawned));
+	}
+}
+
+void USensingSubsystem::OnActorSpawned(AActor* Actor)
+{
+	APawn* Pawn = Cast<APawn>(Actor);
+	if (bPawnGridInitialized && Pawn != nullptr)
+	{
+		PawnGrid.Add(Pawn);
+	}
+}
+
+void USensingSubsystem::InitializeOccluderTracking()
+{
+	for (AActor* Actor : TActorRange<AActor>(GetWorld()))
+	{
+		for (UActorComponent* Component : Actor->GetComponents())
+		{
+			if (UPrimitiveComponent* Primitive = Cast<UPrimitiveComponent>(Component))
+			{
+				WatchOccluderCandidate(*Primitive);
+			}
+		}
+	}
+
+	// Actors spawned from Blueprints are spawned deferred, their components only register once the construction script
+	// has run. Catch those, components added later on, and components whose collision gets switched on.
+	PhysicsStateCreatedHandle = UActorComponent::GlobalCreatePhysicsDelegate.AddUObject(this, &USensingSubsystem::OnComponentPhysicsStateCreated);
+	bOccluderTrackingInitialized = true;
+}
+
+bool USensingSubsystem::BlocksSensingTraces(const UPrimitiveComponent& Primitive)
+{
+	// Anything that ignores the visibility channel (pawn capsules with the default profile, for instance) can't change
+	// the outcome of a sensing trace.
+	return Primitive.IsQueryCollisionEnabled() && Primitive.GetCollisionResponseToChannel(ECC_Visibility) == ECR_Block;
+}
+
+void USensingSubsystem::WatchOccluderCandidate(UPrimitiveComponent& Primitive)
+{
+	// Static and stationary geometry never moves at runtime.
+	if (Primitive.Mobility != EComponentMobility::Movable)
+	{
+		return;
+	}
+
+	if (!Primitive.OnComponentCollisionSettingsChangedEvent.IsBoundToObject(this))
+	{
+		Primitive.OnComponentCollisionSettingsChangedEvent.AddUObject(this, &USensingSubsystem::UpdateOccluderCandidate);
+	}
+
+	if (BlocksSensingTraces(Primitive))
+	{
+		FDynamicOccluder& Occluder = DynamicOccluders.AddDefaulted_GetRef();
+		Occluder.Component = &Primitive;
+		Occluder.Bounds = Primitive.Bounds.GetBox();
+	}
+}
+
+void USensingSubsystem::UpdateOccluderCandidate(UPrimitiveComponent* Primitive)
+{
+	if (Primitive == nullptr || Primitive->Mobility != EComponentMobility::Movable)
+	{
+		return;
+	}
+
+	if (!Primitive->OnComponentCollisionSettingsChangedEvent.IsBoundToObject(this))
+	{
+		Primitive->OnComponentCollisionSettingsChangedEvent.AddUObject(this, &USensingSubsystem::UpdateOccluderCandidate);
+	}
+
+	const int32 Index = DynamicOccluders.IndexOfByPredicate([Primitive](const FDynamicOccluder& Occluder) { return Occluder.Component.Get() == Primitive; });
+	const bool bBlocks = BlocksSensingTraces(*Primitive);
+	if (bBlocks && Index == INDEX_NONE)
+	{
+		// Something that blocks sight just appeared, cached results across it no longer hold.
+		FDynamicOccluder& Occluder = DynamicOccluders.AddDefaulted_GetRef();
+		Occluder.Component = Primitive;
+		Occluder.Bounds = Primitive->Bounds.GetBox();
+		RecordOccluderChange(Occluder.Bounds);
+	}
+	else if (!bBlocks && Index != INDEX_NONE)
+	{
+		RecordOccluderChange(DynamicOccluders[Index].Bounds);
+		DynamicOccluders.RemoveAtSwap(Index);
+	}
+}
+
+void USensingSubsystem::OnComponentPhysicsStateCreated(UActorComponent* Component)
+{
+	UPrimitiveComponent* Primitive = Cast<UPrimitiveComponent>(Component);
+	if (Primitive != nullptr && Primitive->GetWorld() == GetWorld())
+	{
+		UpdateOccluderCandidate(Primitive);
+	}
+}
+
+void USensingSubsystem::UpdateDynamicOccluders()
+{
+	for (int32 Index = DynamicOccluders.Num() - 1; Index >= 0; --Index)
+	{
+		FDynamicOccluder& Occluder = DynamicOccluders[Index];
+		const UPrimitiveComponent* Primitive = Occluder.Component.Get();
+		if (Primitive == nullptr || !BlocksSensingTraces(*Primitive))
+		{
+			// Destroyed, or stopped blocking. Either way the space it used to take up may now be clear.
+			RecordOccluderChange(Occluder.Bounds);
+			DynamicOccluders.RemoveAtSwap(Index);
+			continue;
+		}
+
+		const FBox NewBounds = Primitive->Bounds.GetBox();
+		if (!NewBounds.Min.Equals(Occluder.Bounds.Min, OccluderMoveTolerance) || !NewBounds.Max.Equals(Occluder.Bounds.Max, OccluderMoveTolerance))
+		{
+			// Whatever was behind the old bounds may now be visible, and whatever is behind the new ones may not.
+			RecordOccluderChange(Occluder.Bounds + NewBounds);
+			Occluder.Bounds = NewBounds;
+		}
+	}
+}
+
+void USensingSubsystem::RecordOccluderChange(const FBox& Bounds)
+{
+	++OccluderGeneration;
+
+	FOccluderChange& Change = OccluderChanges.AddDefaulted_GetRef();
+	Change.Bounds = Bounds;
+	Change.Generation = OccluderGeneration;
+
+	const int32 NumToForget = OccluderChanges.Num() - FMath::Max(MaxOccluderChanges, 1);
+	if (NumToForget > 0)
+	{
+		ForgottenOccluderGeneration = OccluderChanges[NumToForget - 1].Generation;
+		OccluderChanges.RemoveAt(0, NumToForget, false);
+	}
+}
+
+uint32 USensingSubsystem::GetOccluderGeneration()
+{
+	if (!bOccluderTrackingInitialized)
+	{
+		InitializeOccluderTracking();
+	}
+
+	return OccluderGeneration;
+}
+
+bool USensingSubsystem::IsSegmentUnchanged(const FVector& Start, const FVector& End, uint32 SinceGeneration)
+{
+	if (!bOccluderTrackingInitialized || SinceGeneration < ForgottenOccluderGeneration)
+	{
+		return false;
+	}
+
+	const FVector StartToEnd = End - Start;
+	for (int32 Index = OccluderChanges.Num() - 1; Index >= 0 && OccluderChanges[Index].Generation > SinceGeneration; --Index)
+	{
+		if (FMath::LineBoxIntersection(OccluderChanges[Index].Bounds, Start, End, StartToEnd))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool USensingSubsystem::IsRegionUnchanged(const FBox& Bounds, uint32 SinceGeneration)
+{
+	if (!bOccluderTrackingInitialized || SinceGeneration < ForgottenOccluderGeneration)
+	{
+		return false;
+	}
+
+	for (int32 Index = OccluderChanges.Num() - 1; Index >= 0 && OccluderChanges[Index].Generation > SinceGeneration; --Index)
+	{
+		if (OccluderChanges[Index].Bounds.Intersect(Bounds))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void USensingSubsystem::RegisterVisibilityData(USensingVisibilityData* Data)
+{
+	if (Data != nullptr)
+	{
+		VisibilityData.AddUnique(Data);
+	}
+}
+
+void USensingSubsystem::UnregisterVisibilityData(USensingVisibilityData* Data)
+{
+	VisibilityData.Remove(Data);
+}
+
+bool USensingSubsystem::IsPotentiallyVisible(const FVector& From, const FVector& To) const
+{
+	// Every set only knows about its own volume, but an occlusion proven by any of them holds.
+	for (const USensingVisibilityData* Data : VisibilityData)
+	{
+		if (!Data->IsPotentiallyVisible(From, To))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void USensingSubsystem::RegisterRoomGraph(USensingRoomGraph* Graph)
+{
+	if (Graph != nullptr)
+	{
+		RoomGraphs.AddUnique(Graph);
+	}
+}
+
+void USensingSubsystem::UnregisterRoomGraph(USensingRoomGraph* Graph)
+{
+	RoomGraphs.Remove(Graph);
+}
+
+bool USensingSubsystem::GetPropagatedSoundDistance(const FVector& From, const FVector& To, float& OutDistance) const
+{
+	for (const USensingRoomGraph* Graph : RoomGraphs)
+	{
+		if (Graph->GetPropagatedDistance(From, To, OutDistance))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool USensingSubsystem::IsInSameRoom(const FVector& A, const FVector& B, bool& bOutSameRoom) const
+{
+	for (const USensingRoomGraph* Graph : RoomGraphs)
+	{
+		const int32 RoomA = Graph->FindRoom(A);
+		const int32 RoomB = Graph->FindRoom(B);
+		if (RoomA != INDEX_NONE && RoomB != INDEX_NONE)
+		{
+			bOutSameRoom = RoomA == RoomB;
+			return true;
+		}
+	}
+	return false;
+}
+
+void USensingSubsystem::RegisterIlluminationData(USensingIlluminationData* Data)
+{
+	if (Data != nullptr)
+	{
+		IlluminationData.AddUnique(Data);
+	}
+}
+
+void USensingSubsystem::UnregisterIlluminationData(USensingIlluminationData* Data)
+{
+	IlluminationData.Remove(Data);
+}
+
+float USensingSubsystem::GetIllumination(const FVector& Location) const
+{
+	float Illumination = 1.f;
+	for (const USensingIlluminationData* Data : IlluminationData)
+	{
+		if (Data->GetIllumination(Location, Illumination))
+		{
+			break;
+		}
+	}
+	return Illumination;
+}
+
+void USensingSubsystem::RecordVisibilityCacheLookup(bool bHit)
+{
+	if (bHit)
+	{
+		++VisibilityCacheHits;
+	}
+	else
+	{
+		++VisibilityCacheMisses;
+	}
+}
+
+float USensingSubsystem::GetVisibilityCacheHitRate() const
+{
+	const uint64 Lookups = VisibilityCacheHits + VisibilityCacheMisses;
+	return Lookups > 0 ? (float)((double)VisibilityCacheHits / (double)Lookups) : 0.f;
+}
+
+void USensingSubsystem::ResetVisibilityCacheStats()
+{
+	VisibilityCacheHits = 0;
+	VisibilityCacheMisses = 0;
+}
+
+void USensingSubsystem::GatherPawnsInRadius(const FVector& Center, float Radius, TArray<APawn*>& OutPawns)
+{
+	if (!bPawnGridInitialized)
+	{
+		InitializePawnGrid();
+	}
+
+	PawnGrid.Query(Center, Radius, OutPawns);
+}
+
+void USensingSubsystem::RegisterSensor(UMovablePawnSensingComponent* Sensor)
+{
+	if (Sensor == nullptr || Sensors.Contains(Sensor))
+	{
+		return;
+	}
+
+	Sensors.Add(Sensor);
+
+	USignificanceManager* SignificanceManager = FSignificanceManagerModule::Get(GetWorld());
+	if (Sensor->bUseSignificanceLOD && SignificanceManager != nullptr)
+	{
+		auto SignificanceFunction = [this](USignificanceManager::FManagedObjectInfo* ObjectInfo, const FTransform& Viewpoint)
+		{
+			return GetSensorSignificance(CastChecked<UMovablePawnSensingComponent>(ObjectInfo->GetObject()), Viewpoint);
+		};
+
+		auto PostSignificanceFunction = [this](USignificanceManager::FManagedObjectInfo* ObjectInfo, float OldSignificance, float Significance, bool bFinal)
+		{
+			// The final call comes from UnregisterSensor(), when the sensor is going away anyway.
+			if (!bFinal)
+			{
+				CastChecked<UMovablePawnSensingComponent>(ObjectInfo->GetObject())->SetSensingLOD(GetSensingLODForSignificance(Significance));
+			}
+		};
+
+		// Sequential, as changing the LOD reschedules the sensor.
+		SignificanceManager->RegisterObject(Sensor, SensingSignificanceTag, SignificanceFunction, USignificanceManager::EPostSignificanceType::Sequential, PostSignificanceFunction);
+	}
+}
+
+void USensingSubsystem::UnregisterSensor(UMovablePawnSensingComponent* Sensor)
+{
+	const int32 Index = Sensors.IndexOfByKey(Sensor);
+	if (Index == INDEX_NONE)
+	{
+		return;
+	}
+
+	Sensor->bSensingUpdatePending = false;
+
+	if (USignificanceManager* SignificanceManager = FSignificanceManagerModule::Get(GetWorld()))
+	{
+		SignificanceManager->UnregisterObject(Sensor);
+	}
+
+	if (bIsUpdatingSensors)
+	{
+		// Don't shift entries under the round-robin, just drop the pointer and clean up after the update.
+		Sensors[Index] = nullptr;
+		bNeedsCompaction = true;
+	}
+	else
+	{
+		Sensors.RemoveAt(Index);
+		if (Index < NextSensorIndex)
+		{
+			--NextSensorIndex;
+		}
+	}
+}
+
+void USensingSubsystem::CompactSensors()
+{
+	for (int32 Index = Sensors.Num() - 1; Index >= 0; --Index)
+	{
+		if (!Sensors[Index].IsValid())
+		{
+			Sensors.RemoveAt(Index);
+			if (Index < NextSensorIndex)
+			{
+				--NextSensorIndex;
+			}
+		}
+	}
+	bNeedsCompaction = false;
+}
+
+void USensingSubsystem::ScheduleSensor(UMovablePawnSensingComponent* Sensor, const float TimeDelay)
+{
+	if (Sensor == nullptr)
+	{
+		return;
+	}
+
+	if (TimeDelay <= 0.f)
+	{
+		Sensor->bSensingUpdatePending = false;
+		return;
+	}
+
+	const double Now = GetWorld()->GetTimeSeconds();
+	Sensor->SensingScheduledTime = Now;
+	Sensor->NextSensingUpdateTime = Now + TimeDelay;
+	Sensor->bSensingUpdatePending = true;
+}
+
+float USensingSubsystem::GetSensorElapsedTime(const UMovablePawnSensingComponent* Sensor) const
+{
+	if (Sensor == nullptr || !Sensor->bSensingUpdatePending)
+	{
+		return -1.f;
+	}
+
+	return (float)(GetWorld()->GetTimeSeconds() - Sensor->SensingScheduledTime);
+}
+
+uint32 USensingSubsystem::GetSamplingHash(const UObject* A, const UObject* B) const
+{
+	uint32 Hash = A ? FCrc::StrCrc32(*A->GetPathName(), (uint32)SensingSeed) : (uint32)SensingSeed;
+	if (B != nullptr)
+	{
+		Hash = FCrc::StrCrc32(*B->GetPathName(), Hash);
+	}
+	return Hash;
+}
+
+void USensingSubsystem::SetSensingSeed(const int32 NewSeed)
+{
+	SensingSeed = NewSeed;
+}
+
+void USensingSubsystem::SetSensingBudget(const float NewBudgetMicroseconds)
+{
+	SensingBudgetMicroseconds = NewBudgetMicroseconds;
+}
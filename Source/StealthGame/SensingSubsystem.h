@@ -0,0 +1,425 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "CollisionQueryParams.h"
+#include "SensingCulling.h"
+#include "SensingPawnGrid.h"
+#include "SensingNoiseBus.h"
+#include "SensingSubsystem.generated.h"
+
+class APawn;
+class UMovablePawnSensingComponent;
+class UPrimitiveComponent;
+class USensingVisibilityData;
+class USensingRoomGraph;
+class USensingIlluminationData;
+enum class ESensingLOD : uint8;
+
+/**
+ * Owns every UMovablePawnSensingComponent in a world and runs their sensing updates from a single tick.
+ * Sensors are visited round-robin, and the tick stops as soon as SensingBudgetMicroseconds has been spent,
+ * so sensing cost per frame stays flat no matter how many sensors a level has. Sensors that were due but
+ * did not fit in the budget are the first ones visited on the next frame.
+ *
+ * With bParallelSensingTraces, sensors only gather what they need to trace during their update. The traces of every sensor
+ * updated this frame are then run together across worker threads, and their results handed back in order on the game thread.
+ */
+UCLASS(config = Game)
+class STEALTHGAME_API USensingSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	USensingSubsystem();
+
+	//~ Begin USubsystem Interface.
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	//~ End USubsystem Interface.
+
+	//~ Begin FTickableGameObject Interface.
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	//~ End FTickableGameObject Interface.
+
+	/** Adds a sensor to the round-robin. The sensor will not update until it is scheduled with ScheduleSensor(). */
+	void RegisterSensor(UMovablePawnSensingComponent* Sensor);
+
+	/** Removes a sensor from the round-robin. Safe to call from within a sensor's own update. */
+	void UnregisterSensor(UMovablePawnSensingComponent* Sensor);
+
+	/** Schedules the next update of Sensor in TimeDelay seconds. A value <= 0 unschedules the sensor. */
+	void ScheduleSensor(UMovablePawnSensingComponent* Sensor, const float TimeDelay);
+
+	/** Returns the time elapsed since Sensor was last scheduled, or -1 if it has no pending update. */
+	float GetSensorElapsedTime(const UMovablePawnSensingComponent* Sensor) const;
+
+	/**
+	 * Appends every pawn in the spatial grid cells overlapped by the given sphere.
+	 * The grid is built from the world's pawns on first use and kept up to date every frame after that.
+	 */
+	void GatherPawnsInRadius(const FVector& Center, float Radius, TArray<APawn*>& OutPawns);
+
+	/**
+	 * Pushes a noise to the sensors that use noise events. Every AActor::MakeNoise() call in the world ends up here,
+	 * call it directly only for noises that should not reach the pawn noise emitters.
+	 */
+	void ReportNoiseEvent(const FSensingNoiseEvent& Event);
+
+	/**
+	 * Appends the noise events newer than SinceId that a sensor at Center with the given hearing range could hear,
+	 * oldest first. Returns the id to pass as SinceId next time.
+	 */
+	uint32 GatherNoiseEvents(const FVector& Center, float HearingRange, uint32 SinceId, TArray<const FSensingNoiseEvent*>& OutEvents) const;
+
+	/** Id of the newest noise event, sensors start listening from here. */
+	uint32 GetLastNoiseEventId() const { return NoiseBus.GetLastId(); }
+
+	/**
+	 * Returns the current dynamic occluder generation. It is bumped every time a movable primitive that blocks
+	 * ECC_Visibility moves, appears, has its collision switched on or off, or is destroyed. Store it alongside a cached trace result and pass it back to
+	 * IsSegmentUnchanged() to find out whether the result still holds.
+	 */
+	uint32 GetOccluderGeneration();
+
+	/** Returns true if no dynamic occluder has changed across the segment from Start to End since SinceGeneration. */
+	bool IsSegmentUnchanged(const FVector& Start, const FVector& End, uint32 SinceGeneration);
+
+	/** Returns true if no dynamic occluder has changed within Bounds since SinceGeneration. */
+	bool IsRegionUnchanged(const FBox& Bounds, uint32 SinceGeneration);
+
+	/** Makes a baked potentially visible set available to IsPotentiallyVisible(). Called by ASensingVisibilityVolume. */
+	void RegisterVisibilityData(USensingVisibilityData* Data);
+
+	void UnregisterVisibilityData(USensingVisibilityData* Data);
+
+	/**
+	 * Returns false if a baked potentially visible set proves that static geometry blocks every line between From and To,
+	 * in which case a line of sight or occlusion trace between them can be skipped. Returns true if nothing is known.
+	 */
+	bool IsPotentiallyVisible(const FVector& From, const FVector& To) const;
+
+	/** Makes a baked room graph available to GetPropagatedSoundDistance(). Called by ASensingVisibilityVolume. */
+	void RegisterRoomGraph(USensingRoomGraph* Graph);
+
+	void UnregisterRoomGraph(USensingRoomGraph* Graph);
+
+	/**
+	 * Length of the path a sound takes from From to To through the rooms and portals of a baked room graph.
+	 * @return false if no room graph covers both locations, in which case nothing is known.
+	 */
+	bool GetPropagatedSoundDistance(const FVector& From, const FVector& To, float& OutDistance) const;
+
+	/** @return false if no room graph covers both locations, otherwise bOutSameRoom tells whether they are in the same room. */
+	bool IsInSameRoom(const FVector& A, const FVector& B, bool& bOutSameRoom) const;
+
+	/** Makes baked light levels available to GetIllumination(). Called by ASensingVisibilityVolume. */
+	void RegisterIlluminationData(USensingIlluminationData* Data);
+
+	void UnregisterIlluminationData(USensingIlluminationData* Data);
+
+	/** Baked light level at Location, from 0 in complete darkness to 1 when fully lit. Unbaked locations count as fully lit. */
+	UFUNCTION(BlueprintCallable, Category = "AI|Sensing")
+		float GetIllumination(const FVector& Location) const;
+
+	/** Returns true if any baked light levels are loaded. */
+	UFUNCTION(BlueprintCallable, Category = "AI|Sensing")
+		bool HasIlluminationData() const { return IlluminationData.Num() > 0; }
+
+	/** Adds a visibility cache lookup to the world-wide hit rate. */
+	void RecordVisibilityCacheLookup(bool bHit);
+
+	/** Fraction of the visibility cache lookups of every sensor that reused a previous trace result. */
+	UFUNCTION(BlueprintCallable, Category = "AI|Sensing")
+		float GetVisibilityCacheHitRate() const;
+
+	UFUNCTION(BlueprintCallable, Category = "AI|Sensing")
+		void ResetVisibilityCacheStats();
+
+	/**
+	 * Significance of Sensor to a player looking from Viewpoint, from 0 (irrelevant) to 1. Falls off with distance, and is
+	 * scaled down for sensors on another floor or walled off from the viewpoint. Sensors on screen are always fully significant.
+	 * Called by the SignificanceManager, possibly from worker threads.
+	 */
+	float GetSensorSignificance(const UMovablePawnSensingComponent* Sensor, const FTransform& Viewpoint) const;
+
+	/** Sensing LOD a sensor of the given significance should run at. */
+	ESensingLOD GetSensingLODForSignificance(float Significance) const;
+
+	/**
+	 * Returns a hash of A and B (B may be null) mixed with SensingSeed. Used wherever sensing would otherwise be random,
+	 * so that a run can be reproduced by reusing the seed. Objects are identified by path name, which is stable across runs.
+	 */
+	uint32 GetSamplingHash(const UObject* A, const UObject* B) const;
+
+	/** Changes the seed of the sensing sampling schedules. Only affects sensors and targets that start being sensed after the call. */
+	UFUNCTION(BlueprintCallable, Category = "AI|Sensing")
+		void SetSensingSeed(const int32 NewSeed);
+
+	UFUNCTION(BlueprintCallable, Category = "AI|Sensing")
+		int32 GetSensingSeed() const { return SensingSeed; }
+
+	/** Changes the per-frame sensing budget. A value <= 0 removes the budget and updates every due sensor each frame. */
+	UFUNCTION(BlueprintCallable, Category = "AI|Sensing")
+		void SetSensingBudget(const float NewBudgetMicroseconds);
+
+	UFUNCTION(BlueprintCallable, Category = "AI|Sensing")
+		float GetSensingBudget() const { return SensingBudgetMicroseconds; }
+
+	UFUNCTION(BlueprintCallable, Category = "AI|Sensing")
+		int32 GetNumRegisteredSensors() const { return Sensors.Num(); }
+
+	/** Number of sensor updates run since the subsystem was created. */
+	uint64 GetNumSensorUpdates() const { return NumSensorUpdates; }
+
+	/** True while sensors are updating and their traces are collected for the parallel trace phase rather than run right away. */
+	bool IsDeferringTraces() const { return bDeferringTraces; }
+
+	/**
+	 * Queues a visibility channel test trace for the parallel trace phase of this frame. Sensor->OnTraceCompleted(RequestId, ...)
+	 * is called with the result on the game thread, in the order the traces were deferred. Only valid while IsDeferringTraces().
+	 */
+	void DeferTrace(UMovablePawnSensingComponent* Sensor, uint32 RequestId, const FVector& Start, const FVector& End, const FCollisionQueryParams& Params);
+
+protected:
+
+	/** Microseconds of sensing work allowed per frame. At least one due sensor is always updated so nothing starves. */
+	UPROPERTY(config)
+		float SensingBudgetMicroseconds;
+
+	/**
+	 * If true, the distance and peripheral vision tests of every sensor due this frame are run against the players
+	 * in one vectorized batch (see SensingCulling::CullSightPairs), instead of pair by pair in CouldSeePawn().
+	 * Sensors that override CouldSeePawn() should turn this off.
+	 */
+	UPROPERTY(config)
+		bool bBatchSightCulling;
+
+	/**
+	 * If true, the line of sight and hearing occlusion traces of the sensors updated in a frame are run together across worker
+	 * threads once they have all updated, instead of one after the other during each update. Notifications still arrive
+	 * within the same frame. The sensing budget then only covers the game thread part of the updates.
+	 */
+	UPROPERTY(config)
+		bool bParallelSensingTraces;
+
+	/** Frames with fewer deferred traces than this run them on the game thread, where they are not worth waking the workers for. */
+	UPROPERTY(config)
+		int32 MinParallelSensingTraces;
+
+	/** Seed of the sight sampling schedules and update staggering of every sensor. */
+	UPROPERTY(config)
+		int32 SensingSeed;
+
+	/** Size of the cells of the pawn spatial grid used by sensors that sense more than just players. */
+	UPROPERTY(config)
+		float PawnGridCellSize;
+
+	/** Sensors further than this from every player are insignificant, and suspended. */
+	UPROPERTY(config)
+		float SignificanceDistance;
+
+	/** Sensors more than this far above or below a player are considered to be on another floor. */
+	UPROPERTY(config)
+		float SignificanceFloorHeight;
+
+	/** Significance is scaled by this for sensors on another floor than the player. */
+	UPROPERTY(config)
+		float OtherFloorSignificanceScale;
+
+	/** Significance is scaled by this for sensors in another room than the player, or that the baked potentially visible set shows are walled off. */
+	UPROPERTY(config)
+		float OccludedSignificanceScale;
+
+	/** Sensors at least this significant run at ESensingLOD::Full. */
+	UPROPERTY(config)
+		float FullSensingSignificance;
+
+	/** Sensors at least this significant run at ESensingLOD::Reduced. Less significant ones only hear, and are suspended at 0. */
+	UPROPERTY(config)
+		float ReducedSensingSignificance;
+
+	/** Seconds between two significance updates. A value <= 0 updates significance every frame. */
+	UPROPERTY(config)
+		float SignificanceUpdateInterval;
+
+	/** Seconds a noise event is kept for sensors that have not updated since it was made. Should cover the longest sensing interval. */
+	UPROPERTY(config)
+		float NoiseEventLifetime;
+
+	/** Noise events kept at most, the oldest are dropped first. */
+	UPROPERTY(config)
+		int32 MaxNoiseEvents;
+
+	/** Size of the cells noise events are bucketed in. */
+	UPROPERTY(config)
+		float NoiseBucketCellSize;
+
+	/** Number of dynamic occluder changes remembered. Cached trace results older than the oldest remembered change are discarded. */
+	UPROPERTY(config)
+		int32 MaxOccluderChanges;
+
+	/** Distance a dynamic occluder's bounds have to move before cached trace results across it are discarded. */
+	UPROPERTY(config)
+		float OccluderMoveTolerance;
+
+private:
+
+	/** Drops sensors that were unregistered while we were iterating. */
+	void CompactSensors();
+
+	/** Fills the pawn grid from the world and starts tracking spawned pawns. */
+	void InitializePawnGrid();
+
+	/** Replacement for AActor::MakeNoiseImpl: feeds the pawn noise emitters like the engine does, and the noise bus of the instigator's world. */
+	static void MakeNoise(AActor* NoiseMaker, float Loudness, APawn* NoiseInstigator, const FVector& NoiseLocation, float MaxRange, FName Tag);
+
+	/** Starts tracking the movable primitives of the world that block visibility traces. */
+	void InitializeOccluderTracking();
+
+	/** Starts listening for spawned actors, to add them to the pawn grid. */
+	void AddActorSpawnedHandler();
+
+	void OnActorSpawned(AActor* Actor);
+
+	/** True if Primitive currently blocks the visibility traces of the sensors. */
+	static bool BlocksSensingTraces(const UPrimitiveComponent& Primitive);
+
+	/** Listens for collision changes of Primitive if it is movable, and tracks it right away if it blocks visibility traces. Used while building DynamicOccluders. */
+	void WatchOccluderCandidate(UPrimitiveComponent& Primitive);
+
+	/** Starts or stops tracking Primitive after it registered or its collision changed, and records the change if it did. */
+	void UpdateOccluderCandidate(UPrimitiveComponent* Primitive);
+
+	/**
+	 * Called whenever a component of any world creates its physics state: when it registers (including components of
+	 * deferred spawns and components added at runtime) and when its collision is switched on.
+	 */
+	void OnComponentPhysicsStateCreated(UActorComponent* Component);
+
+	/** Compares every tracked occluder's bounds against the last frame and records the ones that changed. */
+	void UpdateDynamicOccluders();
+
+	/** Bumps the occluder generation and remembers that the space in Bounds changed. */
+	void RecordOccluderChange(const FBox& Bounds);
+
+	/** Feeds the players' viewpoints to the SignificanceManager, which in turn sets the sensing LOD of every sensor. */
+	void UpdateSignificance(double Now);
+
+	/** Cone culls every due sensor against the player pawns and hands each sensor its surviving targets. */
+	void BatchCullSight();
+
+	/** Runs the deferred traces across worker threads and hands their results back, until the results stop deferring more. */
+	void RunDeferredTraces();
+
+	/** Everything a deferred trace needs, copied out of the sensor so the workers never touch it. */
+	struct FDeferredTrace
+	{
+		TWeakObjectPtr<UMovablePawnSensingComponent> Sensor;
+		uint32 RequestId;
+		FVector Start;
+		FVector End;
+		FCollisionQueryParams Params;
+	};
+
+	/** Traces deferred since the last parallel trace phase. */
+	TArray<FDeferredTrace> DeferredTraces;
+
+	// Scratch data for RunDeferredTraces(). The workers only ever read TracesInFlight and write their own TraceResults slot.
+	TArray<FDeferredTrace> TracesInFlight;
+	TArray<uint8> TraceResults;
+
+	/** True while sensor updates defer their traces, see IsDeferringTraces(). */
+	bool bDeferringTraces;
+
+	/** Every registered sensor, visited in order starting at NextSensorIndex. */
+	TArray<TWeakObjectPtr<UMovablePawnSensingComponent>> Sensors;
+
+	/** Indices into Sensors of the sensors due this frame, in update order. */
+	TArray<int32> DueSensorSlots;
+
+	// Scratch data for BatchCullSight(), kept around to avoid reallocating every frame.
+	FSensingCullSensors BatchSensors;
+	FSensingCullTargets BatchTargets;
+	TArray<FSensingCullPair> BatchSurvivors;
+	TArray<UMovablePawnSensingComponent*> BatchSensorList;
+	TArray<APawn*> BatchTargetPawns;
+
+	/** Noise events of the last NoiseEventLifetime seconds. */
+	FSensingNoiseBus NoiseBus;
+
+	/** Pawns bucketed by location, for sensors that don't only sense players. */
+	FSensingPawnGrid PawnGrid;
+
+	/** True once PawnGrid has been filled, it is only built if a sensor needs it. */
+	bool bPawnGridInitialized;
+
+	struct FDynamicOccluder
+	{
+		TWeakObjectPtr<UPrimitiveComponent> Component;
+		FBox Bounds;
+	};
+
+	struct FOccluderChange
+	{
+		FBox Bounds;
+		uint32 Generation;
+	};
+
+	/** Potentially visible sets of the loaded levels. */
+	UPROPERTY(Transient)
+		TArray<USensingVisibilityData*> VisibilityData;
+
+	/** Room graphs of the loaded levels. */
+	UPROPERTY(Transient)
+		TArray<USensingRoomGraph*> RoomGraphs;
+
+	/** Light levels of the loaded levels. */
+	UPROPERTY(Transient)
+		TArray<USensingIlluminationData*> IlluminationData;
+
+	/** Movable primitives that block ECC_Visibility, with their bounds as of the last update. */
+	TArray<FDynamicOccluder> DynamicOccluders;
+
+	/** Recent occluder changes, oldest first. At most MaxOccluderChanges entries. */
+	TArray<FOccluderChange> OccluderChanges;
+
+	/** Generation of the last recorded occluder change. */
+	uint32 OccluderGeneration;
+
+	/** Generation of the newest change that was dropped from OccluderChanges. Results cached before it can't be validated. */
+	uint32 ForgottenOccluderGeneration;
+
+	/** True once DynamicOccluders has been filled, it is only built if a sensor uses the visibility cache. */
+	bool bOccluderTrackingInitialized;
+
+	uint64 VisibilityCacheHits;
+	uint64 VisibilityCacheMisses;
+
+	FDelegateHandle ActorSpawnedHandle;
+	FDelegateHandle PhysicsStateCreatedHandle;
+
+	/** Scratch array of the players' viewpoints, for UpdateSignificance(). */
+	TArray<FTransform> SignificanceViewpoints;
+
+	double LastSignificanceUpdateTime;
+
+	/** Where the round-robin resumes next frame. */
+	int32 NextSensorIndex;
+
+	uint64 NumSensorUpdates;
+
+	/** True while Tick() is running sensor updates, so unregistration must not reshuffle the array. */
+	bool bIsUpdatingSensors;
+
+	/** True if a sensor was unregistered during the update and Sensors contains stale entries. */
+	bool bNeedsCompaction;
+};
@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "GameFramework/Character.h"
+#include "UObject/UObjectGlobals.h"
+
+/** A game world of its own for automation tests, so they neither depend on nor disturb whatever map is loaded. Time only advances through Step(). */
+class FSensingTestWorld
+{
+public:
+	FSensingTestWorld()
+	{
+		World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("SensingTestWorld"));
+		FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+		WorldContext.SetCurrentWorld(World);
+		World->InitializeActorsForPlay(FURL());
+	}
+
+	~FSensingTestWorld()
+	{
+		GEngine->DestroyWorldContext(World);
+		World->DestroyWorld(false);
+		CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+	}
+
+	UWorld* Get() const { return World; }
+
+	void Step(float DeltaTime)
+	{
+		World->TimeSeconds += DeltaTime;
+		World->RealTimeSeconds += DeltaTime;
+	}
+
+	/** Spawns an actor whose root is a new component of the given class, registered along with its subobjects. */
+	template<typename ComponentType>
+	ComponentType* SpawnComponentActor(const FTransform& Transform, TFunctionRef<void(ComponentType*)> Setup)
+	{
+		AActor* Actor = World->SpawnActorDeferred<AActor>(AActor::StaticClass(), Transform);
+		ComponentType* Component = NewObject<ComponentType>(Actor);
+		Actor->SetRootComponent(Component);
+		Actor->AddInstanceComponent(Component);
+		Setup(Component);
+		Actor->FinishSpawning(Transform);
+		return Component;
+	}
+
+	ACharacter* SpawnCharacter(const FVector& Location)
+	{
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		return World->SpawnActor<ACharacter>(ACharacter::StaticClass(), Location, FRotator::ZeroRotator, SpawnParams);
+	}
+
+private:
+	UWorld* World;
+};
+
+#endif
@@ -0,0 +1,201 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SensingVisibilityData.h"
+
+USensingVisibilityData::USensingVisibilityData()
+{
+	Origin = FVector::ZeroVector;
+	CellSize = 200.f;
+	Dimensions = FIntVector::ZeroValue;
+}
+
+int32 USensingVisibilityData::GetCellIndex(const FVector& Location) const
+{
+	const FVector Local = (Location - Origin) / CellSize;
+	const FIntVector Coordinates(FMath::FloorToInt(Local.X), FMath::FloorToInt(Local.Y), FMath::FloorToInt(Local.Z));
+	return GetCellIndex(Coordinates);
+}
+
+int32 USensingVisibilityData::GetCellIndex(const FIntVector& Coordinates) const
+{
+	if (Coordinates.X < 0 || Coordinates.Y < 0 || Coordinates.Z < 0
+		|| Coordinates.X >= Dimensions.X || Coordinates.Y >= Dimensions.Y || Coordinates.Z >= Dimensions.Z)
+	{
+		return INDEX_NONE;
+	}
+
+	return (Coordinates.Z * Dimensions.Y + Coordinates.Y) * Dimensions.X + Coordinates.X;
+}
+
+FIntVector USensingVisibilityData::GetCellCoordinates(int32 Cell) const
+{
+	return FIntVector(Cell % Dimensions.X, (Cell / Dimensions.X) % Dimensions.Y, Cell / (Dimensions.X * Dimensions.Y));
+}
+
+FVector USensingVisibilityData::GetCellCenter(int32 Cell) const
+{
+	const FIntVector Coordinates = GetCellCoordinates(Cell);
+	return Origin + (FVector(Coordinates.X, Coordinates.Y, Coordinates.Z) + 0.5f) * CellSize;
+}
+
+int32 USensingVisibilityData::GetPairBit(int32 CellA, int32 CellB) const
+{
+	// Row CellA of the strict upper triangle starts after the (NumCells - 1) + (NumCells - 2) + ... entries of the rows above it.
+	const int64 NumCells = GetNumCells();
+	const int64 A = CellA;
+	return (int32)(A * NumCells - A * (A + 1) / 2 + (CellB - CellA - 1));
+}
+
+bool USensingVisibilityData::IsCellSolid(int32 Cell) const
+{
+	return (SolidBits[Cell >> 5] & (1u << (Cell & 31))) != 0;
+}
+
+bool USensingVisibilityData::AreCellsPotentiallyVisible(int32 CellA, int32 CellB) const
+{
+	if (CellA == CellB)
+	{
+		return true;
+	}
+
+	const int32 Bit = CellA < CellB ? GetPairBit(CellA, CellB) : GetPairBit(CellB, CellA);
+	return (VisibilityBits[Bit >> 5] & (1u << (Bit & 31))) != 0;
+}
+
+bool USensingVisibilityData::IsPotentiallyVisible(const FVector& A, const FVector& B) const
+{
+	if (!IsBaked())
+	{
+		return true;
+	}
+
+	const int32 CellA = GetCellIndex(A);
+	const int32 CellB = GetCellIndex(B);
+	if (CellA == INDEX_NONE || CellB == INDEX_NONE)
+	{
+		return true;
+	}
+
+	// Nothing was baked for cells without free space, so a location that ends up in one (e.g. clipping into a wall) proves nothing.
+	if (IsCellSolid(CellA) || IsCellSolid(CellB))
+	{
+		return true;
+	}
+
+	return AreCellsPotentiallyVisible(CellA, CellB);
+}
+
+#if WITH_EDITOR
+void USensingVisibilityData::ResetGrid(const FBox& Bounds, float InCellSize)
+{
+	CellSize = FMath::Max(InCellSize, 1.f);
+	Origin = Bounds.Min;
+
+	const FVector Size = Bounds.GetSize();
+	Dimensions = FIntVector(
+		FMath::Max(FMath::CeilToInt(Size.X / CellSize), 1),
+		FMath::Max(FMath::CeilToInt(Size.Y / CellSize), 1),
+		FMath::Max(FMath::CeilToInt(Size.Z / CellSize), 1));
+
+	const int64 NumCells = GetNumCells();
+	const int64 NumPairs = NumCells * (NumCells - 1) / 2;
+
+	VisibilityBits.Reset();
+	VisibilityBits.SetNumZeroed((int32)((NumPairs + 31) / 32));
+	SolidBits.Reset();
+	SolidBits.SetNumZeroed((int32)((NumCells + 31) / 32));
+}
+
+void USensingVisibilityData::SetCellsVisible(int32 CellA, int32 CellB)
+{
+	if (CellA == CellB)
+	{
+		return;
+	}
+
+	const int32 Bit = CellA < CellB ? GetPairBit(CellA, CellB) : GetPairBit(CellB, CellA);
+	VisibilityBits[Bit >> 5] |= 1u << (Bit & 31);
+}
+
+void USensingVisibilityData::SetCellSolid(int32 Cell)
+{
+	SolidBits[Cell >> 5] |= 1u << (Cell & 31);
+}
+
+void USensingVisibilityData::ClearGrid()
+{
+	Dimensions = FIntVector::ZeroValue;
+	VisibilityBits.Empty();
+	SolidBits.Empty();
+}
+
+void USensingVisibilityData::DilateVisibility()
+{
+	const TArray<uint32> BakedBits = VisibilityBits;
+	const int32 NumCells = GetNumCells();
+
+	TArray<int32, TInlineAllocator<27>> NeighborsA;
+	TArray<int32, TInlineAllocator<27>> NeighborsB;
+	auto GatherNeighbors = [this](int32 Cell, TArray<int32, TInlineAllocator<27>>& OutNeighbors)
+	{
+		OutNeighbors.Reset();
+		const FIntVector Coordinates = GetCellCoordinates(Cell);
+		for (int32 DZ = -1; DZ <= 1; ++DZ)
+		{
+			for (int32 DY = -1; DY <= 1; ++DY)
+			{
+				for (int32 DX = -1; DX <= 1; ++DX)
+				{
+					const int32 Neighbor = GetCellIndex(Coordinates + FIntVector(DX, DY, DZ));
+					if (Neighbor != INDEX_NONE && Neighbor != Cell)
+					{
+						OutNeighbors.Add(Neighbor);
+					}
+				}
+			}
+		}
+	};
+
+	// Pairs are stored row by row, so walking the upper triangle in order visits the bits in order.
+	int32 Bit = 0;
+	for (int32 CellA = 0; CellA < NumCells; ++CellA)
+	{
+		GatherNeighbors(CellA, NeighborsA);
+		for (int32 CellB = CellA + 1; CellB < NumCells; ++CellB, ++Bit)
+		{
+			if ((BakedBits[Bit >> 5] & (1u << (Bit & 31))) == 0)
+			{
+				continue;
+			}
+
+			GatherNeighbors(CellB, NeighborsB);
+			for (const int32 Neighbor : NeighborsB)
+			{
+				SetCellsVisible(CellA, Neighbor);
+			}
+			for (const int32 Neighbor : NeighborsA)
+			{
+				SetCellsVisible(Neighbor, CellB);
+			}
+		}
+	}
+}
+
+float USensingVisibilityData::GetOccludedPairFraction() const
+{
+	const int64 NumCells = GetNumCells();
+	const int64 NumPairs = NumCells * (NumCells - 1) / 2;
+	if (NumPairs == 0)
+	{
+		return 0.f;
+	}
+
+	int64 NumVisible = 0;
+	for (const uint32 Word : VisibilityBits)
+	{
+		NumVisible += FMath::CountBits(Word);
+	}
+	return 1.f - (float)((double)NumVisible / (double)NumPairs);
+}
+#endif
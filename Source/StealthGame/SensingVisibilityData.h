@@ -0,0 +1,87 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "SensingVisibilityData.generated.h"
+
+/**
+ * Baked potentially visible set of a box of space, see ASensingVisibilityVolume.
+ * The box is cut into cubic cells, and one bit per pair of cells tells whether any static line of sight may exist between them.
+ * Only the upper triangle of the pair matrix is stored, visibility is symmetric and a cell always sees itself.
+ */
+UCLASS(BlueprintType)
+class STEALTHGAME_API USensingVisibilityData : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	USensingVisibilityData();
+
+	/**
+	 * Returns false only if static geometry blocks every line between the cells containing A and B.
+	 * Locations outside the baked box, or in cells that are entirely inside geometry, are always potentially visible.
+	 */
+	bool IsPotentiallyVisible(const FVector& A, const FVector& B) const;
+
+	/** Returns the index of the cell containing Location, or INDEX_NONE if it is outside the baked box. */
+	int32 GetCellIndex(const FVector& Location) const;
+
+	bool AreCellsPotentiallyVisible(int32 CellA, int32 CellB) const;
+
+	bool IsCellSolid(int32 Cell) const;
+
+	int32 GetNumCells() const { return Dimensions.X * Dimensions.Y * Dimensions.Z; }
+
+	bool IsBaked() const { return GetNumCells() > 0 && VisibilityBits.Num() > 0; }
+
+	FIntVector GetCellCoordinates(int32 Cell) const;
+
+	int32 GetCellIndex(const FIntVector& Coordinates) const;
+
+	FVector GetCellCenter(int32 Cell) const;
+
+	float GetCellSize() const { return CellSize; }
+
+#if WITH_EDITOR
+	/** Clears the data and lays out an empty grid of InCellSize cells covering Bounds. Every pair starts out occluded. */
+	void ResetGrid(const FBox& Bounds, float InCellSize);
+
+	void SetCellsVisible(int32 CellA, int32 CellB);
+
+	void SetCellSolid(int32 Cell);
+
+	/** Empties the grid, leaving every location potentially visible. */
+	void ClearGrid();
+
+	/** Marks each cell as potentially visible from the neighbors of every cell it is potentially visible from. */
+	void DilateVisibility();
+
+	/** Fraction of the pairs of cells that are occluded. */
+	float GetOccludedPairFraction() const;
+#endif
+
+protected:
+	/** Bit of the pair (CellA, CellB) in VisibilityBits, CellA must be less than CellB. */
+	int32 GetPairBit(int32 CellA, int32 CellB) const;
+
+	/** World location of the minimum corner of cell (0, 0, 0). */
+	UPROPERTY(VisibleAnywhere, Category = Sensing)
+		FVector Origin;
+
+	UPROPERTY(VisibleAnywhere, Category = Sensing)
+		float CellSize;
+
+	/** Number of cells along each axis. */
+	UPROPERTY(VisibleAnywhere, Category = Sensing)
+		FIntVector Dimensions;
+
+	/** One bit per pair of distinct cells, set if the pair is potentially visible. */
+	UPROPERTY()
+		TArray<uint32> VisibilityBits;
+
+	/** One bit per cell, set if the cell has no free space at all. */
+	UPROPERTY()
+		TArray<uint32> SolidBits;
+};
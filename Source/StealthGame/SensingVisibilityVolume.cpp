@@ -0,0 +1,453 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SensingVisibilityVolume.h"
+#include "StealthGame.h"
+#include "SensingVisibilityData.h"
+#include "SensingRoomGraph.h"
+#include "SensingRoomVolume.h"
+#include "SensingIlluminationData.h"
+#include "SecurityCamera.h"
+#include "SensingSubsystem.h"
+#include "Components/BrushComponent.h"
+#include "Components/DirectionalLightComponent.h"
+#include "Components/PointLightComponent.h"
+#include "Components/SpotLightComponent.h"
+#include "Engine/CollisionProfile.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "CollisionQueryParams.h"
+#include "Misc/ScopedSlowTask.h"
+
+ASensingVisibilityVolume::ASensingVisibilityVolume()
+{
+	// The volume only marks out the baked region, it must not get in the way of anything.
+	GetBrushComponent()->SetCollisionProfileName(UCollisionProfile::NoCollision_ProfileName);
+
+	VisibilityData = nullptr;
+	CellSize = 200.f;
+	SamplesPerCell = 5;
+	MaxBakeDistance = 6000.f;
+	MaxCells = 8192;
+	RoomGraph = nullptr;
+	PortalTolerance = 50.f;
+	PortalDistancePenalty = 200.f;
+	IlluminationData = nullptr;
+	IlluminationCellSize = 100.f;
+	FullyLitBrightness = 5000.f;
+	DirectionalShadowDistance = 50000.f;
+	MaxIlluminationPoints = 4 * 1024 * 1024;
+}
+
+void ASensingVisibilityVolume::BeginPlay()
+{
+	Super::BeginPlay();
+
+	USensingSubsystem* SensingSubsystem = GetWorld()->GetSubsystem<USensingSubsystem>();
+	if (SensingSubsystem != nullptr && VisibilityData != nullptr)
+	{
+		SensingSubsystem->RegisterVisibilityData(VisibilityData);
+	}
+	if (SensingSubsystem != nullptr && RoomGraph != nullptr)
+	{
+		SensingSubsystem->RegisterRoomGraph(RoomGraph);
+	}
+	if (SensingSubsystem != nullptr && IlluminationData != nullptr)
+	{
+		SensingSubsystem->RegisterIlluminationData(IlluminationData);
+	}
+}
+
+void ASensingVisibilityVolume::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	USensingSubsystem* SensingSubsystem = GetWorld()->GetSubsystem<USensingSubsystem>();
+	if (SensingSubsystem != nullptr && VisibilityData != nullptr)
+	{
+		SensingSubsystem->UnregisterVisibilityData(VisibilityData);
+	}
+	if (SensingSubsystem != nullptr && RoomGraph != nullptr)
+	{
+		SensingSubsystem->UnregisterRoomGraph(RoomGraph);
+	}
+	if (SensingSubsystem != nullptr && IlluminationData != nullptr)
+	{
+		SensingSubsystem->UnregisterIlluminationData(IlluminationData);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+#if WITH_EDITOR
+namespace SensingVisibilityBake
+{
+	/** Sample points of a cell as fractions of the cell size from its center. The center comes first, then the corners of a smaller cube. */
+	static const FVector SampleOffsets[] =
+	{
+		FVector(0.f, 0.f, 0.f),
+		FVector(-0.35f, -0.35f, -0.35f),
+		FVector(0.35f, 0.35f, 0.35f),
+		FVector(0.35f, -0.35f, -0.35f),
+		FVector(-0.35f, 0.35f, 0.35f),
+		FVector(-0.35f, 0.35f, -0.35f),
+		FVector(0.35f, -0.35f, 0.35f),
+		FVector(-0.35f, -0.35f, 0.35f),
+		FVector(0.35f, 0.35f, -0.35f),
+	};
+
+	/** A light taking part in the illumination bake. */
+	struct FBakeLight
+	{
+		FVector Location;
+		FVector Direction;
+		float RadiusSquared;
+		float Scale;
+		float OuterConeCosine;
+		float InnerConeCosine;
+		bool bDirectional;
+		FCollisionQueryParams Params;
+	};
+}
+
+void ASensingVisibilityVolume::BakeVisibility()
+{
+	UWorld* World = GetWorld();
+	if (VisibilityData == nullptr || World == nullptr)
+	{
+		UE_LOG(LogSensing, Warning, TEXT("%s: assign a VisibilityData asset before baking sensing visibility."), *GetName());
+		return;
+	}
+
+	const FBox Bounds = GetComponentsBoundingBox(true);
+	const FVector Size = Bounds.GetSize();
+	const int64 NumCellsToBake = (int64)FMath::Max(FMath::CeilToInt(Size.X / CellSize), 1)
+		* FMath::Max(FMath::CeilToInt(Size.Y / CellSize), 1)
+		* FMath::Max(FMath::CeilToInt(Size.Z / CellSize), 1);
+	if (NumCellsToBake > MaxCells)
+	{
+		UE_LOG(LogSensing, Error, TEXT("%s: baking sensing visibility would need %lld cells, more than MaxCells (%d). Increase CellSize or shrink the volume."), *GetName(), NumCellsToBake, MaxCells);
+		return;
+	}
+
+	VisibilityData->Modify();
+	VisibilityData->ResetGrid(Bounds, CellSize);
+	const int32 NumCells = VisibilityData->GetNumCells();
+
+	// Only static geometry is baked. Anything that can move is left to the runtime traces and the visibility cache.
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(SensingVisibilityBake), true, this);
+	Params.MobilityType = EQueryMobilityType::Static;
+
+	FScopedSlowTask SlowTask(2.f * NumCells, FText::FromString(TEXT("Baking sensing visibility")));
+	SlowTask.MakeDialog(true);
+
+	// Voxelize: keep the sample points of every cell that are in free space. Cells without any are solid.
+	const int32 NumSamples = FMath::Clamp(SamplesPerCell, 1, (int32)UE_ARRAY_COUNT(SensingVisibilityBake::SampleOffsets));
+	const FCollisionShape CellShape = FCollisionShape::MakeBox(FVector(0.5f * VisibilityData->GetCellSize()));
+	const FCollisionShape PointShape = FCollisionShape::MakeSphere(1.f);
+
+	TArray<FVector> Samples;
+	Samples.Reserve(NumCells * NumSamples);
+	TArray<int32> FirstSample;
+	FirstSample.SetNumUninitialized(NumCells + 1);
+
+	for (int32 Cell = 0; Cell < NumCells; ++Cell)
+	{
+		SlowTask.EnterProgressFrame();
+		FirstSample[Cell] = Samples.Num();
+
+		const FVector Center = VisibilityData->GetCellCenter(Cell);
+		const bool bTouchesGeometry = World->OverlapBlockingTestByChannel(Center, FQuat::Identity, ECC_Visibility, CellShape, Params);
+		for (int32 SampleIndex = 0; SampleIndex < NumSamples; ++SampleIndex)
+		{
+			const FVector Point = Center + SensingVisibilityBake::SampleOffsets[SampleIndex] * VisibilityData->GetCellSize();
+			if (!bTouchesGeometry || !World->OverlapBlockingTestByChannel(Point, FQuat::Identity, ECC_Visibility, PointShape, Params))
+			{
+				Samples.Add(Point);
+			}
+		}
+
+		if (Samples.Num() == FirstSample[Cell])
+		{
+			VisibilityData->SetCellSolid(Cell);
+		}
+	}
+	FirstSample[NumCells] = Samples.Num();
+
+	// A pair is occluded only if every trace between the free points of its two cells is blocked.
+	const float MaxBakeDistanceSquared = FMath::Square(MaxBakeDistance);
+	for (int32 CellA = 0; CellA < NumCells; ++CellA)
+	{
+		SlowTask.EnterProgressFrame();
+		if (SlowTask.ShouldCancel())
+		{
+			// A partial bake would report unbaked pairs as occluded.
+			VisibilityData->ClearGrid();
+			VisibilityData->MarkPackageDirty();
+			return;
+		}
+
+		if (VisibilityData->IsCellSolid(CellA))
+		{
+			continue;
+		}
+
+		const FIntVector CoordinatesA = VisibilityData->GetCellCoordinates(CellA);
+		const FVector CenterA = VisibilityData->GetCellCenter(CellA);
+		for (int32 CellB = CellA + 1; CellB < NumCells; ++CellB)
+		{
+			if (VisibilityData->IsCellSolid(CellB))
+			{
+				continue;
+			}
+
+			const FIntVector Delta = VisibilityData->GetCellCoordinates(CellB) - CoordinatesA;
+			const bool bAdjacent = FMath::Abs(Delta.X) <= 1 && FMath::Abs(Delta.Y) <= 1 && FMath::Abs(Delta.Z) <= 1;
+			if (bAdjacent || FVector::DistSquared(CenterA, VisibilityData->GetCellCenter(CellB)) > MaxBakeDistanceSquared)
+			{
+				VisibilityData->SetCellsVisible(CellA, CellB);
+				continue;
+			}
+
+			bool bVisible = false;
+			for (int32 SampleA = FirstSample[CellA]; SampleA < FirstSample[CellA + 1] && !bVisible; ++SampleA)
+			{
+				for (int32 SampleB = FirstSample[CellB]; SampleB < FirstSample[CellB + 1] && !bVisible; ++SampleB)
+				{
+					bVisible = !World->LineTraceTestByChannel(Samples[SampleA], Samples[SampleB], ECC_Visibility, Params);
+				}
+			}
+
+			if (bVisible)
+			{
+				VisibilityData->SetCellsVisible(CellA, CellB);
+			}
+		}
+	}
+
+	// The samples can slip past narrow gaps, so widen every visible pair to the neighbors of both of its cells.
+	VisibilityData->DilateVisibility();
+	VisibilityData->MarkPackageDirty();
+
+	UE_LOG(LogSensing, Log, TEXT("%s: baked sensing visibility for %d cells, %.1f%% of cell pairs are occluded."), *GetName(), NumCells, 100.f * VisibilityData->GetOccludedPairFraction());
+}
+
+void ASensingVisibilityVolume::BakeRoomGraph()
+{
+	UWorld* World = GetWorld();
+	if (RoomGraph == nullptr || World == nullptr)
+	{
+		UE_LOG(LogSensing, Warning, TEXT("%s: assign a RoomGraph asset before baking the sensing room graph."), *GetName());
+		return;
+	}
+
+	const FBox Bounds = GetComponentsBoundingBox(true);
+	TArray<FBox> RoomBounds;
+	for (TActorIterator<ASensingRoomVolume> It(World); It; ++It)
+	{
+		const FBox Room = It->GetComponentsBoundingBox(true);
+		if (Room.Intersect(Bounds))
+		{
+			RoomBounds.Add(Room);
+		}
+	}
+
+	RoomGraph->Modify();
+	RoomGraph->ResetRooms(RoomBounds, PortalDistancePenalty);
+
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(SensingRoomGraphBake), true, this);
+	Params.MobilityType = EQueryMobilityType::Static;
+
+	// Rooms that touch are connected where traces across the face they share get through. The portal is placed at the
+	// average of the clear traces, so a door in a long wall ends up at the door rather than in the middle of the wall.
+	static const int32 FaceSamples = 5;
+	int32 NumPortals = 0;
+	for (int32 RoomA = 0; RoomA < RoomBounds.Num(); ++RoomA)
+	{
+		const FBox ExpandedA = RoomBounds[RoomA].ExpandBy(PortalTolerance);
+		for (int32 RoomB = RoomA + 1; RoomB < RoomBounds.Num(); ++RoomB)
+		{
+			if (!ExpandedA.Intersect(RoomBounds[RoomB].ExpandBy(PortalTolerance)))
+			{
+				continue;
+			}
+
+			const FBox Overlap = ExpandedA.Overlap(RoomBounds[RoomB].ExpandBy(PortalTolerance));
+			const FVector OverlapSize = Overlap.GetSize();
+			const int32 NormalAxis = OverlapSize.X <= OverlapSize.Y && OverlapSize.X <= OverlapSize.Z ? 0 : (OverlapSize.Y <= OverlapSize.Z ? 1 : 2);
+			const int32 AxisU = (NormalAxis + 1) % 3;
+			const int32 AxisV = (NormalAxis + 2) % 3;
+
+			// Trace from inside one room to inside the other, through the middle of the shared face.
+			const FVector CenterA = RoomBounds[RoomA].GetCenter();
+			const FVector CenterB = RoomBounds[RoomB].GetCenter();
+			const float Direction = CenterB[NormalAxis] >= CenterA[NormalAxis] ? 1.f : -1.f;
+			const float Reach = 0.5f * OverlapSize[NormalAxis] + PortalTolerance;
+
+			FVector PortalSum = FVector::ZeroVector;
+			int32 NumClear = 0;
+			for (int32 U = 0; U < FaceSamples; ++U)
+			{
+				for (int32 V = 0; V < FaceSamples; ++V)
+				{
+					FVector Point = Overlap.GetCenter();
+					Point[AxisU] = FMath::Lerp(Overlap.Min[AxisU], Overlap.Max[AxisU], 0.1f + 0.8f * U / (FaceSamples - 1));
+					Point[AxisV] = FMath::Lerp(Overlap.Min[AxisV], Overlap.Max[AxisV], 0.1f + 0.8f * V / (FaceSamples - 1));
+
+					FVector Start = Point;
+					FVector End = Point;
+					Start[NormalAxis] -= Direction * Reach;
+					End[NormalAxis] += Direction * Reach;
+					if (!World->LineTraceTestByChannel(Start, End, ECC_Visibility, Params))
+					{
+						PortalSum += Point;
+						++NumClear;
+					}
+				}
+			}
+
+			if (NumClear > 0)
+			{
+				RoomGraph->AddPortal(PortalSum / NumClear, RoomA, RoomB);
+				++NumPortals;
+			}
+		}
+	}
+
+	RoomGraph->BuildDistanceTable();
+	RoomGraph->MarkPackageDirty();
+
+	UE_LOG(LogSensing, Log, TEXT("%s: baked a sensing room graph of %d rooms and %d portals."), *GetName(), RoomBounds.Num(), NumPortals);
+}
+
+void ASensingVisibilityVolume::BakeIllumination()
+{
+	UWorld* World = GetWorld();
+	if (IlluminationData == nullptr || World == nullptr)
+	{
+		UE_LOG(LogSensing, Warning, TEXT("%s: assign an IlluminationData asset before baking sensing illumination."), *GetName());
+		return;
+	}
+
+	const FBox Bounds = GetComponentsBoundingBox(true);
+	const FIntVector NumPoints = USensingIlluminationData::GetNumPointsFor(Bounds, IlluminationCellSize);
+	const int64 NumPointsToBake = (int64)NumPoints.X * NumPoints.Y * NumPoints.Z;
+	if (NumPointsToBake > MaxIlluminationPoints)
+	{
+		UE_LOG(LogSensing, Error, TEXT("%s: baking sensing illumination would need %lld points, more than MaxIlluminationPoints (%d). Increase IlluminationCellSize or shrink the volume."), *GetName(), NumPointsToBake, MaxIlluminationPoints);
+		return;
+	}
+
+	// Lights as they are placed. Movable ones come and go at runtime, except the security cameras' spotlights, which are always there.
+	TArray<SensingVisibilityBake::FBakeLight> Lights;
+	for (TActorIterator<AActor> It(World); It; ++It)
+	{
+		const bool bSecurityCamera = It->IsA<ASecurityCamera>();
+		TInlineComponentArray<ULightComponent*> LightComponents(*It);
+		for (const ULightComponent* LightComponent : LightComponents)
+		{
+			if (!LightComponent->IsVisible() || !LightComponent->bAffectsWorld || (LightComponent->Mobility == EComponentMobility::Movable && !bSecurityCamera))
+			{
+				continue;
+			}
+
+			SensingVisibilityBake::FBakeLight Light;
+			Light.Location = LightComponent->GetComponentLocation();
+			Light.Direction = LightComponent->GetDirection();
+			Light.RadiusSquared = 0.f;
+			Light.Scale = 1.f;
+			Light.OuterConeCosine = -1.f;
+			Light.InnerConeCosine = -1.f;
+			Light.bDirectional = LightComponent->IsA<UDirectionalLightComponent>();
+			Light.Params = FCollisionQueryParams(SCENE_QUERY_STAT(SensingIlluminationBake), false, *It);
+			Light.Params.AddIgnoredActor(this);
+			Light.Params.MobilityType = EQueryMobilityType::Static;
+
+			if (const UPointLightComponent* PointLight = Cast<const UPointLightComponent>(LightComponent))
+			{
+				Light.RadiusSquared = FMath::Square(PointLight->AttenuationRadius);
+				Light.Scale = FullyLitBrightness > 0.f ? FMath::Min(LightComponent->ComputeLightBrightness() / FullyLitBrightness, 1.f) : 1.f;
+			}
+			else if (!Light.bDirectional)
+			{
+				// Sky and rect lights are not worth approximating.
+				continue;
+			}
+
+			if (const USpotLightComponent* SpotLight = Cast<const USpotLightComponent>(LightComponent))
+			{
+				Light.OuterConeCosine = FMath::Cos(FMath::DegreesToRadians(SpotLight->OuterConeAngle));
+				Light.InnerConeCosine = FMath::Cos(FMath::DegreesToRadians(FMath::Min(SpotLight->InnerConeAngle, SpotLight->OuterConeAngle)));
+			}
+
+			Lights.Add(Light);
+		}
+	}
+
+	IlluminationData->Modify();
+	IlluminationData->ResetGrid(Bounds, IlluminationCellSize);
+
+	FScopedSlowTask SlowTask((float)NumPoints.Z, FText::FromString(TEXT("Baking sensing illumination")));
+	SlowTask.MakeDialog(true);
+
+	TArray<uint8> Levels;
+	Levels.Reserve((int32)NumPointsToBake);
+	for (int32 Z = 0; Z < NumPoints.Z; ++Z)
+	{
+		SlowTask.EnterProgressFrame();
+		if (SlowTask.ShouldCancel())
+		{
+			IlluminationData->ClearGrid();
+			IlluminationData->MarkPackageDirty();
+			return;
+		}
+
+		for (int32 Y = 0; Y < NumPoints.Y; ++Y)
+		{
+			for (int32 X = 0; X < NumPoints.X; ++X)
+			{
+				const FVector Point = IlluminationData->GetPointLocation(FIntVector(X, Y, Z));
+
+				float Illumination = 0.f;
+				for (const SensingVisibilityBake::FBakeLight& Light : Lights)
+				{
+					if (Light.bDirectional)
+					{
+						if (!World->LineTraceTestByChannel(Point, Point - Light.Direction * DirectionalShadowDistance, ECC_Visibility, Light.Params))
+						{
+							Illumination += 1.f;
+						}
+						continue;
+					}
+
+					// A smooth window over the attenuation radius rather than the renderer's exact falloff, which depends on the light's units.
+					const FVector ToPoint = Point - Light.Location;
+					const float DistanceSquared = ToPoint.SizeSquared();
+					if (DistanceSquared >= Light.RadiusSquared)
+					{
+						continue;
+					}
+
+					float Contribution = Light.Scale * FMath::Square(1.f - DistanceSquared / Light.RadiusSquared);
+					if (Light.OuterConeCosine > -1.f)
+					{
+						const float Cosine = ToPoint.GetSafeNormal() | Light.Direction;
+						Contribution *= FMath::SmoothStep(Light.OuterConeCosine, FMath::Max(Light.InnerConeCosine, Light.OuterConeCosine + KINDA_SMALL_NUMBER), Cosine);
+					}
+
+					// Skip the shadow trace for lights that could not change the stored level anyway.
+					if (Contribution >= 0.5f / 255.f && !World->LineTraceTestByChannel(Point, Light.Location, ECC_Visibility, Light.Params))
+					{
+						Illumination += Contribution;
+					}
+				}
+
+				Levels.Add((uint8)FMath::RoundToInt(FMath::Clamp(Illumination, 0.f, 1.f) * 255.f));
+			}
+		}
+	}
+
+	IlluminationData->SetPointLevels(Levels);
+	IlluminationData->MarkPackageDirty();
+
+	UE_LOG(LogSensing, Log, TEXT("%s: baked sensing illumination of %d lights at %lld points, %.1f%% of the bricks are uniform."), *GetName(), Lights.Num(), NumPointsToBake, 100.f * IlluminationData->GetUniformBrickFraction());
+}
+#endif
@@ -0,0 +1,100 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Volume.h"
+#include "SensingVisibilityVolume.generated.h"
+
+class USensingVisibilityData;
+class USensingRoomGraph;
+class USensingIlluminationData;
+
+/**
+ * Marks the part of a level whose static geometry is baked into a potentially visible set for the sensing components.
+ * Press Bake Visibility in the details panel after changing the level's static geometry. At runtime, sensors skip
+ * line of sight and hearing occlusion traces between cells that the bake proved to be occluded.
+ * Press Bake Room Graph to connect the ASensingRoomVolumes inside the volume for sound propagation, and Bake
+ * Illumination to record how lit every spot is for the sensors' sight.
+ */
+UCLASS()
+class STEALTHGAME_API ASensingVisibilityVolume : public AVolume
+{
+	GENERATED_BODY()
+
+public:
+	ASensingVisibilityVolume();
+
+	/** Asset the bake is written to. Create one from the content browser (Miscellaneous > Data Asset) and assign it before baking. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Sensing)
+		USensingVisibilityData* VisibilityData;
+
+	/** Size of the cubic cells the volume is cut into. Smaller cells cull more pairs, but the bake grows with the square of the cell count. */
+	UPROPERTY(EditAnywhere, Category = Sensing, meta = (ClampMin = "50.0"))
+		float CellSize;
+
+	/** Number of points traced from in each cell. Pairs of cells are occluded only if every trace between their points is blocked. */
+	UPROPERTY(EditAnywhere, Category = Sensing, meta = (ClampMin = "1", ClampMax = "9"))
+		int32 SamplesPerCell;
+
+	/** Pairs of cells further apart than this are not traced and stay potentially visible. Should cover the largest SightRadius and LOSHearingThreshold. */
+	UPROPERTY(EditAnywhere, Category = Sensing)
+		float MaxBakeDistance;
+
+	/** The bake refuses to run on more cells than this, the asset size grows with the square of the cell count. */
+	UPROPERTY(EditAnywhere, Category = Sensing, AdvancedDisplay)
+		int32 MaxCells;
+
+	/** Asset the room graph bake is written to. Sensors hearing between two of its rooms use the path through the portals instead of a trace. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Sensing|Rooms")
+		USensingRoomGraph* RoomGraph;
+
+	/** Rooms whose volumes are this close are checked for an opening between them. */
+	UPROPERTY(EditAnywhere, Category = "Sensing|Rooms", meta = (ClampMin = "0.0"))
+		float PortalTolerance;
+
+	/** Extra distance added to the path of a sound for each portal it goes through. */
+	UPROPERTY(EditAnywhere, Category = "Sensing|Rooms", meta = (ClampMin = "0.0"))
+		float PortalDistancePenalty;
+
+	/** Asset the illumination bake is written to. Sensors see targets in the dark from closer, see UMovablePawnSensingComponent::DarkSightRadiusScale. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Sensing|Illumination")
+		USensingIlluminationData* IlluminationData;
+
+	/** Spacing of the points light levels are sampled at. */
+	UPROPERTY(EditAnywhere, Category = "Sensing|Illumination", meta = (ClampMin = "25.0"))
+		float IlluminationCellSize;
+
+	/** Brightness (see ULightComponent::ComputeLightBrightness) of a point or spot light that fully lights its surroundings. Dimmer lights light proportionally less. */
+	UPROPERTY(EditAnywhere, Category = "Sensing|Illumination", meta = (ClampMin = "0.0"))
+		float FullyLitBrightness;
+
+	/** How far to trace towards directional lights for shadows. Directional lights fully light whatever they reach. */
+	UPROPERTY(EditAnywhere, Category = "Sensing|Illumination", AdvancedDisplay)
+		float DirectionalShadowDistance;
+
+	/** The illumination bake refuses to run on more points than this. */
+	UPROPERTY(EditAnywhere, Category = "Sensing|Illumination", AdvancedDisplay)
+		int32 MaxIlluminationPoints;
+
+#if WITH_EDITOR
+	/** Voxelizes the static geometry inside the volume and precomputes cell to cell visibility into VisibilityData. */
+	UFUNCTION(CallInEditor, Category = Sensing)
+		void BakeVisibility();
+
+	/** Finds the openings between the ASensingRoomVolumes inside the volume and precomputes the sound paths between them into RoomGraph. */
+	UFUNCTION(CallInEditor, Category = "Sensing|Rooms")
+		void BakeRoomGraph();
+
+	/**
+	 * Samples the light level around the volume into IlluminationData. Static and stationary lights count, as do the
+	 * spotlights of ASecurityCameras as they are placed. Shadows are cast by static geometry only.
+	 */
+	UFUNCTION(CallInEditor, Category = "Sensing|Illumination")
+		void BakeIllumination();
+#endif
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+};
@@ -8,6 +8,9 @@ public class StealthGame : ModuleRules
 	{
 		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
 
-		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "HeadMountedDisplay", "AIModule", "Niagara" });
+		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "HeadMountedDisplay", "AIModule", "Niagara", "SignificanceManager", "NetCore" });
+
+		// Baselines of the StealthGame.Perf automation tests.
+		PrivateDependencyModuleNames.AddRange(new string[] { "Json" });
 	}
 }
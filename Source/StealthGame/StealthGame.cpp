@@ -4,4 +4,13 @@
 #include "Modules/ModuleManager.h"
 
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, StealthGame, "StealthGame" );
- 
\ No newline at end of file
+
+DEFINE_LOG_CATEGORY(LogSensing);
+
+DEFINE_STAT(STAT_Sensing_ConeCulling);
+DEFINE_STAT(STAT_Sensing_CulledPairs);
+
+#if ENABLE_STEALTH_FRAME_COSTS
+bool FStealthFrameCosts::bEnabled = false;
+double FStealthFrameCosts::Seconds[(int32)EStealthFrameCost::Num] = {};
+#endif
@@ -3,3 +3,71 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "VisualLogger/VisualLogger.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogSensing, Log, All);
+
+/** Sensors, lasers and alarms. Shown with "stat Sensing". */
+DECLARE_STATS_GROUP(TEXT("Sensing"), STATGROUP_Sensing, STATCAT_Advanced);
+
+// Shared by the sensing components and the sensing subsystem's batch cull.
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Cone Culling"), STAT_Sensing_ConeCulling, STATGROUP_Sensing, STEALTHGAME_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Pairs Culled"), STAT_Sensing_CulledPairs, STATGROUP_Sensing, STEALTHGAME_API);
+
+/** Sensing debug output (visual logger entries, the components' debug properties). Compiled out of Test and Shipping builds. */
+#ifndef ENABLE_SENSING_DEBUG
+#define ENABLE_SENSING_DEBUG (ENABLE_VISUAL_LOG && !(UE_BUILD_SHIPPING || UE_BUILD_TEST))
+#endif
+
+/** Per-frame game thread timings of sensing, lasers and alarms, read by ASensingBenchmarkGameMode. Compiled out of Shipping builds. */
+#ifndef ENABLE_STEALTH_FRAME_COSTS
+#define ENABLE_STEALTH_FRAME_COSTS !UE_BUILD_SHIPPING
+#endif
+
+enum class EStealthFrameCost : uint8
+{
+	Sensing,
+	Lasers,
+	Alarms,
+	Num
+};
+
+#if ENABLE_STEALTH_FRAME_COSTS
+/** Game thread seconds spent in each EStealthFrameCost since the last Reset(). Nothing is timed unless bEnabled is set. */
+struct STEALTHGAME_API FStealthFrameCosts
+{
+	static bool bEnabled;
+	static double Seconds[(int32)EStealthFrameCost::Num];
+
+	static void Reset() { FMemory::Memzero(Seconds); }
+};
+
+/** Adds the time until the end of the scope to one of the FStealthFrameCosts. Game thread only. */
+class FStealthFrameCostScope
+{
+public:
+	explicit FStealthFrameCostScope(EStealthFrameCost InCost)
+		: Cost(InCost)
+		, StartTime(FStealthFrameCosts::bEnabled ? FPlatformTime::Seconds() : 0.0)
+	{
+	}
+
+	~FStealthFrameCostScope()
+	{
+		if (StartTime > 0.0)
+		{
+			FStealthFrameCosts::Seconds[(int32)Cost] += FPlatformTime::Seconds() - StartTime;
+		}
+	}
+
+private:
+	EStealthFrameCost Cost;
+	double StartTime;
+};
+
+#define STEALTH_FRAME_COST_SCOPE(Cost) FStealthFrameCostScope PREPROCESSOR_JOIN(FrameCostScope_, __LINE__)(EStealthFrameCost::Cost)
+#else
+#define STEALTH_FRAME_COST_SCOPE(Cost)
+#endif
@@ -167,6 +167,8 @@ public:
 	USkeletalMeshComponent* GetMesh1P() const { return Mesh1P; }
 	/** Returns FirstPersonCameraComponent subobject **/
 	UCameraComponent* GetFirstPersonCameraComponent() const { return FirstPersonCameraComponent; }
+	/** Returns true while the character is sneaking **/
+	bool IsSneaking() const { return isSneaking; }
 
 	FTimerHandle FootstepTimer;
 
@@ -1,11 +1,14 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "StealthGameHUD.h"
+#include "SensingSubsystem.h"
 #include "Engine/Canvas.h"
 #include "Engine/Texture2D.h"
 #include "TextureResource.h"
 #include "CanvasItem.h"
 #include "UObject/ConstructorHelpers.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
 
 AStealthGameHUD::AStealthGameHUD()
 {
@@ -32,4 +35,30 @@ void AStealthGameHUD::DrawHUD()
 	FCanvasTileItem TileItem( CrosshairDrawPosition, CrosshairTex->Resource, FLinearColor::White);
 	TileItem.BlendMode = SE_BLEND_Translucent;
 	Canvas->DrawItem( TileItem );
+
+	DrawLightMeter();
+}
+
+void AStealthGameHUD::DrawLightMeter()
+{
+	const USensingSubsystem* SensingSubsystem = GetWorld()->GetSubsystem<USensingSubsystem>();
+	const APawn* Pawn = GetOwningPawn();
+	if (SensingSubsystem == nullptr || Pawn == nullptr || !SensingSubsystem->HasIlluminationData())
+	{
+		return;
+	}
+
+	const float Illumination = SensingSubsystem->GetIllumination(Pawn->GetActorLocation());
+
+	// bottom left corner, a dark bar filled up to the light level
+	const FVector2D MeterSize(200.0f, 12.0f);
+	const FVector2D MeterPosition(40.0f, Canvas->ClipY - 60.0f);
+
+	FCanvasTileItem BackgroundItem(MeterPosition, MeterSize, FLinearColor(0.0f, 0.0f, 0.0f, 0.5f));
+	BackgroundItem.BlendMode = SE_BLEND_Translucent;
+	Canvas->DrawItem(BackgroundItem);
+
+	FCanvasTileItem FillItem(MeterPosition, FVector2D(MeterSize.X * Illumination, MeterSize.Y), FLinearColor(1.0f, 0.85f, 0.3f, 0.9f));
+	FillItem.BlendMode = SE_BLEND_Translucent;
+	Canvas->DrawItem(FillItem);
 }
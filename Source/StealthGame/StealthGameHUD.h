@@ -18,6 +18,9 @@ public:
 	virtual void DrawHUD() override;
 
 private:
+	/** Draws how lit the player is, from the sensing subsystem's baked illumination */
+	void DrawLightMeter();
+
 	/** Crosshair asset pointer */
 	class UTexture2D* CrosshairTex;
 